@@ -0,0 +1,178 @@
+/*
+CSV track parsing (gps_core)
+============================
+
+See CSVTrack.h. Everything here works on caller-owned buffers - no heap.
+*/
+
+#include "CSVTrack.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Split the next field off a CSV line in place
+ * 
+ * Handles double-quoted fields containing commas. The field is NUL-terminated
+ * inside the line buffer and surrounding quotes are removed.
+ * 
+ * @param cursor Current position, advanced past the field's delimiter
+ * @return the field text, or nullptr when the line is exhausted
+ */
+char* nextCSVField(char*& cursor) {
+  if (cursor == nullptr) return nullptr;
+  
+  char* field = cursor;
+  bool inQuotes = false;
+  char* p = cursor;
+  while (*p && (inQuotes || *p != ',')) {
+    if (*p == '"') inQuotes = !inQuotes;
+    p++;
+  }
+  
+  cursor = (*p == ',') ? p + 1 : nullptr;  // nullptr = that was the last field
+  *p = '\0';
+  
+  if (field[0] == '"') {
+    field++;
+    size_t len = strlen(field);
+    if (len > 0 && field[len - 1] == '"') field[len - 1] = '\0';
+  }
+  return field;
+}
+
+/**
+ * Build the column map from the CSV header line
+ * 
+ * @param header Header line (modified in place)
+ * @param map Receives the column roles
+ * @return nullptr on success, otherwise the name of the first missing column
+ */
+const char* parseCSVHeader(char* header, CSVColumnMap& map) {
+  memset(map.roleOfColumn, COLUMN_UNUSED, sizeof(map.roleOfColumn));
+  map.lastNeededColumn = -1;
+  
+  bool found[CSV_COLUMN_COUNT] = {false};
+  char* cursor = header;
+  char* name;
+  for (int column = 0; column < CSV_MAX_COLUMNS && (name = nextCSVField(cursor)) != nullptr; column++) {
+    while (*name == ' ') name++;  // Tolerate "a, b" style headers
+    for (int role = 0; role < CSV_COLUMN_COUNT; role++) {
+      if (!found[role] && strcmp(name, CSV_COLUMN_NAMES[role]) == 0) {
+        found[role] = true;
+        map.roleOfColumn[column] = role;
+        if (column > map.lastNeededColumn) map.lastNeededColumn = column;
+      }
+    }
+  }
+  
+  for (int role = 0; role < CSV_COLUMN_COUNT; role++) {
+    if (!found[role]) return CSV_COLUMN_NAMES[role];
+  }
+  return nullptr;
+}
+
+/**
+ * Parse decimal degrees ("-0.547948") straight into 1e-7 degrees
+ * 
+ * No float on the way: the digits are accumulated as an integer, so a
+ * coordinate survives CSV → track → NMEA bit-exact. Digits beyond the 7th
+ * decimal are rounded.
+ * 
+ * @param text Number, optionally preceded by spaces and a sign
+ * @param degreesE7 Receives the value (only meaningful on success)
+ * @return true if at least one digit was read and the value fits
+ */
+bool parseDegreesE7(const char* text, int32_t& degreesE7) {
+  while (*text == ' ') text++;
+  bool negative = *text == '-';
+  if (*text == '-' || *text == '+') text++;
+  
+  uint32_t whole = 0;
+  int digits = 0;
+  for (; isdigit((unsigned char)*text); text++, digits++) {
+    whole = whole * 10 + (*text - '0');
+    if (whole > 180) return false;
+  }
+  
+  uint32_t fraction = 0;
+  int decimals = 0;
+  if (*text == '.') {
+    for (text++; isdigit((unsigned char)*text); text++, digits++) {
+      if (decimals < 7) {
+        fraction = fraction * 10 + (*text - '0');
+        decimals++;
+      } else if (decimals == 7) {
+        if (*text >= '5') fraction++;   // Round on the first dropped digit
+        decimals++;
+      }
+    }
+  }
+  if (digits == 0) return false;
+  
+  for (int i = decimals < 7 ? decimals : 7; i < 7; i++) fraction *= 10;
+  int32_t magnitude = whole * 10000000L + fraction;
+  degreesE7 = negative ? -magnitude : magnitude;
+  return true;
+}
+
+/**
+ * Parse one CSV data row using the header's column map
+ * 
+ * @param line Data row (modified in place)
+ * @param map Column map from parseCSVHeader()
+ * @param gps Receives the fields; gps.valid is set if the coordinates parsed
+ */
+void parseCSVLine(char* line, const CSVColumnMap& map, GPSData& gps) {
+  gps.valid = false;
+  
+  char* cursor = line;
+  char* field;
+  for (int column = 0; column <= map.lastNeededColumn && (field = nextCSVField(cursor)) != nullptr; column++) {
+    switch (map.roleOfColumn[column]) {
+      case COLUMN_UTC_TIME:
+        snprintf(gps.utc_time, sizeof(gps.utc_time), "%s", field);
+        break;
+      case COLUMN_COORDINATES: {
+        // Format: [latitude, longitude]
+        char* bracket = strchr(field, '[');
+        char* comma = bracket ? strchr(bracket, ',') : nullptr;
+        if (comma && strchr(comma, ']')) {
+          bool latOk = parseDegreesE7(bracket + 1, gps.latitudeE7);
+          bool lonOk = parseDegreesE7(comma + 1, gps.longitudeE7);
+          gps.valid = latOk && lonOk &&
+                      labs(gps.latitudeE7) <= 900000000L && labs(gps.longitudeE7) <= 1800000000L;
+        }
+        break;
+      }
+      case COLUMN_GPS_COURSE:
+        gps.gps_course = strtof(field, nullptr);
+        break;
+      case COLUMN_GPS_SPEED_KNOTS:
+        gps.gps_speed_knots = strtof(field, nullptr);
+        break;
+      case COLUMN_HDOP:
+        gps.hdop = strtof(field, nullptr);
+        break;
+      case COLUMN_SATS:
+        gps.sats = atoi(field);
+        if (gps.sats == 0) gps.sats = 4; // Default to 4 satellites
+        break;
+    }
+  }
+}
+
+/**
+ * Convert "HH:MM:SS" to seconds since midnight
+ * 
+ * @return seconds, or -1 if the text is not a valid time
+ */
+long parseTimeOfDay(const char* text) {
+  int hours, minutes, seconds;
+  if (sscanf(text, "%d:%d:%d", &hours, &minutes, &seconds) != 3) {
+    return -1;
+  }
+  return hours * 3600L + minutes * 60L + seconds;
+}
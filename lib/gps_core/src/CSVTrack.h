@@ -0,0 +1,56 @@
+/*
+CSV track parsing (gps_core)
+============================
+
+Header-driven column map and in-place row parser for the logger CSV.
+No Arduino dependencies - also built natively for the tests under test/.
+The functions are documented with their definitions in CSVTrack.cpp.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "GPSData.h"
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Header-driven Column Map
+ * 
+ * WHAT: The CSV header is parsed once into "which column holds which field"
+ * WHY: Column positions differ between logger versions, so hardcoded field
+ *      numbers silently read the wrong data (or nothing) from a new file.
+ *      Knowing the last column we need also lets each row's parse stop early -
+ *      the sample has ~70 columns but nothing after 'sats' is used
+ * HOW: roleOfColumn[] maps a column index to the field it holds (or
+ *      COLUMN_UNUSED), so each field in a row is dispatched with one lookup
+ * GOTCHAS: Fields may be quoted and contain commas - "[51.459595, -0.547948]" -
+ *          so splitting must track quotes, not just search for ','
+ */
+enum CSVColumn {
+  COLUMN_UTC_TIME,
+  COLUMN_COORDINATES,
+  COLUMN_GPS_COURSE,
+  COLUMN_GPS_SPEED_KNOTS,
+  COLUMN_HDOP,
+  COLUMN_SATS,
+  CSV_COLUMN_COUNT,
+  COLUMN_UNUSED = -1
+};
+
+// Header names for each CSVColumn - all must be present in the header line
+const char* const CSV_COLUMN_NAMES[CSV_COLUMN_COUNT] = {
+  "UTC_time", "coordinates", "gps_course", "gps_speed_knots", "hdop", "sats"
+};
+
+const int CSV_MAX_COLUMNS = 256;  // Needed columns must lie within the first 256
+
+struct CSVColumnMap {
+  int8_t roleOfColumn[CSV_MAX_COLUMNS];  // CSVColumn for each column index
+  int lastNeededColumn = -1;             // Parsing of a row stops after this column
+};
+
+char* nextCSVField(char*& cursor);
+const char* parseCSVHeader(char* header, CSVColumnMap& map);
+bool parseDegreesE7(const char* text, int32_t& degreesE7);
+void parseCSVLine(char* line, const CSVColumnMap& map, GPSData& gps);
+long parseTimeOfDay(const char* text);
@@ -0,0 +1,26 @@
+/*
+Calendar arithmetic (gps_core)
+==============================
+
+Integer date conversion shared by the RMC date field and UBX NAV-PVT.
+*/
+
+#pragma once
+
+/**
+ * Convert days since 1970-01-01 to a civil (proleptic Gregorian) date
+ * 
+ * Howard Hinnant's days-to-civil algorithm - pure integer arithmetic, no
+ * gmtime() and no tables.
+ */
+inline void civilFromDays(long days, int& year, int& month, int& day) {
+  days += 719468;                                   // Shift epoch to 0000-03-01
+  long era = (days >= 0 ? days : days - 146096) / 146097;
+  unsigned long dayOfEra = days - era * 146097;                              // [0, 146096]
+  unsigned long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+  unsigned long dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+  unsigned long monthIndex = (5 * dayOfYear + 2) / 153;                      // March = 0
+  day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+  month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+  year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+}
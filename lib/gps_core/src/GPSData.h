@@ -0,0 +1,30 @@
+/*
+GPS fix record (gps_core)
+=========================
+
+One track fix, as parsed from the CSV and as interpolated for each epoch.
+Plain data only, so it builds unchanged on the ESP32 and natively.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Structure to hold parsed GPS data from CSV file
+ * 
+ * This struct represents a single GPS fix with all the information needed
+ * to generate authentic NMEA sentences. Using a struct improves code
+ * readability and makes data passing more efficient than individual variables.
+ */
+struct GPSData {
+  char utc_time[12] = "";   // UTC time (HH:MM:SS from CSV, HHMMSS.SS once stamped)
+  int32_t latitudeE7;       // Latitude in 1e-7 degrees (positive = North)
+  int32_t longitudeE7;      // Longitude in 1e-7 degrees (positive = East)
+  int sats;                 // Number of satellites used in fix
+  float hdop;               // Horizontal Dilution of Precision
+  float gps_course;         // Course over ground in degrees (0-359)
+  float gps_speed_knots;    // Speed over ground in knots
+  uint32_t track_time_ms = 0; // Time of this fix relative to the start of the track
+  bool valid = false;       // Is this GPS data valid and complete?
+};
@@ -0,0 +1,274 @@
+/*
+NMEA 0183 sentence encoding (gps_core)
+======================================
+
+Allocation-free sentence writer with running XOR checksum and in-place
+template patching. No Arduino dependencies - also built natively for the
+unit tests and benchmarks under test/.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Calculate NMEA 0183 checksum using XOR algorithm
+ * 
+ * NMEA sentences require a checksum for data integrity verification.
+ * The checksum is computed by XORing all characters between '$' and '*'.
+ * 
+ * @param sentence The NMEA sentence (must start with $ but not include *)
+ * @return 8-bit checksum value
+ * 
+ * Example: For "$GPGGA,123456.00,1234.5678,N,12345.6789,W,1,08,0.9,545.4,M,46.9,M,,"
+ * The checksum is calculated on: "GPGGA,123456.00,1234.5678,N,12345.6789,W,1,08,0.9,545.4,M,46.9,M,,"
+ */
+inline uint8_t calculateChecksum(const char* sentence) {
+  uint8_t checksum = 0;  // Initialize accumulator
+  
+  // Start from index 1 to skip the '$' character
+  // Continue until '*' delimiter or end of string
+  for (int i = 1; sentence[i] != '*' && sentence[i] != '\0'; i++) {
+    checksum ^= sentence[i];  // XOR operation - self-inverse for error detection
+  }
+  
+  return checksum;
+}
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Allocation-free NMEA Sentence Writer
+ * 
+ * WHAT: Builds an NMEA sentence field by field into a fixed char buffer
+ * WHY: Building sentences with String operator+ and String(float, n) made a
+ *      dozen heap allocations per sentence, every second, forever - on a long
+ *      running unit that fragments the heap until large allocations fail
+ * HOW: Every character goes through put(), which stores it and XORs it into
+ *      the running checksum, so no second pass over the sentence is needed.
+ *      Numbers are written from scaled integers (e.g. 0.233 knots = 233 with
+ *      3 decimals) so there is no float-to-string conversion either
+ * GOTCHAS: '$' is written without touching the checksum, and finish() must be
+ *          called before text() is sent - it appends the "*HH" suffix
+ * 
+ * Example:
+ *   NMEASentenceWriter w;
+ *   w.begin("GNTXT"); w.fieldUInt(1); w.fieldUInt(1); w.fieldUInt(1, 2); w.field("ANTENNA OK");
+ *   w.finish();   // w.text() == "$GNTXT,1,1,01,ANTENNA OK*2B"
+ * 
+ * A writer can also serve as a template: markTemplate() freezes what has been
+ * written so far, the patch*() calls overwrite fixed-width slots of that prefix
+ * in place (XOR-ing the old bytes out of the checksum and the new ones in), and
+ * rewind() drops the previous epoch's tail so a new one can be appended.
+ */
+const int NMEA_SENTENCE_CAPACITY = 96;  // Same as a ring slot, less room for CR/LF
+
+class NMEASentenceWriter {
+public:
+  /**
+   * Start a new sentence
+   * 
+   * @param address Talker + sentence type, e.g. "GNRMC"
+   */
+  void begin(const char* address) {
+    len = 0;
+    checksum = 0;
+    overflow = false;
+    buffer[len++] = '$';  // Not part of the checksum
+    putText(address);
+  }
+  
+  // Empty field - just the ',' delimiter
+  void emptyField() { put(','); }
+  
+  // Text field, e.g. "A" or "ANTENNA OK"
+  void field(const char* text) {
+    put(',');
+    putText(text);
+  }
+  
+  // Several pre-formatted fields at once, e.g. "A,3" (delimiters included)
+  void fields(const char* text) { field(text); }
+  
+  void fieldChar(char c) {
+    put(',');
+    put(c);
+  }
+  
+  // Unsigned integer, zero padded to minDigits (e.g. sats "04")
+  void fieldUInt(uint32_t value, int minDigits = 1) {
+    put(',');
+    putUInt(value, minDigits);
+  }
+  
+  /**
+   * Fixed-point number from a scaled integer
+   * 
+   * @param scaled Value multiplied by 10^decimals (e.g. 489 for 4.89)
+   * @param decimals Digits after the decimal point
+   * @param minIntDigits Zero padding for the integer part
+   */
+  void fieldFixed(int32_t scaled, int decimals, int minIntDigits = 1) {
+    put(',');
+    putFixed(scaled, decimals, minIntDigits);
+  }
+  
+  /**
+   * Coordinate in NMEA (D)DDMM.MMMMM format followed by its hemisphere field
+   * 
+   * Pure integer: 1e-7 degrees × 60 = 6e-6 minutes, so 1e-5 minutes is
+   * (fraction × 6 + 5) / 10 - rounded once, with the carry into the degrees.
+   * 
+   * @param degreesE7 Coordinate in 1e-7 degrees, negative for South/West
+   * @param degreeDigits 2 for latitude, 3 for longitude
+   * @param positive Hemisphere letter for positive values ('N' or 'E')
+   * @param negative Hemisphere letter for negative values ('S' or 'W')
+   */
+  void fieldCoordinate(int32_t degreesE7, int degreeDigits, char positive, char negative) {
+    put(',');
+    putCoordinate(degreesE7, degreeDigits, positive, negative);
+  }
+  
+  /**
+   * Append the "*HH" checksum suffix
+   * 
+   * @return the complete sentence (without CR/LF)
+   */
+  const char* finish() {
+    uint8_t sum = checksum;   // put() would fold the suffix into the checksum
+    const char* hex = "0123456789ABCDEF";
+    if (len + 3 < NMEA_SENTENCE_CAPACITY) {
+      buffer[len++] = '*';
+      buffer[len++] = hex[sum >> 4];  // NMEA standard requires uppercase hex
+      buffer[len++] = hex[sum & 0x0F];
+    } else {
+      overflow = true;
+    }
+    buffer[len] = '\0';
+    return buffer;
+  }
+  
+  const char* text() const { return buffer; }
+  size_t length() const { return len; }
+  bool overflowed() const { return overflow; }
+  
+  // Offset at which the next field's text will start (after its ',')
+  size_t nextFieldOffset() const { return len + 1; }
+  
+  /**
+   * Freeze everything written so far as the template prefix
+   */
+  void markTemplate() {
+    prefixLength = len;
+    prefixChecksum = checksum;
+  }
+  
+  /**
+   * Drop everything after the template prefix, ready for a new tail
+   */
+  void rewind() {
+    len = prefixLength;
+    checksum = prefixChecksum;
+    overflow = false;
+  }
+  
+  /**
+   * Overwrite a fixed-width text slot of the prefix
+   * 
+   * @return false (slot unchanged) if text is not exactly width characters
+   */
+  bool patchText(size_t offset, const char* text, size_t width) {
+    if (strlen(text) != width) return false;
+    beginPatch(offset, width);
+    putText(text);
+    endPatch();
+    return true;
+  }
+  
+  /**
+   * Overwrite a "(D)DDMM.MMMMM,H" slot written by fieldCoordinate()
+   */
+  void patchCoordinate(size_t offset, int32_t degreesE7, int degreeDigits, char positive, char negative) {
+    beginPatch(offset, degreeDigits + 10);   // Degrees, "MM.MMMMM", ',' and hemisphere
+    putCoordinate(degreesE7, degreeDigits, positive, negative);
+    endPatch();
+  }
+  
+private:
+  // XOR the slot's old bytes out of the prefix checksum and redirect put() at it
+  void beginPatch(size_t offset, size_t width) {
+    for (size_t i = 0; i < width; i++) {
+      prefixChecksum ^= buffer[offset + i];
+    }
+    patchReturnLength = len;
+    len = offset;
+    checksum = prefixChecksum;
+  }
+  
+  // put() has XORed the new bytes in - keep the result as the prefix checksum
+  void endPatch() {
+    prefixChecksum = checksum;
+    len = patchReturnLength;
+  }
+  
+  void putCoordinate(int32_t degreesE7, int degreeDigits, char positive, char negative) {
+    uint32_t magnitude = degreesE7 < 0 ? -(uint32_t)degreesE7 : (uint32_t)degreesE7;
+    uint32_t wholeDegrees = magnitude / 10000000UL;
+    uint32_t minutesE5 = (magnitude % 10000000UL * 6 + 5) / 10;
+    if (minutesE5 >= 6000000UL) {  // 59.999995' and up rounds to the next degree
+      minutesE5 -= 6000000UL;
+      wholeDegrees++;
+    }
+    
+    putUInt(wholeDegrees, degreeDigits);
+    putFixed(minutesE5, 5, 2);
+    put(',');
+    put(degreesE7 >= 0 ? positive : negative);
+  }
+  
+  void put(char c) {
+    if (len < NMEA_SENTENCE_CAPACITY - 4) {  // Keep room for "*HH" + terminator
+      buffer[len++] = c;
+      checksum ^= c;  // XOR is order-independent, so it can run as we write
+    } else {
+      overflow = true;
+    }
+  }
+  
+  void putText(const char* text) {
+    while (*text) put(*text++);
+  }
+  
+  void putUInt(uint32_t value, int minDigits) {
+    char digits[10];
+    int count = 0;
+    do {
+      digits[count++] = '0' + (value % 10);
+      value /= 10;
+    } while (value > 0 && count < 10);
+    while (minDigits-- > count) put('0');
+    while (count > 0) put(digits[--count]);
+  }
+  
+  void putFixed(int32_t scaled, int decimals, int minIntDigits) {
+    if (scaled < 0) {
+      put('-');
+      scaled = -scaled;
+    }
+    uint32_t divisor = 1;
+    for (int i = 0; i < decimals; i++) divisor *= 10;
+    putUInt((uint32_t)scaled / divisor, minIntDigits);
+    if (decimals > 0) {
+      put('.');
+      putUInt((uint32_t)scaled % divisor, decimals);
+    }
+  }
+  
+  char buffer[NMEA_SENTENCE_CAPACITY];
+  size_t len = 0;
+  uint8_t checksum = 0;
+  bool overflow = false;
+  size_t prefixLength = 0;      // Template prefix, see markTemplate()
+  uint8_t prefixChecksum = 0;
+  size_t patchReturnLength = 0;
+};
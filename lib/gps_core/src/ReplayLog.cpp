@@ -0,0 +1,293 @@
+/*
+Raw log replay (gps_core)
+=========================
+
+See ReplayLog.h. Everything here works on caller-owned buffers - no heap.
+*/
+
+#include "ReplayLog.h"
+
+#include <ctype.h>
+#include <string.h>
+
+/**
+ * Parse an NMEA "hhmmss[.sss]" time field
+ * 
+ * @return milliseconds since midnight, or -1 if the text is not a time
+ */
+long parseNMEATimeMs(const char* text) {
+  for (int i = 0; i < 6; i++) {
+    if (!isdigit((unsigned char)text[i])) return -1;
+  }
+  int hours = (text[0] - '0') * 10 + (text[1] - '0');
+  int minutes = (text[2] - '0') * 10 + (text[3] - '0');
+  int seconds = (text[4] - '0') * 10 + (text[5] - '0');
+  if (hours > 23 || minutes > 59 || seconds > 60) return -1;  // 60 = leap second
+
+  long ms = ((hours * 60L + minutes) * 60L + seconds) * 1000L;
+  if (text[6] == '.') {
+    long scale = 100;
+    for (const char* p = text + 7; isdigit((unsigned char)*p) && scale > 0; p++, scale /= 10) {
+      ms += (*p - '0') * scale;
+    }
+  }
+  return ms;
+}
+
+/**
+ * Offset of a sentence's field if it starts with six digits
+ * 
+ * @param index Field number - the address ("GNRMC") is field 0
+ * @return offset from '$', or 0 if the field is missing, not numeric or index is 0
+ */
+static uint8_t digitFieldOffset(const char* sentence, size_t length, int index) {
+  if (index <= 0) return 0;
+  size_t offset = 0;
+  for (int field = 0; field < index; field++) {
+    while (offset < length && sentence[offset] != ',') offset++;
+    if (offset >= length) return 0;
+    offset++;  // Past the comma
+  }
+  if (offset + 6 > length) return 0;
+  for (size_t i = offset; i < offset + 6; i++) {
+    if (!isdigit((unsigned char)sentence[i])) return 0;
+  }
+  return (uint8_t)offset;
+}
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  return (toupper((unsigned char)c) - 'A') + 10;
+}
+
+/**
+ * Rewrite a stored sentence's time and date in place, keeping its checksum valid
+ * 
+ * Only the six digits of each field change - the fraction of a second is
+ * kept - so the checksum is updated by XOR-ing the old digits out and the new
+ * ones in. No pass over the rest of the sentence.
+ * 
+ * @param text Sentence starting at '$', as stored (ending "*HH\r\n")
+ * @param hhmmss New time digits, or nullptr to leave the time
+ * @param ddmmyy New date digits, or nullptr to leave the date
+ */
+void rewriteReplaySentence(char* text, const ReplaySentence& info, const char* hhmmss, const char* ddmmyy) {
+  uint8_t delta = 0;
+  const uint8_t fields[2] = {info.timeField, info.dateField};
+  const char* digits[2] = {hhmmss, ddmmyy};
+  for (int f = 0; f < 2; f++) {
+    if (!fields[f] || !digits[f]) continue;
+    char* at = text + fields[f];
+    for (int i = 0; i < 6; i++) {
+      delta ^= at[i] ^ digits[f][i];
+      at[i] = digits[f][i];
+    }
+  }
+  if (!delta) return;
+
+  // "*HH" sits just before the CR/LF
+  char* hex = text + info.length - 4;
+  uint8_t sum = ((hexValue(hex[0]) << 4) | hexValue(hex[1])) ^ delta;
+  const char* hexDigits = "0123456789ABCDEF";
+  hex[0] = hexDigits[sum >> 4];
+  hex[1] = hexDigits[sum & 0x0F];
+}
+
+/**
+ * Start a scan; each finished epoch is passed to handler
+ */
+void ReplayLogScanner::begin(EpochHandler handler, void* context) {
+  onEpoch = handler;
+  handlerContext = context;
+  result = ReplayScanStats();
+  stopped = false;
+  prefixLength = 0;
+  atLineStart = true;
+  skipSpace = false;
+  state = BETWEEN;
+  sentenceLength = 0;
+  epoch.header = ReplayEpochHeader();
+  timeSeen = false;
+  epochTimeMs = 0;
+  epochOffsetMs = 0;
+}
+
+/**
+ * Consume the next chunk of the capture - chunk boundaries can fall anywhere
+ */
+void ReplayLogScanner::feed(const uint8_t* data, size_t len) {
+  for (size_t i = 0; i < len && !stopped; i++) {
+    putLogChar((char)data[i]);
+  }
+}
+
+/**
+ * Drop a cut-off final sentence and hand over the last epoch
+ * 
+ * @return the scan statistics
+ */
+const ReplayScanStats& ReplayLogScanner::finish() {
+  if (state != BETWEEN) abandonSentence();
+  if (!stopped) flushEpoch();
+  return result;
+}
+
+// One character of the log file: strip "name: " from the start of each line
+void ReplayLogScanner::putLogChar(char c) {
+  if (c == '\n') {
+    atLineStart = true;
+    prefixLength = 0;
+    skipSpace = false;
+    return;
+  }
+  if (skipSpace) {
+    skipSpace = false;
+    if (c == ' ') return;
+  }
+  if (atLineStart) {
+    bool nameChar = isalnum((unsigned char)c) || c == '-' || c == '_';
+    if (nameChar && prefixLength < (int)sizeof(prefix)) {
+      prefix[prefixLength++] = c;
+      return;
+    }
+    atLineStart = false;
+    if (c == ':' && prefixLength > 0) {
+      prefixLength = 0;
+      skipSpace = true;        // "uart-1: " - the decoder's name, not data
+      return;
+    }
+    for (int i = 0; i < prefixLength; i++) {
+      putPayloadChar(prefix[i]);  // Not a prefix after all
+    }
+    prefixLength = 0;
+  }
+  putPayloadChar(c);
+}
+
+// One character of what was on the wire
+void ReplayLogScanner::putPayloadChar(char c) {
+  if (c == '$' || c == '!') {
+    if (state != BETWEEN) abandonSentence();  // The previous one never finished
+    state = IN_BODY;
+    sentence[0] = c;
+    sentenceLength = 1;
+    checksum = 0;
+    return;
+  }
+
+  if (state == BETWEEN) return;  // CR/LF (or the '?' shown for them) and noise
+
+  if (state == IN_BODY) {
+    if (c < 0x20 || c > 0x7E) {
+      abandonSentence();         // Line ended without a checksum
+      return;
+    }
+    if (c == '*') {
+      state = IN_CHECKSUM;
+      checksumDigits = 0;
+    } else {
+      checksum ^= c;
+    }
+  } else if (!isxdigit((unsigned char)c)) {
+    abandonSentence();
+    return;
+  }
+
+  if (sentenceLength >= REPLAY_SENTENCE_MAX) {
+    abandonSentence();
+    return;
+  }
+  sentence[sentenceLength++] = c;
+
+  if (state == IN_CHECKSUM && c != '*' && ++checksumDigits == 2) {
+    endSentence();
+  }
+}
+
+void ReplayLogScanner::abandonSentence() {
+  result.fragments++;
+  state = BETWEEN;
+}
+
+void ReplayLogScanner::endSentence() {
+  state = BETWEEN;
+  const char* hex = sentence + sentenceLength - 2;
+  if (((hexValue(hex[0]) << 4) | hexValue(hex[1])) != checksum) {
+    result.badChecksum++;
+    return;
+  }
+  addSentence();
+}
+
+// Add a checked sentence to the current epoch, starting a new epoch when its time moves on
+void ReplayLogScanner::addSentence() {
+  // Sentence types with a UTC time (and RMC's date); proprietary ones are left alone
+  int timeIndex = 0;
+  int dateIndex = 0;
+  if (sentence[0] == '$' && sentence[1] != 'P' && sentenceLength > 6) {
+    const char* type = sentence + 3;
+    if (strncmp(type, "RMC", 3) == 0) {
+      timeIndex = 1;
+      dateIndex = 9;
+    } else if (strncmp(type, "GGA", 3) == 0 || strncmp(type, "GNS", 3) == 0 ||
+               strncmp(type, "GBS", 3) == 0 || strncmp(type, "GST", 3) == 0 ||
+               strncmp(type, "ZDA", 3) == 0) {
+      timeIndex = 1;
+    } else if (strncmp(type, "GLL", 3) == 0) {
+      timeIndex = 5;
+    }
+  }
+  uint8_t timeField = digitFieldOffset(sentence, sentenceLength, timeIndex);
+  uint8_t dateField = digitFieldOffset(sentence, sentenceLength, dateIndex);
+
+  long timeMs = timeField ? parseNMEATimeMs(sentence + timeField) : -1;
+  if (timeMs >= 0 && (!timeSeen || timeMs != epochTimeMs)) {
+    if (timeSeen) {
+      if (!flushEpoch()) return;
+      long elapsed = timeMs - epochTimeMs;
+      if (elapsed < 0) elapsed += 86400000L;  // Crossed UTC midnight
+      epochOffsetMs += elapsed;
+    }
+    // The log's first time also covers any untimed sentences before it
+    timeSeen = true;
+    epochTimeMs = timeMs;
+  }
+
+  // An epoch that is full carries on in a second one at the same offset
+  size_t length = sentenceLength + 2;
+  ReplayEpochHeader& header = epoch.header;
+  if (header.sentenceCount == REPLAY_EPOCH_SENTENCES_MAX || header.byteCount + length > REPLAY_EPOCH_BYTES_MAX) {
+    if (!flushEpoch()) return;
+  }
+
+  ReplaySentence& entry = epoch.sentences[header.sentenceCount++];
+  entry.start = header.byteCount;
+  entry.length = (uint8_t)length;
+  entry.timeField = timeField;
+  entry.dateField = dateField;
+  entry.reserved = 0;
+  char* out = epoch.bytes + header.byteCount;
+  memcpy(out, sentence, sentenceLength);
+  out[sentenceLength] = '\r';     // Sent as the module sent it, CR/LF included
+  out[sentenceLength + 1] = '\n';
+  header.byteCount += length;
+  result.sentences++;
+}
+
+// Hand the current epoch over, if it has anything in it
+bool ReplayLogScanner::flushEpoch() {
+  ReplayEpochHeader& header = epoch.header;
+  if (header.sentenceCount == 0) return true;
+
+  header.offsetMs = epochOffsetMs;
+  header.reserved = 0;
+  if (!onEpoch(epoch, handlerContext)) {
+    stopped = true;
+    return false;
+  }
+  result.epochs++;
+  result.durationMs = epochOffsetMs;
+  header.byteCount = 0;
+  header.sentenceCount = 0;
+  return true;
+}
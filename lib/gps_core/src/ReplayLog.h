@@ -0,0 +1,131 @@
+/*
+Raw log replay (gps_core)
+=========================
+
+Turns a recorded capture back into the exact sentences a module sent,
+grouped by epoch: either a sigrok-cli UART decode in ascii_stream format
+("uart-1: " lines, CR/LF shown as '?', sentences wrapped at any column) or
+a plain NMEA log. Also the in-place time/date rewrite used at playback.
+No Arduino dependencies - also built natively for the tests under test/.
+The functions are documented with their definitions in ReplayLog.cpp.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+const size_t REPLAY_SENTENCE_MAX = 82;            // NMEA 0183 limit, '$' to checksum
+const int REPLAY_EPOCH_SENTENCES_MAX = 24;        // Leaves room in the sketch's 32-slot ring
+const size_t REPLAY_EPOCH_BYTES_MAX = 1024;       // One burst buffer in the sketch
+
+// Where one sentence sits in its epoch, and which of its fields carry the time
+struct ReplaySentence {
+  uint16_t start;           // Offset of '$' in the epoch's bytes
+  uint8_t length;           // Bytes including the trailing CR/LF
+  uint8_t timeField;        // Offset of "hhmmss" from '$', 0 = none
+  uint8_t dateField;        // Offset of "ddmmyy" from '$', 0 = none
+  uint8_t reserved;         // Zero
+};
+
+// Stored on flash in front of each epoch's sentence table and bytes
+struct ReplayEpochHeader {
+  uint32_t offsetMs;        // Time since the log's first epoch
+  uint16_t byteCount;       // Wire bytes in the epoch
+  uint8_t sentenceCount;    // ReplaySentence entries that follow this header
+  uint8_t reserved;         // Zero
+};
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Epochs From a Byte Stream
+ * 
+ * WHAT: One epoch is everything a module sent for one fix - RMC through TXT
+ * WHY: A capture has no timing of its own here (sigrok's ascii_stream output
+ *      prints bytes only), but every burst carries its UTC time, and a module
+ *      sends a burst back to back at the start of each epoch
+ * HOW: An epoch starts at the first sentence whose time field differs from
+ *      the current epoch's; sentences without a time (GSA, GSV, TXT) stay in
+ *      the epoch they arrived in. Its offset is that time minus the first
+ *      epoch's, so playback reproduces the module's epoch cadence exactly
+ * GOTCHAS: A time earlier than the previous one is taken as UTC midnight.
+ *          An epoch that outgrows REPLAY_EPOCH_BYTES_MAX is split, the
+ *          second part at the same offset - bytes are never dropped for size
+ * 
+ * Example: the NEO-6M sample is 1 Hz, ~540 bytes and 9 sentences per epoch
+ */
+struct ReplayEpoch {
+  ReplayEpochHeader header;
+  ReplaySentence sentences[REPLAY_EPOCH_SENTENCES_MAX];
+  char bytes[REPLAY_EPOCH_BYTES_MAX];
+};
+
+// Outcome of a scan, reported back to the uploader
+struct ReplayScanStats {
+  uint32_t sentences = 0;   // Kept, in epochs
+  uint32_t epochs = 0;      // Handed to the epoch handler
+  uint32_t badChecksum = 0; // Dropped - corrupted in the capture
+  uint32_t fragments = 0;   // Dropped - cut off, overlong or without a checksum
+  uint32_t durationMs = 0;  // Offset of the last epoch
+};
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Sentence Boundaries From a Decoder Log
+ * 
+ * WHAT: Incremental scanner fed with arbitrary chunks of a capture
+ * WHY: sigrok prefixes every line with its decoder name and breaks lines at
+ *      a fixed width, so a log line is not a sentence
+ * HOW: A "name: " prefix at the start of a log line is dropped. Everything
+ *      else is one stream: '$' (or '!') starts a sentence, and the two hex
+ *      digits after '*' end it - then its checksum must match. Bytes between
+ *      sentences (the '?' that stand for CR/LF, real CR/LF) are ignored and
+ *      every kept sentence is stored with its own CR/LF
+ * GOTCHAS: UBX frames cannot survive a text decode and are not looked for
+ * 
+ * Example: "uart-1: ,04,31,,,,,,,,,6.27,4.89,3.92,1*0A??$GNGSA,A,3,,,"
+ *          completes a GSA begun on the line before and starts the next one
+ */
+class ReplayLogScanner {
+public:
+  // Receives each finished epoch; return false to stop the scan (e.g. flash full)
+  typedef bool (*EpochHandler)(const ReplayEpoch& epoch, void* context);
+
+  void begin(EpochHandler handler, void* context);
+  void feed(const uint8_t* data, size_t len);
+  const ReplayScanStats& finish();
+  bool ok() const { return !stopped; }
+
+private:
+  void putLogChar(char c);
+  void putPayloadChar(char c);
+  void abandonSentence();
+  void endSentence();
+  void addSentence();
+  bool flushEpoch();
+
+  EpochHandler onEpoch = nullptr;
+  void* handlerContext = nullptr;
+  ReplayScanStats result;
+  bool stopped = false;
+
+  // Log line prefix ("uart-1: ") detection
+  char prefix[16];
+  int prefixLength = 0;
+  bool atLineStart = true;
+  bool skipSpace = false;
+
+  // Sentence being assembled
+  char sentence[REPLAY_SENTENCE_MAX + 1];
+  size_t sentenceLength = 0;
+  enum { BETWEEN, IN_BODY, IN_CHECKSUM } state = BETWEEN;
+  uint8_t checksum = 0;
+  int checksumDigits = 0;
+
+  // Epoch being assembled
+  ReplayEpoch epoch;
+  bool timeSeen = false;       // Has any sentence carried a time yet?
+  long epochTimeMs = 0;        // Time of day of the current epoch
+  uint32_t epochOffsetMs = 0;  // ...and its offset from the first
+};
+
+long parseNMEATimeMs(const char* text);
+void rewriteReplaySentence(char* text, const ReplaySentence& info, const char* hhmmss, const char* ddmmyy);
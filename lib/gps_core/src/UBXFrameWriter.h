@@ -0,0 +1,80 @@
+/*
+UBX binary frame encoding (gps_core)
+====================================
+
+u-blox UBX framing with the 8-bit Fletcher checksum. No Arduino
+dependencies - also built natively for the tests under test/.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: UBX Binary Messages
+ * 
+ * WHAT: u-blox's native binary protocol - NAV-PVT, NAV-POSLLH and NAV-SOL
+ *       carry the same fix as RMC/GGA in 36-100 bytes instead of ~600
+ * WHY: Binary output lets us raise fix rates at 9600 baud that the NMEA burst
+ *      physically can't sustain, and lets us test receivers' UBX parsers
+ * HOW: Frame = 0xB5 0x62, class, id, little-endian U2 length, payload, CK_A,
+ *      CK_B. The checksum is an 8-bit Fletcher sum over class..payload,
+ *      accumulated as the frame is finished
+ * GOTCHAS: All multi-byte fields are little-endian and most units are integer
+ *          (mm, mm/s, 1e-7 degrees, 1e-5 degrees for heading). iTOW is GPS
+ *          time, which is ahead of UTC by the leap seconds (18 since 2017)
+ * 
+ * Example: NAV-POSLLH = B5 62 01 02 1C 00 <28 bytes> CK_A CK_B
+ * References: u-blox 6 Receiver Description, sections "UBX Protocol" and "NAV"
+ */
+const uint8_t UBX_SYNC_1 = 0xB5;
+const uint8_t UBX_SYNC_2 = 0x62;
+const uint8_t UBX_CLASS_NAV = 0x01;
+const uint8_t UBX_NAV_POSLLH = 0x02;
+const uint8_t UBX_NAV_SOL = 0x06;
+const uint8_t UBX_NAV_PVT = 0x07;
+const int UBX_MAX_PAYLOAD = 92;          // NAV-PVT, the largest message we send
+
+class UBXFrameWriter {
+public:
+  void begin(uint8_t messageClass, uint8_t messageId) {
+    buffer[0] = UBX_SYNC_1;
+    buffer[1] = UBX_SYNC_2;
+    buffer[2] = messageClass;
+    buffer[3] = messageId;
+    len = 6;  // Payload starts after the 2-byte length field
+  }
+  
+  void u1(uint8_t value) { if (len < sizeof(buffer) - 2) buffer[len++] = value; }
+  void u2(uint16_t value) { u1(value & 0xFF); u1(value >> 8); }
+  void u4(uint32_t value) { u2(value & 0xFFFF); u2(value >> 16); }
+  void i1(int8_t value) { u1((uint8_t)value); }
+  void i2(int16_t value) { u2((uint16_t)value); }
+  void i4(int32_t value) { u4((uint32_t)value); }
+  void reserved(int count) { while (count-- > 0) u1(0); }
+  
+  /**
+   * Fill in the payload length and append the Fletcher checksum
+   */
+  void finish() {
+    uint16_t payloadLength = len - 6;
+    buffer[4] = payloadLength & 0xFF;
+    buffer[5] = payloadLength >> 8;
+    
+    uint8_t ckA = 0, ckB = 0;
+    for (size_t i = 2; i < len; i++) {   // Class, id, length and payload
+      ckA += buffer[i];
+      ckB += ckA;
+    }
+    buffer[len++] = ckA;
+    buffer[len++] = ckB;
+  }
+  
+  const uint8_t* data() const { return buffer; }
+  size_t length() const { return len; }
+  
+private:
+  uint8_t buffer[6 + UBX_MAX_PAYLOAD + 2];
+  size_t len = 0;
+};
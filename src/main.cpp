@@ -3,7 +3,8 @@ GPS Simulator for ESP32 M5 Stick C Plus
 ========================================
 
 This project simulates a u-blox neo-6m GPS module by:
-1. Reading GPS track data from uploaded CSV files
+1. Reading GPS track data from uploaded CSV files (or replaying a recorded
+   capture byte for byte)
 2. Converting coordinates to proper NMEA format
 3. Outputting authentic NMEA sentences via dual channels (GPIO UART + USB Serial) at 9600 baud
 4. Providing web interface for control, file upload, and output configuration
@@ -20,19 +21,34 @@ Educational Focus: Demonstrates embedded systems programming concepts including:
 
 Hardware: ESP32 M5 Stick C Plus with integrated display
 Output: Dual channel - GPIO 32 (UART1) + USB Serial (UART0) at 9600 baud, 8N1, no flow control
+        (GPIO baud configurable 4800-115200 from the web interface)
+        plus the same bursts over WiFi: WebSocket ws://<ip>/ws and raw TCP port 10110
 */
 
 #include <Arduino.h>
 #include <M5StickCPlus.h>
 #include <WiFi.h>
-#include <WiFiUdp.h>
 #include <Update.h>
 #include <ESPAsyncWebServer.h>
 #include <AsyncElegantOTA.h>
 #include <SPIFFS.h>
-#include <NTPClient.h>
-#include <TimeLib.h>
 #include <TinyGPS++.h>
+#include <atomic>
+#include <driver/uart.h>
+#include <esp_timer.h>
+#include <driver/gpio.h>
+#include <freertos/message_buffer.h>
+#include <esp_sntp.h>
+#include <sys/time.h>
+
+// Platform-independent track parsing and protocol encoding (lib/gps_core) -
+// also built natively by [env:native] for the tests and benchmarks in test/
+#include "GPSData.h"
+#include "CSVTrack.h"
+#include "NMEASentenceWriter.h"
+#include "UBXFrameWriter.h"
+#include "CivilDate.h"
+#include "ReplayLog.h"
 
 #include "mercator_secrets.c"  // WiFi credentials and configuration
 
@@ -41,10 +57,24 @@ Output: Dual channel - GPIO 32 (UART1) + USB Serial (UART0) at 9600 baud, 8N1, n
 // =============================================================================
 
 // GPS UART configuration - ESP32 has multiple hardware serial ports
-// We use Serial1 (UART1) to avoid conflicts with USB debugging (Serial0)
-HardwareSerial gpsSerial(1);
+// We use UART1 to avoid conflicts with USB debugging (UART0), driven directly
+// through the ESP-IDF UART driver so a whole burst is one buffered write
+const uart_port_t GPS_UART = UART_NUM_1;
 const int GPS_TX_PIN = 32;  // GPIO 32 for transmit to GPS receiver
-const int GPS_RX_PIN = 33;  // GPIO 33 for receive (unused in TX-only simulation)
+const int GPS_RX_PIN = 33;  // GPIO 33 for receive - host configuration commands
+const int GPS_UART_TX_BUFFER = 2048;  // Driver TX ring - two full bursts
+const int GPS_UART_RX_BUFFER = 256;   // Minimum the driver accepts; commands are short
+
+// Secondary GPS module (simulation channel B) - the ESP32's third UART.
+// TX only; G0 is a strapping pin, so the receiver must not pull it low at reset
+const uart_port_t AUX_UART = UART_NUM_2;
+const int AUX_TX_PIN = 0;             // G0 on the M5StickC Plus header
+const int AUX_UART_TX_BUFFER = 1024;  // Holds a whole NMEA burst
+
+// Timepulse output - rising edge at the top of every UTC second, like the
+// neo-6m's TIMEPULSE pin (GPIO 26 is free on the M5StickC Plus header)
+const int PPS_PIN = 26;
+const uint32_t PPS_PULSE_US = 100000;  // 100ms high, the neo-6m default pulse length
 
 // =============================================================================
 // NETWORK AND WEB SERVICES
@@ -55,10 +85,100 @@ const int GPS_RX_PIN = 33;  // GPIO 33 for receive (unused in TX-only simulation
 AsyncWebServer server(80);
 AsyncElegantOtaClass AsyncElegantOTA;  // Over-the-air update capability
 
-// Network Time Protocol for accurate timestamp synchronization
-// UDP is used because NTP is a connectionless protocol
-WiFiUDP ntpUDP;
-NTPClient timeClient(ntpUDP);  // Connects to pool.ntp.org by default
+/**
+ * 🎯 EDUCATIONAL BLOCK: Streaming JSON Responses
+ * 
+ * WHAT: Writes JSON field by field straight into a Print - for the web
+ *       handlers, an AsyncResponseStream
+ * WHY: /status was one String grown by some sixty "+=" of String temporaries
+ *      inside the web server callback: dozens of heap allocations per poll,
+ *      and a peak of twice the response while the String reallocated, all
+ *      while the generator task was running
+ * HOW: Keys, numbers and literals are printed directly; the only heap used
+ *      is the response stream's buffer, sized once up front
+ * GOTCHAS: Keys are printed as given - pass plain identifiers only. String
+ *          values are escaped. Nesting is limited to JSON_MAX_DEPTH levels
+ * 
+ * Example: json.beginObject().field("csv_loaded", true).field("uart_baud", 9600).endObject()
+ *          prints {"csv_loaded":true,"uart_baud":9600}
+ */
+const int JSON_MAX_DEPTH = 8;
+const size_t STATUS_JSON_RESERVE = 3072;  // /status runs to ~2.5 KB with both channels; sized so it never regrows
+
+class JsonPrinter {
+public:
+  explicit JsonPrinter(Print& output) : out(output) {}
+  
+  // Containers - pass a key inside an object, nullptr inside an array or at the top
+  JsonPrinter& beginObject(const char* key = nullptr) { open(key, '{'); return *this; }
+  JsonPrinter& endObject() { close('}'); return *this; }
+  JsonPrinter& beginArray(const char* key = nullptr) { open(key, '['); return *this; }
+  JsonPrinter& endArray() { close(']'); return *this; }
+  
+  JsonPrinter& field(const char* key, bool value) { name(key); out.print(value ? "true" : "false"); return *this; }
+  JsonPrinter& field(const char* key, int value) { name(key); out.print(value); return *this; }
+  JsonPrinter& field(const char* key, unsigned int value) { name(key); out.print(value); return *this; }
+  JsonPrinter& field(const char* key, long value) { name(key); out.print(value); return *this; }
+  JsonPrinter& field(const char* key, unsigned long value) { name(key); out.print(value); return *this; }
+  JsonPrinter& field(const char* key, long long value) { name(key); out.print(value); return *this; }
+  JsonPrinter& field(const char* key, unsigned long long value) { name(key); out.print(value); return *this; }
+  JsonPrinter& field(const char* key, double value, int decimals) { name(key); out.print(value, decimals); return *this; }
+  JsonPrinter& field(const char* key, const String& value) { return field(key, value.c_str()); }
+  
+  JsonPrinter& field(const char* key, const char* value) {
+    name(key);
+    out.print('"');
+    for (const char* c = value; *c; c++) {
+      if (*c == '"' || *c == '\\') out.print('\\');
+      out.print((unsigned char)*c < 0x20 ? ' ' : *c);  // No control characters in a JSON string
+    }
+    out.print('"');
+    return *this;
+  }
+  
+private:
+  // Comma before every member but the first, then the key if there is one
+  void name(const char* key) {
+    if (!first[depth]) out.print(',');
+    first[depth] = false;
+    if (key) {
+      out.print('"');
+      out.print(key);
+      out.print("\":");
+    }
+  }
+  
+  void open(const char* key, char bracket) {
+    name(key);
+    out.print(bracket);
+    if (depth < JSON_MAX_DEPTH) depth++;
+    first[depth] = true;
+  }
+  
+  void close(char bracket) {
+    out.print(bracket);
+    if (depth > 0) depth--;
+  }
+  
+  Print& out;
+  bool first[JSON_MAX_DEPTH + 1] = {true};
+  int depth = 0;
+};
+
+/**
+ * Reply {"success":false,"error":"..."} with the message escaped
+ */
+void sendJsonError(AsyncWebServerRequest* request, int code, const char* message) {
+  AsyncResponseStream* response = request->beginResponseStream("application/json", 128);
+  response->setCode(code);
+  JsonPrinter json(*response);
+  json.beginObject().field("success", false).field("error", message).endObject();
+  request->send(response);
+}
+
+// Network Time Protocol for accurate timestamp synchronization - the ESP-IDF
+// SNTP client runs in the background, see the time service with the epoch clock
+const char* NTP_SERVER = "pool.ntp.org";
 
 // =============================================================================
 // WIFI CONFIGURATION AND STATE MANAGEMENT
@@ -86,8 +206,12 @@ bool ntpSyncAvailable = false;                // NTP only works in client mode
 bool ntpSyncCompleted = false;                // Has NTP sync been successful at least once?
 unsigned long lastNtpSyncAttempt = 0;         // When was the last NTP sync attempted
 unsigned long lastSuccessfulNtpSync = 0;     // When was NTP last successful
+volatile uint32_t timeSyncCount = 0;          // SNTP samples applied to the time service
 const unsigned long NTP_SYNC_TIMEOUT = 10000; // 10 seconds timeout for NTP sync attempts
 
+void startTimeService();  // Defined with the epoch clock
+int64_t utcMicros();
+
 // =============================================================================
 // OUTPUT CONFIGURATION
 // =============================================================================
@@ -108,131 +232,685 @@ const unsigned long NTP_SYNC_TIMEOUT = 10000; // 10 seconds timeout for NTP sync
 bool gpioOutputEnabled = true;    // Enable NMEA output via GPIO pins 32/33
 bool usbOutputEnabled = true;     // Enable NMEA output via USB Serial port
 
+// Output channels, used as a bit mask on each queued message
+const uint8_t CHANNEL_GPIO = 0x01;
+const uint8_t CHANNEL_USB = 0x02;
+const uint8_t CHANNEL_AUX = 0x04;   // UART2 - simulation channel B's own module
+const uint8_t CHANNEL_NET = 0x08;   // WebSocket and TCP clients - see NETWORK SINKS
+
+// Protocol spoken on each channel - a bit mask, so BOTH = NMEA | UBX
+enum OutputProtocol : uint8_t {
+  PROTOCOL_NMEA = 0x01,     // NMEA 0183 text sentences (neo-6m default)
+  PROTOCOL_UBX = 0x02,      // u-blox binary NAV messages
+  PROTOCOL_BOTH = 0x03
+};
+OutputProtocol gpioProtocol = PROTOCOL_NMEA;
+OutputProtocol usbProtocol = PROTOCOL_NMEA;
+OutputProtocol netProtocol = PROTOCOL_NMEA;
+
+// Network clients connected - nothing is queued for the network while there are none
+volatile int netClientCount = 0;
+
+// Set while a secondary channel's burst is encoded: its NMEA goes only to
+// these outputs. 0 = the primary module's per-protocol routing
+uint8_t encodingOutputs = 0;
+
+/**
+ * Channels that should receive messages of the given protocol
+ */
+uint8_t channelsForProtocol(OutputProtocol protocol) {
+  uint8_t channels = 0;
+  if (gpioProtocol & protocol) channels |= CHANNEL_GPIO;
+  if (usbProtocol & protocol) channels |= CHANNEL_USB;
+  if ((netProtocol & protocol) && netClientCount > 0) channels |= CHANNEL_NET;
+  return channels;
+}
+
+const char* protocolName(OutputProtocol protocol) {
+  return protocol == PROTOCOL_BOTH ? "both" : protocol == PROTOCOL_UBX ? "ubx" : "nmea";
+}
+
+// GPIO UART baud rate - 9600 is the neo-6m default, saved in /gps_baud.txt
+uint32_t gpsBaudRate = 9600;
+volatile uint32_t pendingBaudRate = 0;  // Applied by the output task, 0 = none
+
 // =============================================================================
 // GPS SIMULATION STATE VARIABLES
 // =============================================================================
 
-// File handle for the GPS track CSV data stored in SPIFFS flash memory
-File csvFile;
+// CSV left by older firmware - compiled into the track library at boot
+const char* TRACK_CSV_PATH = "/gps_track.csv";
+
+// Compiled tracks live in the library as /tracks/<name>.bin - see TRACK CATALOG.
+// SPIFFS paths are at most 31 characters, so names are kept to 16
+const int TRACK_NAME_MAX = 16;
+
+String trackPath(const char* name) {
+  return "/tracks/" + String(name) + ".bin";
+}
 
 // System state flags - using boolean for clarity and memory efficiency
 bool gpsSimActive = false;     // Is GPS simulation currently running?
-bool csvLoaded = false;        // Has a CSV file been successfully loaded?
-
-// Timing control for precise 1-second GPS fix intervals
-// Using unsigned long to handle millis() rollover after ~49 days
-unsigned long lastGpsOutput = 0;
 
-// Current position in CSV file - helps with debugging and status display
-int currentLine = 0;
 
 // =============================================================================
 // GPS DATA STRUCTURES
 // =============================================================================
 
+// GPSData itself (one fix) is defined in lib/gps_core/src/GPSData.h
+
+struct TrackRecord;            // Compiled fix, see COMPILED BINARY TRACK FORMAT
+
+// Geometry of the segment currentGPS → nextGPS, computed once per segment
+struct TrackSegment {
+  uint32_t startMs = 0;               // currentGPS.track_time_ms
+  uint32_t durationMs = 0;            // Time to nextGPS
+  bool loops = false;                 // nextGPS is the track loop point (first fix)
+  bool interpolate = false;           // false for the loop segment
+  double angle = 0;                   // Central angle between the fixes (radians)
+  double sinAngle = 0;
+  double fromVector[3];               // Fixes as unit vectors on the sphere
+  double toVector[3];
+};
+
 /**
- * Structure to hold parsed GPS data from CSV file
+ * 🎯 EDUCATIONAL BLOCK: Simulation Channels
  * 
- * This struct represents a single GPS fix with all the information needed
- * to generate authentic NMEA sentences. Using a struct improves code
- * readability and makes data passing more efficient than individual variables.
+ * WHAT: Each emulated GPS module is a SimChannel - its own compiled track,
+ *       playback position and interpolated fix
+ * WHY: Multi-diver tests need one M5Stick to act as several GPS modules. With
+ *      the track file, fixes and playback position as globals there could
+ *      only ever be one
+ * HOW: simChannels[0] is the primary module: GPIO 32/33 plus USB, with the
+ *      protocols, message rates, byte budget and host commands as before.
+ *      The other channels are NMEA-only modules on further UARTs, each with
+ *      its own track, baud rate, sentence mask and start offset into its
+ *      track. One epoch clock and one generator task drive them all - every
+ *      epoch each channel's fix is interpolated once and its sentences are
+ *      encoded once, into the shared output ring under its own output bit
+ * GOTCHAS: The ESP32 has three UARTs and UART0 is the USB port, so there is
+ *          one secondary module (UART2, TX on G0). The sky is shared, as it
+ *          would be for receivers side by side, but each module reports its
+ *          own track's satellite count and HDOP from it. Seek, loop range and host commands act on
+ *          the primary only; playback speed applies to every channel
+ * 
+ * Example: diver A's log on GPIO 32 at 9600 baud, diver B's on G0 at 4800
+ *          baud with RMC+GGA only, starting 90s into B's log
  */
-struct GPSData {
-  String utc_time;          // UTC time as string (HH:MM:SS format)
-  float latitude;           // Latitude in decimal degrees (positive = North)
-  float longitude;          // Longitude in decimal degrees (positive = East)
-  int sats;                 // Number of satellites used in fix
-  float hdop;               // Horizontal Dilution of Precision
-  float gps_course;         // Course over ground in degrees (0-359)
-  float gps_speed_knots;    // Speed over ground in knots
-  bool valid = false;       // Is this GPS data valid and complete?
+struct SimChannel {
+  const char* name;                   // "A", "B" ... in /status and the web UI
+  char trackName[TRACK_NAME_MAX + 1];  // Library track being played, "" = none
+  
+  // Output - secondary channels only; the primary uses the OUTPUT CONFIGURATION globals
+  uint8_t outputs;                    // Output ring channel bit
+  uart_port_t uart;
+  int txPin;
+  bool enabled;                       // Secondary module transmitting at all
+  uint32_t baudRate;
+  volatile uint32_t pendingBaudRate;  // Applied by the output task, 0 = none
+  uint8_t messageMask;                // Bit per NMEA OutputMessage (RMC, GGA, GSA, GSV, TXT)
+  uint32_t startOffsetMs;             // Where in its track the channel starts playing
+  uint16_t burstBytes;                // Size of its last burst, for the byte budget
+  
+  // Compiled track - see TRACK STORE
+  File trackFile;                     // Open while the track is not RAM-resident
+  TrackRecord* trackRecords;          // RAM copy, nullptr = read from flash
+  size_t trackResidentBytes;          // Heap used by trackRecords
+  uint32_t trackRecordCount;          // Number of fixes in the compiled track
+  uint32_t trackDurationMs;           // Offset of the last fix, read once at load
+  uint32_t currentLine;               // Next record to decode - debugging and status display
+  bool csvLoaded;                     // Has a track been successfully loaded?
+  
+  // Playback - see TRACK TIMELINE
+  GPSData currentGPS;                 // The track fix at the start of this segment
+  GPSData nextGPS;                    // The following fix - the only two rows ever decoded at once
+  GPSData epochGPS;                   // Interpolated fix for the epoch being transmitted
+  TrackSegment currentSegment;
+  uint32_t trackTimeMs;               // Playback position relative to the start of the track
+  
+  // millis() at the start of the latest epoch - the epoch clock decides when
+  // an epoch is due, this only anchors the burst scheduler's spacing offsets
+  unsigned long lastGpsOutput;
+};
+
+const int SIM_CHANNEL_COUNT = 2;
+
+// NMEA sentences a secondary module sends by default - all of them
+const uint8_t AUX_DEFAULT_MESSAGE_MASK = 0x1F;
+
+SimChannel simChannels[SIM_CHANNEL_COUNT] = {
+  { "A", "", CHANNEL_GPIO | CHANNEL_USB, GPS_UART, GPS_TX_PIN, true, 9600, 0, 0, 0, 0 },
+  { "B", "", CHANNEL_AUX, AUX_UART, AUX_TX_PIN, false, 9600, 0, AUX_DEFAULT_MESSAGE_MASK, 0, 0 }
 };
+SimChannel& primaryChannel = simChannels[0];
 
-// Current GPS data being processed - represents the "now" position
-GPSData currentGPS;
+/**
+ * Look up a channel by its name ("A", "B" ...)
+ * 
+ * @return the channel, or nullptr if there is none of that name
+ */
+SimChannel* findChannel(const String& name) {
+  for (SimChannel& ch : simChannels) {
+    if (name.equalsIgnoreCase(ch.name)) return &ch;
+  }
+  return nullptr;
+}
 
-// Future enhancement: nextGPS could be used for interpolation between points
-GPSData nextGPS;
+void simulateGPS();  // Defined with the burst scheduler, run by the generator task
+void serviceCommandReceiver();  // Defined with the command receiver, run by the generator task
 
 // =============================================================================
 // USER INTERFACE VARIABLES
 // =============================================================================
 
-// Status message displayed on M5StickC screen
-// String is used for convenience, though char arrays would be more memory efficient
-String statusMsg = "Initializing...";
+// Status message displayed on M5StickC screen and in /status. Set from loop(),
+// the web handlers and the generator task and read by the display task, so it
+// is a fixed buffer behind a spinlock - write it with setStatus() only
+const size_t STATUS_TEXT_MAX = 64;   // Longer messages are truncated
+char statusText[STATUS_TEXT_MAX] = "Initializing...";
+portMUX_TYPE statusMux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Replace the status message (any task)
+ */
+void setStatus(const char* text) {
+  portENTER_CRITICAL(&statusMux);
+  strlcpy(statusText, text, sizeof(statusText));
+  portEXIT_CRITICAL(&statusMux);
+}
+
+void setStatus(const String& text) {
+  setStatus(text.c_str());
+}
+
+/**
+ * Copy the status message out (any task) - never read statusText directly
+ */
+void copyStatus(char* out, size_t size) {
+  portENTER_CRITICAL(&statusMux);
+  strlcpy(out, statusText, size);
+  portEXIT_CRITICAL(&statusMux);
+}
+
+// =============================================================================
+// DEBUG LOG
+// =============================================================================
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Leveled RAM Log
+ * 
+ * WHAT: LOG_ERROR / LOG_WARN / LOG_INFO / LOG_DEBUG append a timestamped line
+ *       to a RAM ring buffer, which GET /logs returns
+ * WHY: Serial prints go out on UART0, the same port as the USB NMEA output -
+ *      every debug line was injected into the sentence stream a host parses,
+ *      and each synchronous print held up the task that made it
+ * HOW: LOG_LEVEL selects at compile time which macros exist; the rest expand
+ *      to nothing, so their arguments are not even evaluated. The release
+ *      env builds with LOG_LEVEL = INFO, which compiles the hot-path DEBUG
+ *      lines out. A kept line is one snprintf plus a copy into the ring
+ * GOTCHAS: The ring overwrites the oldest text when full, so /logs starts at
+ *          the first complete line. LOG_TO_SERIAL=1 echoes to USB Serial as
+ *          well - handy on the bench, but it brings the corruption back
+ * 
+ * Example: "123456 I Burst budget: 912+96 bytes vs 960 per epoch - ..."
+ */
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG  // Development default; platformio.ini sets INFO for release
+#endif
+#ifndef LOG_TO_SERIAL
+#define LOG_TO_SERIAL 0
+#endif
+
+const size_t LOG_RING_SIZE = 4096;
+const size_t LOG_LINE_MAX = 128;     // Longer lines are truncated
+
+char logRing[LOG_RING_SIZE];
+uint32_t logBytesWritten = 0;        // Total ever written; position = count % size
+portMUX_TYPE logMux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Append one formatted line to the log ring (call through the LOG_ macros)
+ * 
+ * @param level Level letter: 'E', 'W', 'I' or 'D'
+ */
+void logWrite(char level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+void logWrite(char level, const char* format, ...) {
+  char line[LOG_LINE_MAX];
+  int len = snprintf(line, sizeof(line) - 1, "%lu %c ", millis(), level);
+  va_list args;
+  va_start(args, format);
+  int body = vsnprintf(line + len, sizeof(line) - 1 - len, format, args);
+  va_end(args);
+  len = min((int)sizeof(line) - 2, len + max(body, 0));
+  line[len++] = '\n';
+  
+  portENTER_CRITICAL(&logMux);
+  for (int i = 0; i < len; i++) {
+    logRing[logBytesWritten++ % LOG_RING_SIZE] = line[i];
+  }
+  portEXIT_CRITICAL(&logMux);
+#if LOG_TO_SERIAL
+  Serial.write((const uint8_t*)line, len);
+#endif
+}
+
+const size_t LOG_COPY_CHUNK = 128;   // Bytes copied per critical section by printLogContents()
+
+/**
+ * Print the log ring, oldest complete line first (for GET /logs)
+ * 
+ * Interrupts are only held off for one LOG_COPY_CHUNK copy at a time, so
+ * the epoch timer and PPS keep their timing while a client reads the log.
+ * Lines written meanwhile are left for the next request; text overwritten
+ * meanwhile is skipped, up to the next complete line.
+ */
+void printLogContents(Print& out) {
+  portENTER_CRITICAL(&logMux);
+  uint32_t end = logBytesWritten;
+  portEXIT_CRITICAL(&logMux);
+  
+  // Once wrapped, the first line was partly overwritten - skip to the next
+  uint32_t position = end > LOG_RING_SIZE ? end - LOG_RING_SIZE : 0;
+  bool skipToLine = end > LOG_RING_SIZE;
+  char chunk[LOG_COPY_CHUNK];
+  while (position < end) {
+    size_t count = min((uint32_t)sizeof(chunk), end - position);
+    portENTER_CRITICAL(&logMux);
+    bool overwritten = logBytesWritten - position > LOG_RING_SIZE;
+    uint32_t oldest = logBytesWritten - LOG_RING_SIZE;
+    for (size_t i = 0; i < count && !overwritten; i++) {
+      chunk[i] = logRing[(position + i) % LOG_RING_SIZE];
+    }
+    portEXIT_CRITICAL(&logMux);
+    
+    if (overwritten) {
+      position = oldest;
+      skipToLine = true;
+      continue;
+    }
+    const char* start = chunk;
+    if (skipToLine) {
+      const char* newline = (const char*)memchr(chunk, '\n', count);
+      start = newline ? newline + 1 : chunk + count;
+      skipToLine = !newline;
+    }
+    out.write((const uint8_t*)start, chunk + count - start);
+    position += count;
+  }
+}
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) logWrite('E', __VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) logWrite('W', __VA_ARGS__)
+#else
+#define LOG_WARN(...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) logWrite('I', __VA_ARGS__)
+#else
+#define LOG_INFO(...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) logWrite('D', __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+
+// =============================================================================
+// HOT-PATH METRICS
+// =============================================================================
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Cycle-count Histograms
+ * 
+ * WHAT: Each stage of the epoch pipeline is timed in CPU cycles and kept as
+ *       a histogram, served with the pipeline counters as text from /metrics
+ * WHY: /status can say an epoch was late but not which stage made it so -
+ *      a mean hides the one slow record decode, the maximum alone can't tell
+ *      a one-off from a habit. p99 can
+ * HOW: ESP.getCycleCount() reads the CPU's cycle counter (CCOUNT, one
+ *      instruction, 4.17ns at 240MHz). Values go into log-linear buckets:
+ *      4 per power of two, so any value is within 25% of its bucket - 128
+ *      buckets cover the full 32-bit range in 512 bytes
+ * GOTCHAS: CCOUNT is per core, so start and end must be read on the same core -
+ *          true here because every task is pinned. A stage that is preempted
+ *          includes the time it was preempted for, which is what made the
+ *          epoch late in the first place. Each histogram has one writer task;
+ *          /metrics reads without locking and may see a record in progress
+ * 
+ * Example: stage_cycles{stage="format",stat="p99"} 3584 → 99% of sentences
+ *          were formatted and queued in under ~15µs
+ */
+enum MetricStage {
+  STAGE_DECODE,        // Track record fetch and decode (fetchNextFix)
+  STAGE_INTERPOLATE,   // Interpolation and constellation update
+  STAGE_FORMAT,        // One sentence or frame built and queued
+  STAGE_CHECKSUM,      // NMEA "*HH" suffix / UBX Fletcher checksum
+  STAGE_UART_WRITE,    // uart_write_bytes() of a GPIO burst
+  STAGE_USB_WRITE,     // Serial.write() of a USB burst
+  STAGE_EPOCH,         // Whole epoch in the generator, due → burst queued
+  STAGE_COUNT
+};
+
+const char* const STAGE_NAMES[STAGE_COUNT] = {
+  "decode", "interpolate", "format", "checksum", "uart_write", "usb_write", "epoch"
+};
+
+const uint32_t LATE_EPOCH_US = 1000;  // Burst start this far after its boundary = late
+
+class CycleHistogram {
+public:
+  static const int SUB_BUCKET_BITS = 2;
+  static const int BUCKET_COUNT = 32 << SUB_BUCKET_BITS;
+  
+  void record(uint32_t cycles) {
+    counts[bucketOf(cycles)]++;
+    if (calls == 0 || cycles < minCycles) minCycles = cycles;
+    if (cycles > maxCycles) maxCycles = cycles;
+    totalCycles += cycles;
+    calls++;
+  }
+  
+  uint32_t count() const { return calls; }
+  uint32_t lowest() const { return minCycles; }
+  uint32_t highest() const { return maxCycles; }
+  uint32_t mean() const { return calls ? totalCycles / calls : 0; }
+  
+  /**
+   * Upper bound of the bucket holding the given percentile
+   * 
+   * @param permille 990 for p99
+   */
+  uint32_t percentile(uint32_t permille) const {
+    uint32_t target = ((uint64_t)calls * permille + 999) / 1000;
+    uint32_t seen = 0;
+    for (int bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+      seen += counts[bucket];
+      if (seen >= target && seen > 0) {
+        uint32_t upper = bucket + 1 < BUCKET_COUNT ? lowerBoundOf(bucket + 1) - 1 : UINT32_MAX;
+        return upper < maxCycles ? upper : maxCycles;
+      }
+    }
+    return maxCycles;
+  }
+  
+private:
+  static int bucketOf(uint32_t value) {
+    if (value < (1u << SUB_BUCKET_BITS)) return value;
+    int msb = 31 - __builtin_clz(value);
+    int octave = msb - SUB_BUCKET_BITS + 1;
+    return (octave << SUB_BUCKET_BITS) | ((value >> (msb - SUB_BUCKET_BITS)) & ((1 << SUB_BUCKET_BITS) - 1));
+  }
+  
+  static uint32_t lowerBoundOf(int bucket) {
+    if (bucket < (1 << SUB_BUCKET_BITS)) return bucket;
+    int octave = bucket >> SUB_BUCKET_BITS;
+    uint32_t mantissa = (1u << SUB_BUCKET_BITS) | (bucket & ((1 << SUB_BUCKET_BITS) - 1));
+    return mantissa << (octave - 1);
+  }
+  
+  uint32_t counts[BUCKET_COUNT] = {0};
+  uint32_t calls = 0;
+  uint32_t minCycles = 0;
+  uint32_t maxCycles = 0;
+  uint64_t totalCycles = 0;
+};
+
+CycleHistogram stageCycles[STAGE_COUNT];
+
+// Pipeline counters for /metrics (the ring and budget keep their own drop counts)
+volatile uint32_t gpioBytesSent = 0;
+volatile uint32_t usbBytesSent = 0;
+volatile uint32_t auxBytesSent = 0;
+volatile uint32_t lateEpochs = 0;
+
+// Time a stage: uint32_t start = ESP.getCycleCount(); ... recordStage(STAGE_X, start);
+inline void recordStage(MetricStage stage, uint32_t startCycles) {
+  stageCycles[stage].record(ESP.getCycleCount() - startCycles);  // Unsigned - wraps correctly
+}
 
 // =============================================================================
 // DISPLAY AND USER INTERFACE FUNCTIONS
 // =============================================================================
 
 /**
- * Update the M5StickC Plus LCD display with current system status
+ * 🎯 EDUCATIONAL BLOCK: Seqlock Snapshots
+ * 
+ * WHAT: A lock-free way for the generator to hand the display a consistent
+ *       copy of the latest fix
+ * WHY: The generator holds gpsStateMutex for a whole epoch; if the display
+ *      took it too, a slow SPI redraw could hold up the next burst
+ * HOW: The writer makes the sequence number odd, copies the data in, then
+ *      makes it even again. A reader copies the data out between two reads
+ *      of the number, and trusts the copy only if the number was even and
+ *      did not change - otherwise it tries again
+ * GOTCHAS: Only one writer (the generator task). The reader never blocks the
+ *          writer, so on a miss the display just keeps the previous copy
+ * 
+ * Example: sequence 6 → 7 (writing) → 8; a read that saw 6 then 8 is discarded
+ */
+struct DisplaySnapshot {
+  int32_t latitudeE7 = 0;
+  int32_t longitudeE7 = 0;
+  float speedKnots = 0;
+  float course = 0;
+  int sats = 0;
+  char utcTime[12] = "";          // HHMMSS.SS as sent
+  uint32_t fixNumber = 0;         // Primary channel's next record
+  uint32_t fixCount = 0;          // 0 until the first epoch has been published
+};
+
+DisplaySnapshot displaySnapshot;
+std::atomic<uint32_t> displaySnapshotSeq{0};
+
+/**
+ * Publish the primary channel's epoch fix for the display (generator task only)
+ */
+void publishDisplaySnapshot(const SimChannel& ch) {
+  DisplaySnapshot snapshot;
+  snapshot.latitudeE7 = ch.epochGPS.latitudeE7;
+  snapshot.longitudeE7 = ch.epochGPS.longitudeE7;
+  snapshot.speedKnots = ch.epochGPS.gps_speed_knots;
+  snapshot.course = ch.epochGPS.gps_course;
+  snapshot.sats = ch.epochGPS.sats;
+  memcpy(snapshot.utcTime, ch.epochGPS.utc_time, sizeof(snapshot.utcTime));
+  snapshot.fixNumber = ch.currentLine;
+  snapshot.fixCount = ch.trackRecordCount;
+  
+  uint32_t seq = displaySnapshotSeq.load(std::memory_order_relaxed);
+  displaySnapshotSeq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);  // Odd before any of the data
+  displaySnapshot = snapshot;
+  displaySnapshotSeq.store(seq + 2, std::memory_order_release);
+}
+
+/**
+ * Copy out the latest snapshot
+ * 
+ * @return false if every attempt overlapped a write - out is then untouched
+ */
+bool readDisplaySnapshot(DisplaySnapshot& out) {
+  for (int attempt = 0; attempt < 4; attempt++) {
+    uint32_t before = displaySnapshotSeq.load(std::memory_order_acquire);
+    if (before & 1) continue;               // Write in progress on the other core
+    DisplaySnapshot copy = displaySnapshot;
+    std::atomic_thread_fence(std::memory_order_acquire);  // All of the data before the re-check
+    if (displaySnapshotSeq.load(std::memory_order_relaxed) == before) {
+      out = copy;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Dirty-Region Redraws
  * 
- * The display provides immediate visual feedback about system state without
- * requiring network connectivity. This is crucial for debugging and field use.
+ * WHAT: The screen is a fixed set of text rows, and a row is only sent over
+ *       SPI when its text has changed
+ * WHY: A full fillScreen() plus redraw is ~65 KB of pixels on the LCD's SPI
+ *      bus; most of the time one or two rows have actually changed
+ * HOW: Each row remembers the text on the glass. New text is padded to the
+ *      row's full width and drawn with an opaque background, so the old
+ *      glyphs are overwritten without a clear - no flicker either
+ * GOTCHAS: Row text is cut at the screen width (20 characters at size 2);
+ *          status messages were already cut to one row by the bottom edge
+ */
+const int DISPLAY_WIDTH = 240;        // M5StickC Plus in rotation 3
+const int DISPLAY_COLUMNS_MAX = 40;   // Size 1 text: 6 pixels per character
+const uint32_t DISPLAY_REFRESH_MS = 1000;  // Live readout rate; displayStatus() redraws at once
+
+struct DisplayRow {
+  int16_t y;
+  uint8_t textSize;
+  char shown[DISPLAY_COLUMNS_MAX + 1];   // What is on the glass now
+};
+
+enum DisplayRowId {
+  ROW_TITLE, ROW_FIX, ROW_WIFI, ROW_IP, ROW_ID, ROW_TRACK, ROW_GPS, ROW_OUTPUT, ROW_STATUS,
+  DISPLAY_ROW_COUNT
+};
+
+// Two small lines for the live readout, then the status rows at twice the size
+DisplayRow displayRows[DISPLAY_ROW_COUNT] = {
+  {0, 1, ""}, {8, 1, ""},
+  {16, 2, ""}, {32, 2, ""}, {48, 2, ""}, {64, 2, ""}, {80, 2, ""}, {96, 2, ""}, {112, 2, ""}
+};
+
+TaskHandle_t displayTaskHandle = nullptr;
+
+/**
+ * Draw a row if - and only if - its text differs from what is shown
+ */
+void drawDisplayRow(DisplayRow& row, const char* text) {
+  int columns = DISPLAY_WIDTH / (6 * row.textSize);
+  char padded[DISPLAY_COLUMNS_MAX + 1];
+  snprintf(padded, columns + 1, "%-*s", columns, text);
+  if (strcmp(padded, row.shown) == 0) return;   // Unchanged - no SPI traffic
+  
+  M5.Lcd.setTextSize(row.textSize);
+  M5.Lcd.setTextColor(WHITE, BLACK);             // Opaque background overwrites the old text
+  M5.Lcd.setCursor(0, row.y);
+  M5.Lcd.print(padded);
+  strcpy(row.shown, padded);
+}
+
+/**
+ * Bring every row of the display up to date
  * 
  * Layout:
- * - Title and separator
- * - WiFi connection status and IP address
- * - CSV file load status
- * - GPS simulation active/stopped status  
+ * - Title and UTC time, then position, speed, course and satellites
+ * - WiFi connection status, IP address and network name
+ * - Track name
+ * - GPS simulation active/stopped status and fix count
+ * - Enabled outputs
  * - Current status message
  */
-void displayStatus() {
-  // Clear screen with black background for better contrast and power efficiency
-  M5.Lcd.fillScreen(BLACK);
-  M5.Lcd.setTextColor(WHITE);
-  M5.Lcd.setCursor(0, 0);
-  M5.Lcd.setTextSize(2);  // Small text to fit more information on tiny screen
+void renderDisplay() {
+  static DisplaySnapshot fix;
+  readDisplaySnapshot(fix);
+  char text[DISPLAY_COLUMNS_MAX + 1];
   
-  // Application title with visual separator
-  M5.Lcd.println("GPS Simulator");
-//  M5.Lcd.println("=============");
-//  M5.Lcd.println();
+  // Live readout - blank until the first epoch has gone out
+  if (fix.fixCount > 0) {
+    snprintf(text, sizeof(text), "GPS Simulator    %.2s:%.2s:%.2s UTC",
+             fix.utcTime, fix.utcTime + 2, fix.utcTime + 4);
+    drawDisplayRow(displayRows[ROW_TITLE], text);
+    snprintf(text, sizeof(text), "%.5f%c %.5f%c %.1fkn %03dT %d",
+             abs(fix.latitudeE7) / 1e7, fix.latitudeE7 >= 0 ? 'N' : 'S',
+             abs(fix.longitudeE7) / 1e7, fix.longitudeE7 >= 0 ? 'E' : 'W',
+             fix.speedKnots, (int)fix.course, fix.sats);
+    drawDisplayRow(displayRows[ROW_FIX], text);
+  } else {
+    drawDisplayRow(displayRows[ROW_TITLE], "GPS Simulator");
+    drawDisplayRow(displayRows[ROW_FIX], "");
+  }
   
   // Network status with mode indication - critical for web interface access
-  const char* modeStr = (currentWiFiMode == WIFI_AP_MODE) ? "AP" : "Client";
-  const char* statusStr = WiFi.status() == WL_CONNECTED ? "Connect" : "Discon";
+  bool connected = WiFi.status() == WL_CONNECTED;
+  snprintf(text, sizeof(text), "WiFi %s: %s",
+           currentWiFiMode == WIFI_AP_MODE ? "AP" : "Client", connected ? "Connect" : "Discon");
+  drawDisplayRow(displayRows[ROW_WIFI], text);
   
-  M5.Lcd.printf("WiFi %s: %s\n", modeStr, statusStr);
-  
-  if (WiFi.status() == WL_CONNECTED) {
+  if (connected) {
     // Show IP address so user can access web interface
-    // toString().c_str() converts IPAddress to String to char* for printf
-    M5.Lcd.printf("IP: %s\n", WiFi.localIP().toString().c_str());
-    
-    // Show SSID in client mode, or indicate AP mode
-    if (currentWiFiMode == WIFI_AP_MODE) {
-      M5.Lcd.printf("ID: %s\n", AP_SSID);
-    } else {
-      M5.Lcd.printf("ID: %s\n", WiFi.SSID().c_str());
-    }
+    IPAddress ip = WiFi.localIP();
+    snprintf(text, sizeof(text), "IP: %u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    drawDisplayRow(displayRows[ROW_IP], text);
+    snprintf(text, sizeof(text), "ID: %s", currentWiFiMode == WIFI_AP_MODE ? AP_SSID : WiFi.SSID().c_str());
+    drawDisplayRow(displayRows[ROW_ID], text);
+  } else {
+    drawDisplayRow(displayRows[ROW_IP], "");
+    drawDisplayRow(displayRows[ROW_ID], "");
   }
-//  M5.Lcd.println();
   
   // File system status - shows if GPS data is available
-  M5.Lcd.printf("CSV: %s\n", csvLoaded ? "Loaded" : "Not loaded");
+  snprintf(text, sizeof(text), "Trk: %s", primaryChannel.csvLoaded ? primaryChannel.trackName : "none");
+  drawDisplayRow(displayRows[ROW_TRACK], text);
   
-  // GPS simulation status - shows if NMEA output is active
-  M5.Lcd.printf("GPS: %s\n", gpsSimActive ? "Active" : "Stopped");
+  // GPS simulation status - shows if NMEA output is active, and how far through the track
+  if (gpsSimActive && fix.fixCount > 0) {
+    snprintf(text, sizeof(text), "GPS: On %u/%u", (unsigned)fix.fixNumber, (unsigned)fix.fixCount);
+  } else {
+    snprintf(text, sizeof(text), "GPS: %s", gpsSimActive ? "Active" : "Stopped");
+  }
+  drawDisplayRow(displayRows[ROW_GPS], text);
   
   // Output configuration status - shows which outputs are enabled
-  String outputStr = "";
+  const char* outputStr = "No output!";  // Should never happen due to validation
   if (gpioOutputEnabled && usbOutputEnabled) {
     outputStr = "GPIO+USB";
   } else if (gpioOutputEnabled) {
     outputStr = "GPIO only";
   } else if (usbOutputEnabled) {
     outputStr = "USB only";
-  } else {
-    outputStr = "No output!";  // Should never happen due to validation
   }
-  M5.Lcd.printf("Out: %s\n", outputStr.c_str());
-//  M5.Lcd.println();
+  int length = snprintf(text, sizeof(text), "Out: %s", outputStr);
+  for (int i = 1; i < SIM_CHANNEL_COUNT; i++) {
+    if (simChannels[i].enabled && length < (int)sizeof(text)) {
+      length += snprintf(text + length, sizeof(text) - length, " +%s", simChannels[i].name);
+    }
+  }
+  drawDisplayRow(displayRows[ROW_OUTPUT], text);
   
   // Dynamic status message for detailed information
-  M5.Lcd.println(statusMsg);
+  copyStatus(text, sizeof(text));
+  drawDisplayRow(displayRows[ROW_STATUS], text);
+}
+
+/**
+ * Display task - the only code that touches the LCD
+ * 
+ * Runs at the lowest priority on core 0, where the output task (priority 3)
+ * preempts it mid-redraw whenever a sentence is due; the generator on core 1
+ * never waits for it.
+ */
+void displayTask(void* parameter) {
+  M5.Lcd.fillScreen(BLACK);
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(DISPLAY_REFRESH_MS));
+    renderDisplay();
+  }
+}
+
+/**
+ * Ask for the display to be brought up to date with the status message and system state
+ * 
+ * Returns at once - the display task redraws whatever rows have changed.
+ * Any number of calls before it runs cost one redraw.
+ */
+void displayStatus() {
+  if (displayTaskHandle) xTaskNotifyGive(displayTaskHandle);
 }
 
 // =============================================================================
@@ -263,7 +941,7 @@ bool connectToWiFi() {
   // Try each network in sequence
   for (int i = 0; i < 3; i++) {
     // Update display to show connection attempt
-    statusMsg = "Connecting to " + String(labels[i]);
+    setStatus("Connecting to " + String(labels[i]));
     displayStatus();
     
     // Begin WiFi connection attempt
@@ -280,7 +958,7 @@ bool connectToWiFi() {
     
     // Check if connection succeeded
     if (WiFi.status() == WL_CONNECTED) {
-      statusMsg = "Connected to " + String(labels[i]);
+      setStatus("Connected to " + String(labels[i]));
       return true;  // Success - exit immediately
     }
     
@@ -289,7 +967,7 @@ bool connectToWiFi() {
   }
   
   // All networks failed
-  statusMsg = "WiFi connection failed";
+  setStatus("WiFi connection failed");
   return false;
 }
 
@@ -311,7 +989,7 @@ bool connectToWiFi() {
  * no internet connection. GPS timestamps will use internal RTC only.
  */
 bool setupAccessPoint() {
-  statusMsg = "Starting Access Point...";
+  setStatus("Starting Access Point...");
   displayStatus();
   
   // Stop any existing WiFi connections
@@ -320,13 +998,13 @@ bool setupAccessPoint() {
   
   // Configure Access Point with static IP
   if (!WiFi.softAPConfig(AP_IP, AP_GATEWAY, AP_SUBNET)) {
-    statusMsg = "AP config failed";
+    setStatus("AP config failed");
     return false;
   }
   
   // Start the Access Point
   if (!WiFi.softAP(AP_SSID, AP_PASSWORD)) {
-    statusMsg = "AP startup failed";
+    setStatus("AP startup failed");
     return false;
   }
   
@@ -335,12 +1013,12 @@ bool setupAccessPoint() {
   
   // Verify AP is running
   if (WiFi.softAPgetStationNum() >= 0) {  // AP is active (even with 0 clients)
-    statusMsg = "Access Point: " + String(AP_SSID);
+    setStatus("Access Point: " + String(AP_SSID));
     ntpSyncAvailable = false;  // No internet connection in AP mode
     currentWiFiMode = WIFI_AP_MODE;
     return true;
   } else {
-    statusMsg = "AP verification failed";
+    setStatus("AP verification failed");
     return false;
   }
 }
@@ -365,7 +1043,7 @@ bool switchWiFiMode(WiFiMode newMode) {
     return true;  // Already in desired mode
   }
   
-  statusMsg = "Switching WiFi mode...";
+  setStatus("Switching WiFi mode...");
   displayStatus();
   
   // Disconnect from current network/stop current AP
@@ -380,10 +1058,8 @@ bool switchWiFiMode(WiFiMode newMode) {
   } else {
     success = connectToWiFi();
     if (success) {
-      // Re-initialize NTP in client mode
-      timeClient.begin();
-      timeClient.update();
-      setTime(timeClient.getEpochTime());
+      // Restart background NTP in client mode
+      startTimeService();
       ntpSyncAvailable = true;
     }
   }
@@ -454,17 +1130,17 @@ bool performNtpSync(bool forceSync = false) {
   WiFiMode originalMode = currentWiFiMode;
   bool modeWasSwitched = false;
   
-  statusMsg = "Attempting NTP sync...";
+  setStatus("Attempting NTP sync...");
   displayStatus();
   
   try {
     // If we're in AP mode, temporarily switch to Client mode for NTP access
     if (currentWiFiMode == WIFI_AP_MODE) {
-      statusMsg = "Switching to Client mode for NTP...";
+      setStatus("Switching to Client mode for NTP...");
       displayStatus();
       
       if (!connectToWiFi()) {
-        statusMsg = "Failed to connect for NTP sync";
+        setStatus("Failed to connect for NTP sync");
         displayStatus();
         return false;
       }
@@ -475,7 +1151,7 @@ bool performNtpSync(bool forceSync = false) {
     
     // Ensure we have a WiFi connection
     if (WiFi.status() != WL_CONNECTED) {
-      statusMsg = "No WiFi connection for NTP";
+      setStatus("No WiFi connection for NTP");
       if (modeWasSwitched) {
         setupAccessPoint();  // Restore AP mode
         currentWiFiMode = originalMode;
@@ -485,37 +1161,36 @@ bool performNtpSync(bool forceSync = false) {
     }
     
     // Initialize and attempt NTP synchronization
-    statusMsg = "Synchronizing with NTP servers...";
+    setStatus("Synchronizing with NTP servers...");
     displayStatus();
     
-    timeClient.begin();
+    // Restarting the SNTP client makes it poll at once; its callback
+    // updates the time service, so just wait for the sample count to move
+    uint32_t syncsBefore = timeSyncCount;
+    startTimeService();
     
     // Attempt NTP sync with timeout
     unsigned long syncStartTime = millis();
     bool syncSuccess = false;
     
     while (millis() - syncStartTime < NTP_SYNC_TIMEOUT) {
-      if (timeClient.update()) {
-        // NTP sync successful
-        setTime(timeClient.getEpochTime());
-        lastSuccessfulNtpSync = millis();
-        ntpSyncCompleted = true;
-        syncSuccess = true;
+      if (timeSyncCount != syncsBefore) {
+        syncSuccess = true;  // NTP sync successful
         break;
       }
-      delay(500);  // Wait before retry
+      delay(100);  // Wait before checking again
     }
     
+    String result = "NTP sync timeout";
     if (syncSuccess) {
-      time_t now = timeClient.getEpochTime();
-      statusMsg = "NTP sync successful: " + String(ctime(&now)).substring(0, 19);
-    } else {
-      statusMsg = "NTP sync timeout";
+      time_t now = utcMicros() / 1000000LL;
+      result = "NTP sync successful: " + String(ctime(&now)).substring(0, 19);
     }
+    setStatus(result);
     
     // Restore original WiFi mode if we switched
     if (modeWasSwitched && originalMode == WIFI_AP_MODE) {
-      statusMsg += " - Returning to AP mode...";
+      setStatus(result + " - Returning to AP mode...");
       displayStatus();
       delay(1000);  // Give user time to see message
       
@@ -528,7 +1203,7 @@ bool performNtpSync(bool forceSync = false) {
     
   } catch (...) {
     // Error handling - restore original mode
-    statusMsg = "NTP sync error occurred";
+    setStatus("NTP sync error occurred");
     if (modeWasSwitched && originalMode == WIFI_AP_MODE) {
       setupAccessPoint();
       currentWiFiMode = originalMode;
@@ -559,362 +1234,4540 @@ String getNtpSyncStatus() {
 }
 
 // =============================================================================
-// NMEA PROTOCOL FUNCTIONS
+// SATELLITE CONSTELLATION MODEL
 // =============================================================================
 
 /**
- * Calculate NMEA 0183 checksum using XOR algorithm
- * 
- * NMEA sentences require a checksum for data integrity verification.
- * The checksum is computed by XORing all characters between '$' and '*'.
+ * 🎯 EDUCATIONAL BLOCK: Incremental Constellation Model
  * 
- * @param sentence The NMEA sentence (must start with $ but not include *)
- * @return 8-bit checksum value
+ * WHAT: A pool of GPS satellites that rise, cross the sky and set, from which
+ *       each epoch's GSA (satellites used) and GSV (satellites in view) are built
+ * WHY: Fixed GSA/GSV literals listed 4 satellites while GGA reported the track's
+ *      sats count (often 6+) and changing HDOP - parsers that cross-check the
+ *      sentences flagged every epoch
+ * HOW: Each satellite carries a pass phase; elevation = peak × sin(phase) and
+ *      azimuth swings across the pass with cos(phase). Phases advance by the
+ *      epoch period, SNRs random-walk toward an elevation-based target, and the
+ *      highest satellites become "used" so GSA always lists exactly GGA's count.
+ *      sin/cos come from a 1-degree table built once in setup(), so a 10 Hz
+ *      update is a few dozen integer operations - no libm in the epoch loop
+ * GOTCHAS: Phases are integer micro-degrees, and GPS passes are slow (~6 hours
+ *          horizon to horizon), so an epoch moves them by well under a degree -
+ *          elevations change only every few minutes, as on a real receiver.
+ *          DOPs follow the track's HDOP with the ratios of the reference
+ *          sample (VDOP = 0.8 × HDOP), not the simulated geometry. All
+ *          channels share one sky; each module's GSA/GGA count is its own
+ *          track's sats, taken from the same highest satellites
  * 
- * Example: For "$GPGGA,123456.00,1234.5678,N,12345.6789,W,1,08,0.9,545.4,M,46.9,M,,"
- * The checksum is calculated on: "GPGGA,123456.00,1234.5678,N,12345.6789,W,1,08,0.9,545.4,M,46.9,M,,"
+ * Example: GGA sats=6 → GSA "A,3,<6 PRNs>,,,,,,,PDOP,HDOP,VDOP,1" and GSV with
+ *          8 satellites over 2 sentences
  */
-uint8_t calculateChecksum(const char* sentence) {
-  uint8_t checksum = 0;  // Initialize accumulator
-  
-  // Start from index 1 to skip the '$' character
-  // Continue until '*' delimiter or end of string
-  for (int i = 1; sentence[i] != '*' && sentence[i] != '\0'; i++) {
-    checksum ^= sentence[i];  // XOR operation - self-inverse for error detection
+const int CONSTELLATION_SIZE = 24;            // Satellites in the pool, spaced around their passes
+const int MAX_SATS_IN_VIEW = 12;              // 3 GSV sentences of 4
+const int MAX_SATS_USED = 12;                 // GSA has 12 PRN fields
+const int EXTRA_SATS_IN_VIEW = 2;             // Tracked but unused, as in the sample
+const int MIN_ELEVATION_DEG = 5;              // Elevation mask
+const uint32_t PHASE_FULL_CIRCLE = 360000000UL;  // Micro-degrees
+const uint32_t PASS_RATE_UDEG_PER_SEC = 8333; // 180° in 6 hours
+
+struct Satellite {
+  uint8_t prn;
+  uint8_t peakElevation;     // Degrees at the top of the pass
+  uint16_t centreAzimuth;    // Degrees, azimuth at the top of the pass
+  uint32_t phase;            // Micro-degrees; above the horizon for 0..180°
+  uint8_t snr;               // dB-Hz, random-walked each epoch
+  int8_t elevation;          // Degrees, updated each epoch
+  uint16_t azimuth;          // Degrees, updated each epoch
+};
+
+struct ConstellationView {
+  uint8_t visible[MAX_SATS_IN_VIEW];  // Satellite indices, highest first
+  int visibleCount = 0;
+  int usedCount = 0;                  // The first usedCount of visible[]
+  uint16_t pdopCenti = 0;
+  uint16_t hdopCenti = 0;
+  uint16_t vdopCenti = 0;
+  uint8_t fixMode = 1;                // GSA mode: 1 none, 2 = 2D, 3 = 3D
+};
+
+Satellite constellation[CONSTELLATION_SIZE];
+ConstellationView skyView;              // Everything above the mask, highest first
+ConstellationView constellationView;    // What the burst being encoded reports
+int16_t sineTableQ14[91];           // sin(0..90°) × 16384
+uint32_t constellationRandom = 0x2545F491;
+
+/**
+ * Integer-degree sine / cosine from the quarter-wave table, scaled by 16384
+ */
+int32_t tableSin(int degrees) {
+  degrees %= 360;
+  if (degrees < 0) degrees += 360;
+  if (degrees <= 90) return sineTableQ14[degrees];
+  if (degrees <= 180) return sineTableQ14[180 - degrees];
+  if (degrees <= 270) return -sineTableQ14[degrees - 180];
+  return -sineTableQ14[360 - degrees];
+}
+
+int32_t tableCos(int degrees) {
+  return tableSin(degrees + 90);
+}
+
+// Rounded integer square root (bit-by-bit method)
+uint32_t integerSqrt(uint32_t value) {
+  uint32_t root = 0;
+  uint32_t bit = 1UL << 30;
+  while (bit > value) bit >>= 2;
+  while (bit) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
   }
-  
-  return checksum;
+  return value > root ? root + 1 : root;  // Round to nearest
+}
+
+// Small xorshift PRNG - deterministic, so a track replays identically
+uint32_t nextConstellationRandom() {
+  constellationRandom ^= constellationRandom << 13;
+  constellationRandom ^= constellationRandom >> 17;
+  constellationRandom ^= constellationRandom << 5;
+  return constellationRandom;
 }
 
 /**
- * Create complete NMEA sentence with calculated checksum
- * 
- * Takes a partial NMEA sentence (without checksum) and appends the
- * properly formatted checksum. The result is a complete, valid NMEA sentence.
- * 
- * @param sentence Partial NMEA sentence starting with $ (no checksum)
- * @return Complete NMEA sentence with *XX checksum appended
- * 
- * Example: "$GPGGA,..." becomes "$GPGGA,...*7E"
+ * Build the sine table and lay out the satellite pool (called once from setup)
  */
-String createNMEASentence(String sentence) {
-  // Convert String to char array for checksum calculation
-  // 256 bytes should be sufficient for any NMEA sentence
-  char buffer[256];
-  sentence.toCharArray(buffer, 256);
-  
-  // Calculate the checksum
-  uint8_t checksum = calculateChecksum(buffer);
-  
-  // Convert checksum to uppercase hexadecimal string
-  // Note: toUpperCase() modifies the string in place and returns void
-  String checksumStr = String(checksum, HEX);
-  checksumStr.toUpperCase();  // NMEA standard requires uppercase hex
+void initConstellation() {
+  for (int i = 0; i <= 90; i++) {
+    sineTableQ14[i] = lroundf(sinf(i * DEG_TO_RAD) * 16384.0f);
+  }
   
-  // Combine sentence with checksum delimiter and checksum
-  return sentence + "*" + checksumStr;
+  for (int i = 0; i < CONSTELLATION_SIZE; i++) {
+    Satellite& sat = constellation[i];
+    sat.prn = 1 + (i * 11) % 32;                        // Spread over PRN 1..32
+    sat.peakElevation = 25 + (i * 37) % 65;             // 25..89°
+    sat.centreAzimuth = (i * 97) % 360;
+    sat.phase = (uint32_t)i * (PHASE_FULL_CIRCLE / CONSTELLATION_SIZE) + (i * 7919UL) % 5000000UL;
+    sat.snr = 30;
+    sat.elevation = -1;
+    sat.azimuth = 0;
+  }
 }
 
 /**
- * 🎯 EDUCATIONAL BLOCK: Dual Output Manager
+ * Advance every satellite by one epoch and re-sort the sky shared by all channels
  * 
- * WHAT: Sends NMEA sentences to enabled output channels (GPIO UART and/or USB Serial)
- * WHY: Provides flexible output routing for different testing and deployment scenarios
- * HOW: Checks enable flags and outputs to active channels simultaneously
- * GOTCHAS: USB Serial (Serial) is same as debug console - may interfere with debugging
- * 
- * Example: GPIO for connecting to GPS receivers, USB for computer-based analysis tools
- * References: ESP32 Serial0=USB debug, Serial1=GPIO hardware UART
+ * @param epochMs Time step since the last update
  */
-void outputNMEASentence(const String& sentence) {
-  // Output to GPIO UART (pins 32/33) if enabled
-  // This is the primary output for connecting to GPS receivers or logic analyzers
-  if (gpioOutputEnabled) {
-    gpsSerial.println(sentence);  // Hardware UART1 on GPIO pins
-  }
+void updateConstellation(uint32_t epochMs) {
+  ConstellationView& view = skyView;
+  view.visibleCount = 0;
   
-  // Output to USB Serial if enabled
-  // This allows direct connection to computer without additional hardware
-  if (usbOutputEnabled) {
-    Serial.println(sentence);     // USB Serial port (UART0)
+  for (int i = 0; i < CONSTELLATION_SIZE; i++) {
+    Satellite& sat = constellation[i];
+    sat.phase = (sat.phase + PASS_RATE_UDEG_PER_SEC * epochMs / 1000) % PHASE_FULL_CIRCLE;
+    int phaseDeg = sat.phase / 1000000UL;
+    
+    sat.elevation = sat.peakElevation * tableSin(phaseDeg) / 16384;
+    int azimuth = sat.centreAzimuth + 80 * tableCos(phaseDeg) / 16384;
+    sat.azimuth = (azimuth + 360) % 360;
+    if (sat.elevation < MIN_ELEVATION_DEG) continue;
+    
+    // SNR drifts by up to ±1 dB per epoch toward 20 + elevation/3 dB-Hz
+    int target = 20 + sat.elevation / 3;
+    int step = (int)(nextConstellationRandom() % 3) - 1;
+    if (sat.snr < target) step++;
+    else if (sat.snr > target) step--;
+    sat.snr = constrain((int)sat.snr + constrain(step, -1, 1), 10, 50);
+    
+    // Insertion sort by elevation, keeping the highest MAX_SATS_IN_VIEW
+    int pos = view.visibleCount < MAX_SATS_IN_VIEW ? view.visibleCount++ : MAX_SATS_IN_VIEW;
+    while (pos > 0 && constellation[view.visible[pos - 1]].elevation < sat.elevation) {
+      if (pos < MAX_SATS_IN_VIEW) view.visible[pos] = view.visible[pos - 1];
+      pos--;
+    }
+    if (pos < MAX_SATS_IN_VIEW) view.visible[pos] = i;
   }
-  
-  // Note: At least one output must always be enabled (enforced by web interface)
-  // This prevents silent failures where NMEA data is generated but not transmitted
 }
 
 /**
- * Generate and send GNRMC (Recommended Minimum Navigation Information) sentence
- * 
- * GNRMC is one of the most important NMEA sentences, containing essential
- * navigation data including position, speed, course, and time.
- * 
- * Format: $GNRMC,time,status,lat,NS,lon,EW,speed,course,date,magvar,mode,checksum
+ * Build the GSA/GSV view one channel's burst reports from the shared sky
  * 
- * @param gps GPS data structure containing position and navigation information
- * 
- * Educational note: This demonstrates coordinate system conversion from
- * decimal degrees (used internally) to degrees/minutes format (NMEA standard).
+ * @param gps That channel's epoch fix - its sats and HDOP decide how many are used
  */
-void sendGNRMC(const GPSData& gps) {
-  // Validate GPS data before processing
-  if (!gps.valid) return;
-  
-  // Begin NMEA sentence construction
-  // GNRMC = Global Navigation Recommended Minimum Course
-  // 'A' = Active (valid fix), 'V' would indicate void/invalid
-  String sentence = "$GNRMC," + gps.utc_time + ",A,";
+void selectConstellationView(const GPSData& gps) {
+  ConstellationView& view = constellationView;
+  view = skyView;
   
-  // LATITUDE CONVERSION: Decimal degrees → Degrees + Minutes
-  // NMEA format: DDMM.MMMMM (degrees + minutes to 5 decimal places)
-  float lat = abs(gps.latitude);  // Work with absolute value
-  int latDeg = (int)lat;          // Extract whole degrees
-  float latMin = (lat - latDeg) * 60;  // Convert remainder to minutes
+  // The highest satellites are the ones used in the fix
+  view.usedCount = min(min((int)gps.sats, MAX_SATS_USED), view.visibleCount);
+  view.visibleCount = min(view.visibleCount, view.usedCount + EXTRA_SATS_IN_VIEW);
   
-  sentence += String(latDeg, 0) + String(latMin, 5) + ",";  // DDMM.MMMMM
-  sentence += gps.latitude >= 0 ? "N," : "S,";  // Hemisphere indicator
-  
-  // LONGITUDE CONVERSION: Same process as latitude
-  // NMEA format: DDDMM.MMMMM (longitude has 3 digit degrees)
-  float lng = abs(gps.longitude);
-  int lngDeg = (int)lng;
-  float lngMin = (lng - lngDeg) * 60;
-  
-  sentence += String(lngDeg, 0) + String(lngMin, 5) + ",";  // DDDMM.MMMMM
-  sentence += gps.longitude >= 0 ? "E," : "W,";  // Hemisphere indicator
-  
-  // Navigation data
-  sentence += String(gps.gps_speed_knots, 3) + ",";  // Speed over ground in knots
-  sentence += String(gps.gps_course, 1) + ",";       // Course over ground in degrees
-  
-  // Date and magnetic variation (using fixed values for simplicity)
-  sentence += "220725,,,A,V";  // Date: 25-Jul-2022, no mag var, mode indicators
-  
-  // Generate complete sentence with checksum and send via configured outputs
-  String fullSentence = createNMEASentence(sentence);
-  outputNMEASentence(fullSentence);  // Send to enabled output channels (GPIO/USB)
+  // DOPs with the reference module's ratios; a 2D fix reports VDOP 1.00
+  view.hdopCenti = lroundf(gps.hdop * 100);
+  view.fixMode = view.usedCount >= 4 ? 3 : view.usedCount >= 3 ? 2 : 1;
+  view.vdopCenti = view.fixMode == 3 ? view.hdopCenti * 4 / 5 : 100;
+  view.pdopCenti = integerSqrt((uint32_t)view.hdopCenti * view.hdopCenti +
+                               (uint32_t)view.vdopCenti * view.vdopCenti);
 }
 
-void sendGNGGA(const GPSData& gps) {
-  if (!gps.valid) return;
+// =============================================================================
+// NETWORK SINKS (WEBSOCKET AND TCP)
+// =============================================================================
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Network NMEA Stream
+ * 
+ * WHAT: A third output that sends each epoch's burst to WebSocket clients
+ *       (ws://<ip>/ws) and to raw TCP clients on port 10110
+ * WHY: Every extra bench tool used to need its own USB serial adapter - over
+ *      WiFi, several tools can listen to one simulator at once
+ * HOW: The output task collects CHANNEL_NET messages into one buffer like a
+ *      UART's; when the burst is complete it goes into a FreeRTOS message
+ *      buffer as one frame, without waiting. A low-priority sink task takes
+ *      each frame, broadcasts it to the WebSocket clients and files it in a
+ *      short history of recent frames. Each TCP client is fed from that
+ *      history by its own onAck/onPoll callbacks
+ * GOTCHAS: Neither async library expects client methods to be called from a
+ *          foreign task - async_tcp drains each client's send queue from its
+ *          ack and poll callbacks, and the me-no-dev WebSocket client does
+ *          not lock its queue. So the sink task never touches a client: TCP
+ *          clients are only written from their own async_tcp callbacks, and
+ *          WebSocket frames go through textAll()/binaryAll(), the library's
+ *          locked broadcast, which leaves a backed-up client's copy out when
+ *          its message queue is full. A TCP client whose send buffer cannot
+ *          take a frame misses that epoch (netClientDrops), and a full
+ *          message buffer costs the sink task whole epochs
+ *          (netFramesDropped) - none of it ever holds up the UARTs. A frame
+ *          published while a TCP connection is idle waits for its next poll,
+ *          up to 500ms
+ * 
+ * Example: nc 192.168.4.1 10110, or gpsd tcp://192.168.4.1:10110, receives
+ *          the RMC...TXT burst as one write per epoch
+ */
+const uint16_t NET_TCP_PORT = 10110;    // The usual port for NMEA 0183 over TCP
+const int NET_TCP_CLIENTS_MAX = 4;
+const int NET_WS_CLIENTS_MAX = 4;
+const int NET_FRAME_MAX = 1024;         // One whole burst - BURST_BUFFER_SIZE
+const int NET_FRAME_QUEUE_BYTES = 3 * (NET_FRAME_MAX + 4);  // Frames plus the buffer's length words
+const int NET_FRAME_HISTORY = 8;        // Power of two - 500ms of poll delay at 10Hz, with room
+
+AsyncWebSocket nmeaSocket("/ws");
+AsyncServer nmeaTcpServer(NET_TCP_PORT);
+
+// Output task → sink task, one message per burst
+MessageBufferHandle_t netFrames = nullptr;
+TaskHandle_t netSinkTaskHandle = nullptr;
+
+// Sink task → TCP clients: the last few frames, numbered from 0
+struct NetFrame {
+  uint16_t length;
+  uint8_t data[NET_FRAME_MAX];
+};
+NetFrame netFrameHistory[NET_FRAME_HISTORY];
+uint32_t netFramesPublished = 0;         // Number of the next frame to arrive
+portMUX_TYPE netFrameMux = portMUX_INITIALIZER_UNLOCKED;  // Guards the history and the counters below
+
+// Connected clients - only ever touched from the async_tcp task
+struct NetTcpClient {
+  AsyncClient* client;
+  uint32_t nextFrame;                    // First frame this client has not been offered
+};
+NetTcpClient tcpClients[NET_TCP_CLIENTS_MAX] = {};
+AsyncWebSocketClient* wsClients[NET_WS_CLIENTS_MAX] = {};
+volatile int wsClientCount = 0;          // Read by the sink task
+
+volatile uint32_t netBytesSent = 0;      // Summed over every client
+volatile uint32_t netFramesDropped = 0;  // Sink task behind - the burst went to nobody
+volatile uint32_t netClientDrops = 0;    // Bursts skipped for one backed-up TCP client
+
+/**
+ * Hand a finished burst to the sink task - called by the output task, never blocks
+ */
+void publishNetFrame(const uint8_t* frame, size_t length) {
+  if (!netFrames || xMessageBufferSend(netFrames, frame, length, 0) != length) {
+    netFramesDropped++;
+  }
+}
+
+/**
+ * Broadcast one frame to the WebSocket clients and keep it for the TCP clients
+ * 
+ * Runs on the sink task, so it only uses the socket's locked broadcast calls.
+ */
+void sendNetFrame(const uint8_t* frame, size_t length) {
+  int wsClients = wsClientCount;
+  if (wsClients > 0) {
+    if (netProtocol == PROTOCOL_NMEA) {
+      nmeaSocket.textAll((const char*)frame, length);
+    } else {
+      nmeaSocket.binaryAll((const char*)frame, length);  // UBX frames are binary
+    }
+  }
+  
+  portENTER_CRITICAL(&netFrameMux);
+  NetFrame& slot = netFrameHistory[netFramesPublished % NET_FRAME_HISTORY];
+  memcpy(slot.data, frame, length);
+  slot.length = length;
+  netFramesPublished++;
+  netBytesSent += length * wsClients;
+  portEXIT_CRITICAL(&netFrameMux);
+}
+
+/**
+ * Send a TCP client every frame it has not been offered yet (async_tcp context)
+ * 
+ * Called from the client's ack and poll callbacks. A frame that does not fit
+ * in the client's send buffer is skipped, as is any the history has already
+ * overwritten.
+ */
+void serviceTcpClient(NetTcpClient* entry) {
+  static uint8_t frame[NET_FRAME_MAX];   // async_tcp is a single task
+  
+  for (;;) {
+    size_t length = 0;
+    portENTER_CRITICAL(&netFrameMux);
+    uint32_t missed = netFramesPublished - entry->nextFrame;
+    if (missed > NET_FRAME_HISTORY) {
+      netClientDrops += missed - NET_FRAME_HISTORY;
+      entry->nextFrame = netFramesPublished - NET_FRAME_HISTORY;
+    }
+    if (entry->nextFrame != netFramesPublished) {
+      const NetFrame& slot = netFrameHistory[entry->nextFrame % NET_FRAME_HISTORY];
+      length = slot.length;
+      memcpy(frame, slot.data, length);
+      entry->nextFrame++;
+    }
+    portEXIT_CRITICAL(&netFrameMux);
+    if (!length) return;
+    
+    AsyncClient* client = entry->client;
+    if (client->space() < length) {
+      portENTER_CRITICAL(&netFrameMux);
+      netClientDrops++;
+      portEXIT_CRITICAL(&netFrameMux);
+      continue;
+    }
+    client->add((const char*)frame, length);
+    client->send();
+    portENTER_CRITICAL(&netFrameMux);
+    netBytesSent += length;
+    portEXIT_CRITICAL(&netFrameMux);
+  }
+}
+
+/**
+ * Sink task - forwards each burst from the output task to the network clients
+ * 
+ * Runs below the output task on core 0, so a slow network can only ever
+ * delay the network.
+ */
+void netSinkTask(void* parameter) {
+  static uint8_t frame[NET_FRAME_MAX];
+  for (;;) {
+    size_t length = xMessageBufferReceive(netFrames, frame, sizeof(frame), portMAX_DELAY);
+    if (length) {
+      sendNetFrame(frame, length);
+    }
+  }
+}
+
+/**
+ * WebSocket connect/disconnect - anything clients send is ignored
+ * 
+ * The table only enforces NET_WS_CLIENTS_MAX and keeps the count; the
+ * broadcast calls find the clients themselves.
+ */
+void onNmeaSocketEvent(AsyncWebSocket* socket, AsyncWebSocketClient* client, AwsEventType type,
+                       void* arg, uint8_t* data, size_t len) {
+  bool accepted = false;
+  for (AsyncWebSocketClient*& slot : wsClients) {
+    if (type == WS_EVT_CONNECT && !slot) {
+      slot = client;
+      wsClientCount++;
+      netClientCount++;
+      accepted = true;
+      break;
+    }
+    if (type == WS_EVT_DISCONNECT && slot == client) {
+      slot = nullptr;
+      wsClientCount--;
+      netClientCount--;
+    }
+  }
+  
+  if (type == WS_EVT_CONNECT && !accepted) {
+    LOG_WARN("WebSocket: client %u refused, %d already connected", client->id(), NET_WS_CLIENTS_MAX);
+    client->close();
+  }
+}
+
+/**
+ * New TCP connection on NET_TCP_PORT
+ * 
+ * The client is ours to delete, which its disconnect handler does. It starts
+ * with the next burst, not the history.
+ */
+void onNmeaTcpClient(void* arg, AsyncClient* client) {
+  NetTcpClient* entry = nullptr;
+  for (NetTcpClient& slot : tcpClients) {
+    if (!slot.client) {
+      entry = &slot;
+      break;
+    }
+  }
+  if (!entry) {
+    LOG_WARN("TCP: client refused, %d already connected", NET_TCP_CLIENTS_MAX);
+    client->onDisconnect([](void* arg, AsyncClient* client) { delete client; });
+    client->close(true);
+    return;
+  }
+  
+  entry->client = client;
+  portENTER_CRITICAL(&netFrameMux);
+  entry->nextFrame = netFramesPublished;
+  portEXIT_CRITICAL(&netFrameMux);
+  netClientCount++;
+  
+  client->setNoDelay(true);  // Each burst out in one segment, no Nagle delay
+  client->onAck([](void* arg, AsyncClient* client, size_t len, uint32_t time) {
+    serviceTcpClient((NetTcpClient*)arg);
+  }, entry);
+  client->onPoll([](void* arg, AsyncClient* client) {
+    serviceTcpClient((NetTcpClient*)arg);
+  }, entry);
+  client->onDisconnect([](void* arg, AsyncClient* client) {
+    ((NetTcpClient*)arg)->client = nullptr;
+    netClientCount--;
+    delete client;
+  }, entry);
+}
+
+/**
+ * Start the WebSocket endpoint, the TCP listener and the sink task behind them
+ * 
+ * Must run before server.begin() so the WebSocket handler is registered.
+ */
+void beginNetworkSinks() {
+  netFrames = xMessageBufferCreate(NET_FRAME_QUEUE_BYTES);
+  
+  nmeaSocket.onEvent(onNmeaSocketEvent);
+  server.addHandler(&nmeaSocket);
+  
+  nmeaTcpServer.setNoDelay(true);
+  nmeaTcpServer.onClient(onNmeaTcpClient, nullptr);
+  nmeaTcpServer.begin();
+  
+  xTaskCreatePinnedToCore(netSinkTask, "netSink", 4096, nullptr, 1, &netSinkTaskHandle, 0);
+}
+
+// =============================================================================
+// NMEA OUTPUT PIPELINE (PRODUCER / CONSUMER)
+// =============================================================================
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Lock-free Single-Producer/Single-Consumer Ring Buffer
+ * 
+ * WHAT: Fixed-size queue of NMEA sentences and UBX frames between two FreeRTOS tasks
+ * WHY: UART writes at 9600 baud block for ~1ms per byte once the FIFO is full;
+ *      doing them on the same task as the web server and TFT made TX timing
+ *      depend on whatever else was running
+ * HOW: The generator task owns 'head' and the output task owns 'tail'. Each side
+ *      only ever writes its own index, so std::atomic with acquire/release
+ *      ordering is all the synchronisation needed - no mutex, no heap.
+ *      Each slot carries a channel mask, so one message can go to GPIO only,
+ *      USB only, or both
+ * GOTCHAS: Only ONE task may push and only ONE task may pop. A full ring drops
+ *          the new message (counted in droppedSentences) rather than blocking
+ *          the generator. UBX frames are binary - never treat a slot as a C string
+ * 
+ * Example: generator pushes "$GNRMC...*09\r\n", output task pops and writes it
+ *          to UART1 and USB while the generator is already sleeping
+ */
+const int OUTPUT_SLOT_SIZE = 104;   // NMEA max is 82 chars, UBX NAV-PVT frame is 100 bytes
+const int OUTPUT_RING_SLOTS = 32;   // Power of two - several full bursts of headroom
+
+struct OutputSlot {
+  uint8_t length;                   // Bytes used in data
+  uint8_t channels;                 // CHANNEL_GPIO / CHANNEL_USB mask, 0 for a burst marker
+  uint8_t data[OUTPUT_SLOT_SIZE];   // Message ready for the wire
+  int64_t burstStartUs;             // Burst markers: esp_timer time the epoch started
+};
+
+class OutputRing {
+public:
+  /**
+   * Copy a message into the next free slot (producer side only)
+   * 
+   * @param message Complete NMEA sentence (without CR/LF) or UBX frame
+   * @param length Number of bytes in message
+   * @param channels Channels the message is for
+   * @param appendCRLF true for NMEA sentences, which end with CR/LF on the wire
+   * @return false if the ring was full or the message too long (dropped)
+   */
+  bool push(const void* message, size_t length, uint8_t channels, bool appendCRLF) {
+    size_t total = length + (appendCRLF ? 2 : 0);
+    if (total > OUTPUT_SLOT_SIZE) {
+      droppedSentences++;
+      return false;
+    }
+    
+    uint32_t head = headIndex.load(std::memory_order_relaxed);
+    uint32_t tail = tailIndex.load(std::memory_order_acquire);
+    if (head - tail >= OUTPUT_RING_SLOTS) {
+      droppedSentences++;
+      return false;
+    }
+    
+    OutputSlot& slot = slots[head % OUTPUT_RING_SLOTS];
+    memcpy(slot.data, message, length);
+    if (appendCRLF) {
+      slot.data[length] = '\r';       // NMEA sentences end with CR/LF
+      slot.data[length + 1] = '\n';
+    }
+    slot.length = total;
+    slot.channels = channels;
+    
+    // Publish the slot only after its contents are written
+    headIndex.store(head + 1, std::memory_order_release);
+    if (channels & CHANNEL_GPIO) {
+      gpioQueuedBytes += total;
+    }
+    if (channels & CHANNEL_AUX) {
+      auxQueuedBytes += total;
+    }
+    return true;
+  }
+  
+  /**
+   * Queue an end-of-burst marker (producer side only)
+   * 
+   * Carries no data - it tells the output task to write out everything
+   * collected so far and timestamp when it has left the wire.
+   */
+  bool pushBurstEnd(int64_t burstStartUs) {
+    uint32_t head = headIndex.load(std::memory_order_relaxed);
+    if (head - tailIndex.load(std::memory_order_acquire) >= OUTPUT_RING_SLOTS) {
+      return false;
+    }
+    OutputSlot& slot = slots[head % OUTPUT_RING_SLOTS];
+    slot.length = 0;
+    slot.channels = 0;
+    slot.burstStartUs = burstStartUs;
+    headIndex.store(head + 1, std::memory_order_release);
+    return true;
+  }
+  
+  /**
+   * Slots the producer can still fill before push() starts dropping
+   */
+  uint32_t freeSlots() const {
+    return OUTPUT_RING_SLOTS - (headIndex.load(std::memory_order_relaxed) -
+                                tailIndex.load(std::memory_order_acquire));
+  }
+  
+  /**
+   * Access the oldest queued message without removing it (consumer side only)
+   * 
+   * @return pointer to the slot, or nullptr if the ring is empty
+   */
+  const OutputSlot* peek() {
+    uint32_t tail = tailIndex.load(std::memory_order_relaxed);
+    if (tail == headIndex.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return &slots[tail % OUTPUT_RING_SLOTS];
+  }
+  
+  /**
+   * Release the slot returned by peek() back to the producer
+   */
+  void pop() {
+    tailIndex.store(tailIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+  
+  volatile uint32_t droppedSentences = 0;  // Written by producer only
+  volatile uint32_t gpioQueuedBytes = 0;   // Total bytes pushed for the GPIO UART, producer only
+  volatile uint32_t auxQueuedBytes = 0;    // ...and for the secondary module's UART
+  
+private:
+  OutputSlot slots[OUTPUT_RING_SLOTS];
+  std::atomic<uint32_t> headIndex{0};      // Next slot to write (producer)
+  std::atomic<uint32_t> tailIndex{0};      // Next slot to read (consumer)
+};
+
+OutputRing outputRing;
+
+// Task handles - the generator formats sentences, the output task drains them
+TaskHandle_t gpsGeneratorTaskHandle = nullptr;
+TaskHandle_t gpsOutputTaskHandle = nullptr;
+
+// Guards the track file and simulation state shared between the generator
+// task and the web server callbacks (upload, start)
+SemaphoreHandle_t gpsStateMutex = nullptr;
+
+/**
+ * Queue a finished message for the output task
+ * 
+ * @return true if queued, false if the ring was full
+ */
+bool queueOutput(const void* message, size_t length, uint8_t channels, bool appendCRLF) {
+  if (channels == 0) return true;  // Nobody wants it
+  
+  if (!outputRing.push(message, length, channels, appendCRLF)) {
+    return false;
+  }
+  if (gpsOutputTaskHandle) {
+    xTaskNotifyGive(gpsOutputTaskHandle);  // Wake the output task
+  }
+  return true;
+}
+
+/**
+ * Queue an already finished sentence - used for the prebuilt constant ones
+ */
+void queueNMEASentence(const NMEASentenceWriter& sentence) {
+  if (sentence.overflowed()) {
+    outputRing.droppedSentences++;  // Never transmit a truncated sentence
+    return;
+  }
+  
+  uint8_t channels = encodingOutputs ? encodingOutputs : channelsForProtocol(PROTOCOL_NMEA);
+  queueOutput(sentence.text(), sentence.length(), channels, true);
+}
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Dual Output Manager
+ * 
+ * WHAT: Queues NMEA sentences for the output task, which sends them to the
+ *       enabled channels (GPIO UART and/or USB Serial) configured for NMEA
+ * WHY: Provides flexible output routing for different testing and deployment scenarios
+ * HOW: The sentence is copied into the ring buffer and the output task is woken;
+ *      enable flags are checked by the output task at the moment of transmission
+ * GOTCHAS: USB Serial (Serial) is same as debug console - may interfere with debugging
+ * 
+ * Example: GPIO for connecting to GPS receivers, USB for computer-based analysis tools
+ * References: ESP32 Serial0=USB debug, UART1 (IDF driver)=GPIO hardware UART
+ */
+void outputNMEASentence(NMEASentenceWriter& sentence) {
+  uint32_t start = ESP.getCycleCount();
+  sentence.finish();
+  recordStage(STAGE_CHECKSUM, start);
+  queueNMEASentence(sentence);
+}
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Single Write per Burst
+ * 
+ * WHAT: The output task copies a whole burst out of the ring into one buffer
+ *       per channel and hands each buffer to its UART in a single call
+ * WHY: Writing sentence by sentence went through the per-byte HardwareSerial
+ *      path a dozen times an epoch. One uart_write_bytes() into the IDF
+ *      driver's TX ring returns at once and the ISR feeds the FIFO from there
+ * HOW: Slots are appended to gpioBurst/usbBurst until the generator's
+ *      end-of-burst marker arrives (or the ring runs dry for
+ *      BURST_COALESCE_MS, e.g. in spaced mode or for command replies), then
+ *      both are written. uart_wait_tx_done() then timestamps when the last
+ *      stop bit left GPIO 32
+ * GOTCHAS: IDF 4.4 has no "TX done" UART event, so this task blocks in
+ *          uart_wait_tx_done() instead - harmless, it has nothing else to do
+ *          and the generator keeps queuing into the ring meanwhile
+ * 
+ * Example: 1 Hz, 9600 baud: one ~600 byte write, on the wire after ~625ms
+ */
+const int BURST_BUFFER_SIZE = 1024;     // Largest burst per channel (NMEA + UBX)
+const int BURST_COALESCE_MS = 2;        // Wait this long for more of a burst
+
+uint8_t gpioBurst[BURST_BUFFER_SIZE];
+uint8_t usbBurst[BURST_BUFFER_SIZE];
+uint8_t auxBurst[BURST_BUFFER_SIZE];
+uint8_t netBurst[BURST_BUFFER_SIZE];    // Published as one frame, see NETWORK SINKS
+size_t gpioBurstLength = 0;
+size_t usbBurstLength = 0;
+size_t auxBurstLength = 0;
+size_t netBurstLength = 0;
+
+// On-wire timing of the GPIO channel, measured by the output task
+volatile uint32_t wireLatencyUs = 0;     // Epoch start → last byte of its burst sent
+volatile uint32_t wireLatencyMaxUs = 0;
+volatile uint32_t wireBurstUs = 0;       // Write call → last byte sent
+volatile uint32_t uartWriteCalls = 0;    // uart_write_bytes() calls, for comparison
+
+/**
+ * Hand the collected bytes to the UARTs - one call per channel
+ * 
+ * @return esp_timer time of the GPIO write, or 0 if nothing went to GPIO
+ */
+int64_t flushBurstBuffers() {
+  int64_t writeStart = 0;
+  if (gpioBurstLength) {
+    writeStart = esp_timer_get_time();
+    uint32_t start = ESP.getCycleCount();
+    uart_write_bytes(GPS_UART, gpioBurst, gpioBurstLength);  // Hardware UART1 on GPIO pins
+    recordStage(STAGE_UART_WRITE, start);
+    uartWriteCalls++;
+    gpioBytesSent += gpioBurstLength;
+    gpioBurstLength = 0;
+  }
+  if (usbBurstLength) {
+    uint32_t start = ESP.getCycleCount();
+    Serial.write(usbBurst, usbBurstLength);                  // USB Serial port (UART0)
+    recordStage(STAGE_USB_WRITE, start);
+    usbBytesSent += usbBurstLength;
+    usbBurstLength = 0;
+  }
+  if (auxBurstLength) {
+    uart_write_bytes(AUX_UART, auxBurst, auxBurstLength);    // Secondary module on UART2
+    auxBytesSent += auxBurstLength;
+    auxBurstLength = 0;
+  }
+  if (netBurstLength) {
+    publishNetFrame(netBurst, netBurstLength);               // WebSocket and TCP clients
+    netBurstLength = 0;
+  }
+  return writeStart;
+}
+
+/**
+ * Append a message to a channel's burst buffer, flushing first if it's full
+ */
+void appendToBurst(uint8_t* buffer, size_t& length, const OutputSlot* slot) {
+  if (length + slot->length > BURST_BUFFER_SIZE) {
+    flushBurstBuffers();
+  }
+  memcpy(buffer + length, slot->data, slot->length);
+  length += slot->length;
+}
+
+/**
+ * Output task - drains the sentence ring to the enabled UARTs
+ * 
+ * Pinned to core 0 so that UART transmission carries on at full rate while the
+ * generator, loop(), TFT and web server are busy on core 1.
+ */
+void gpsOutputTask(void* parameter) {
+  for (;;) {
+    // Sleep until the generator queues something (or 100ms as a safety net);
+    // with part of a burst collected, only wait long enough for the rest
+    bool collecting = gpioBurstLength || usbBurstLength || auxBurstLength || netBurstLength;
+    bool woken = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(collecting ? BURST_COALESCE_MS : 100));
+    if (collecting && !woken) {
+      flushBurstBuffers();  // Ring ran dry without a marker - send what we have
+    }
+    
+    // Sample a pending baud change before draining: everything queued before
+    // it was requested (e.g. the ACK to a CFG-PRT) must go out at the old rate
+    uint32_t baud = pendingBaudRate;
+    
+    const OutputSlot* slot;
+    while ((slot = outputRing.peek()) != nullptr) {
+      if (slot->channels == 0) {
+        // End of burst: write it out and time it leaving the wire
+        int64_t burstStartUs = slot->burstStartUs;
+        outputRing.pop();
+        int64_t writeStart = flushBurstBuffers();
+        if (writeStart && uart_wait_tx_done(GPS_UART, pdMS_TO_TICKS(2000)) == ESP_OK) {
+          int64_t done = esp_timer_get_time();
+          wireBurstUs = done - writeStart;
+          wireLatencyUs = done - burstStartUs;
+          if (wireLatencyUs > wireLatencyMaxUs) wireLatencyMaxUs = wireLatencyUs;
+        }
+        continue;
+      }
+      
+      // Output to GPIO UART (pins 32/33) if enabled
+      // This is the primary output for connecting to GPS receivers or logic analyzers
+      if (gpioOutputEnabled && (slot->channels & CHANNEL_GPIO)) {
+        appendToBurst(gpioBurst, gpioBurstLength, slot);
+      }
+      
+      // Output to USB Serial if enabled
+      // This allows direct connection to computer without additional hardware
+      if (usbOutputEnabled && (slot->channels & CHANNEL_USB)) {
+        appendToBurst(usbBurst, usbBurstLength, slot);
+      }
+      
+      // Secondary module on UART2, while its channel is enabled
+      if (simChannels[1].enabled && (slot->channels & CHANNEL_AUX)) {
+        appendToBurst(auxBurst, auxBurstLength, slot);
+      }
+      
+      // Network clients, batched into one frame per burst
+      if (slot->channels & CHANNEL_NET) {
+        appendToBurst(netBurst, netBurstLength, slot);
+      }
+      
+      // Note: At least one output must always be enabled (enforced by web interface)
+      // This prevents silent failures where NMEA data is generated but not transmitted
+      outputRing.pop();
+    }
+    
+    // Baud changes happen here, between bursts, once the FIFO has drained
+    if (baud) {
+      flushBurstBuffers();
+      if (pendingBaudRate == baud) pendingBaudRate = 0;
+      uart_wait_tx_done(GPS_UART, pdMS_TO_TICKS(2000));
+      uart_set_baudrate(GPS_UART, baud);
+    }
+    
+    // Secondary modules: their previous burst finishes at the old rate too
+    for (int i = 1; i < SIM_CHANNEL_COUNT; i++) {
+      SimChannel& ch = simChannels[i];
+      uint32_t channelBaud = ch.pendingBaudRate;
+      if (!channelBaud) continue;
+      flushBurstBuffers();
+      ch.pendingBaudRate = 0;
+      uart_wait_tx_done(ch.uart, pdMS_TO_TICKS(2000));
+      uart_set_baudrate(ch.uart, channelBaud);
+    }
+  }
+}
+
+/**
+ * Install the IDF UART driver on UART1 (GPIO 32 TX / 33 RX), 8N1
+ */
+void beginGpsUart(uint32_t baud) {
+  uart_config_t config = {};
+  config.baud_rate = baud;
+  config.data_bits = UART_DATA_8_BITS;
+  config.parity = UART_PARITY_DISABLE;
+  config.stop_bits = UART_STOP_BITS_1;
+  config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+  config.source_clk = UART_SCLK_APB;
+  
+  uart_driver_install(GPS_UART, GPS_UART_RX_BUFFER, GPS_UART_TX_BUFFER, 0, nullptr, 0);
+  uart_param_config(GPS_UART, &config);
+  uart_set_pin(GPS_UART, GPS_TX_PIN, GPS_RX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+}
+
+/**
+ * Install the IDF UART driver for a secondary channel's module (TX only), 8N1
+ */
+void beginChannelUart(const SimChannel& ch) {
+  uart_config_t config = {};
+  config.baud_rate = ch.baudRate;
+  config.data_bits = UART_DATA_8_BITS;
+  config.parity = UART_PARITY_DISABLE;
+  config.stop_bits = UART_STOP_BITS_1;
+  config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+  config.source_clk = UART_SCLK_APB;
+  
+  uart_driver_install(ch.uart, GPS_UART_RX_BUFFER, AUX_UART_TX_BUFFER, 0, nullptr, 0);
+  uart_param_config(ch.uart, &config);
+  uart_set_pin(ch.uart, ch.txPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+}
+
+/**
+ * Generator task - runs the simulation, burst scheduler and command receiver
+ * 
+ * Shares core 1 with loop() but at a higher priority, so button handling and
+ * display refreshes can no longer delay a scheduled sentence. The command
+ * receiver runs here too because its replies are pushed into the output ring,
+ * which must only ever have one producer.
+ */
+void gpsGeneratorTask(void* parameter) {
+  for (;;) {
+    xSemaphoreTake(gpsStateMutex, portMAX_DELAY);
+    serviceCommandReceiver();  // Host reconfiguration, applied between sentences
+    simulateGPS();
+    xSemaphoreGive(gpsStateMutex);
+    
+    // Woken at once by the epoch clock; the 1 tick timeout keeps 1ms
+    // resolution for spaced bursts and polls the command receiver
+    ulTaskNotifyTake(pdTRUE, 1);
+  }
+}
+
+// UTC time of the epoch being transmitted, in milliseconds since 1970
+uint64_t epochUtcMillis = 0;
+
+// Calendar date of epochUtcMillis - recomputed only when the UTC day changes
+struct EpochDate {
+  long daysSince1970 = -1;                 // -1 = not yet computed
+  int year = 1970;
+  int month = 1;
+  int day = 1;
+  char rmcFields[16] = "010170,,,A,V";     // RMC "ddmmyy,magvar,dir,mode,nav status"
+};
+EpochDate epochDate;
+
+/**
+ * Set the time of the epoch being transmitted, refreshing the date at midnight
+ * 
+ * @param utcMillis UTC milliseconds since 1970
+ */
+void setEpochUtcMillis(uint64_t utcMillis) {
+  epochUtcMillis = utcMillis;
+  long days = utcMillis / 86400000ULL;
+  if (days == epochDate.daysSince1970) return;
+  
+  epochDate.daysSince1970 = days;
+  civilFromDays(days, epochDate.year, epochDate.month, epochDate.day);
+  // No magnetic variation; mode A (autonomous), status V (no integrity info)
+  snprintf(epochDate.rmcFields, sizeof(epochDate.rmcFields), "%02d%02d%02d,,,A,V",
+           epochDate.day, epochDate.month, epochDate.year % 100);
+}
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Sentence Templates
+ * 
+ * WHAT: RMC and GGA are built once with placeholder time and position, then
+ *       only those fixed-width slots are rewritten each epoch
+ * WHY: Most of each burst is the same every epoch - the address, the 'A'
+ *      status, the field structure, whole constant sentences like TXT - and
+ *      reformatting it all at 10 Hz is wasted CPU
+ * HOW: "hhmmss.ss", "DDMM.MMMMM,N" and "DDDMM.MMMMM,W" always have the same
+ *      width, so they are patched in place, with the checksum updated by
+ *      XOR-ing each old byte out and each new byte in. The variable-width
+ *      fields after them (speed, course, HDOP) are appended to the frozen
+ *      prefix. BDGSV and TXT never change and are checksummed once at boot
+ * GOTCHAS: Only fixed-width fields may live in the prefix - a slot that could
+ *          grow would overwrite its neighbour. A time string of the wrong
+ *          width is refused rather than patched
+ * 
+ * Example: "$GNRMC,112339.00,A,5123.49091,N,00017.24547,W" is the RMC prefix;
+ *          ",0.233,,220725,,,A,V" is appended each epoch
+ */
+const size_t TIME_SLOT_WIDTH = 9;          // "hhmmss.ss"
+
+struct SentenceTemplate {
+  NMEASentenceWriter sentence;
+  size_t timeSlot = 0;                     // Offsets of the fixed-width slots
+  size_t latitudeSlot = 0;
+  size_t longitudeSlot = 0;
+};
+
+SentenceTemplate rmcTemplate;
+SentenceTemplate ggaTemplate;
+NMEASentenceWriter bdgsvSentence;          // Constant - finished once at boot
+NMEASentenceWriter txtSentence;
+
+/**
+ * Start a template with time and position slots after the address
+ * 
+ * @param statusField Field between time and latitude ("A" for RMC), or nullptr
+ */
+void beginPositionTemplate(SentenceTemplate& tmpl, const char* address, const char* statusField) {
+  NMEASentenceWriter& sentence = tmpl.sentence;
+  sentence.begin(address);
+  tmpl.timeSlot = sentence.nextFieldOffset();
+  sentence.field("000000.00");
+  if (statusField) sentence.field(statusField);
+  tmpl.latitudeSlot = sentence.nextFieldOffset();
+  sentence.fieldCoordinate(0, 2, 'N', 'S');
+  tmpl.longitudeSlot = sentence.nextFieldOffset();
+  sentence.fieldCoordinate(0, 3, 'E', 'W');
+}
+
+/**
+ * Build the sentence templates and constant sentences (called once from setup)
+ */
+void initSentenceTemplates() {
+  beginPositionTemplate(rmcTemplate, "GNRMC", "A");
+  rmcTemplate.sentence.markTemplate();
+  
+  beginPositionTemplate(ggaTemplate, "GNGGA", nullptr);
+  ggaTemplate.sentence.fieldUInt(1);       // Fix quality - always a GPS fix
+  ggaTemplate.sentence.markTemplate();
+  
+  bdgsvSentence.begin("BDGSV");
+  bdgsvSentence.fields("1,1,00,0");        // No BeiDou satellites, as in the reference sample
+  bdgsvSentence.finish();
+  
+  txtSentence.begin("GNTXT");
+  txtSentence.fields("1,1,01,ANTENNA OK");
+  txtSentence.finish();
+}
+
+/**
+ * Generate and send GNRMC (Recommended Minimum Navigation Information) sentence
+ * 
+ * GNRMC is one of the most important NMEA sentences, containing essential
+ * navigation data including position, speed, course, and time.
+ * 
+ * Format: $GNRMC,time,status,lat,NS,lon,EW,speed,course,date,magvar,mode,checksum
+ * 
+ * @param gps GPS data structure containing position and navigation information
+ * 
+ * Educational note: This demonstrates coordinate system conversion from
+ * decimal degrees (used internally) to degrees/minutes format (NMEA standard).
+ */
+void sendGNRMC(const GPSData& gps) {
+  // Validate GPS data before processing
+  if (!gps.valid) return;
+  
+  // Patch this epoch's time and position into the template prefix
+  // "$GNRMC,hhmmss.ss,A,DDMM.MMMMM,N,DDDMM.MMMMM,W" - 'A' = Active (valid fix)
+  SentenceTemplate& rmc = rmcTemplate;
+  NMEASentenceWriter& sentence = rmc.sentence;
+  sentence.patchText(rmc.timeSlot, gps.utc_time, TIME_SLOT_WIDTH);
+  
+  // NMEA format: DDMM.MMMMM for latitude, DDDMM.MMMMM for longitude
+  sentence.patchCoordinate(rmc.latitudeSlot, gps.latitudeE7, 2, 'N', 'S');
+  sentence.patchCoordinate(rmc.longitudeSlot, gps.longitudeE7, 3, 'E', 'W');
+  sentence.rewind();
+  
+  // Navigation data - variable width, so appended after the prefix
+  sentence.fieldFixed(lroundf(gps.gps_speed_knots * 1000), 3);  // Speed over ground in knots
+  sentence.fieldFixed(lroundf(gps.gps_course * 10), 1);         // Course over ground in degrees
+  
+  // Date of the epoch (cached per UTC day), no magnetic variation, mode indicators
+  sentence.fields(epochDate.rmcFields);
+  
+  // Generate complete sentence with checksum and send via configured outputs
+  outputNMEASentence(sentence);  // Send to enabled output channels (GPIO/USB)
+}
+
+void sendGNGGA(const GPSData& gps) {
+  if (!gps.valid) return;
+  
+  SentenceTemplate& gga = ggaTemplate;
+  NMEASentenceWriter& sentence = gga.sentence;
+  sentence.patchText(gga.timeSlot, gps.utc_time, TIME_SLOT_WIDTH);
+  sentence.patchCoordinate(gga.latitudeSlot, gps.latitudeE7, 2, 'N', 'S');
+  sentence.patchCoordinate(gga.longitudeSlot, gps.longitudeE7, 3, 'E', 'W');
+  sentence.rewind();                                 // Prefix ends with fix quality 1
+  
+  sentence.fieldUInt(constellationView.usedCount, 2); // Number of satellites
+  sentence.fieldFixed(lroundf(gps.hdop * 100), 2);   // HDOP
+  sentence.fields("56.3,M,46.9,M,,");                // Altitude and geoidal separation
+  
+  outputNMEASentence(sentence);
+}
+
+void sendGNGSA(int part) {
+  // Part 1 lists the GPS satellites used in the fix (system ID 1),
+  // part 2 the BeiDou satellites (system ID 4) - none in the reference sample
+  const ConstellationView& view = constellationView;
+  NMEASentenceWriter sentence;
+  sentence.begin("GNGSA");
+  sentence.fieldChar('A');
+  sentence.fieldUInt(view.fixMode);
+  for (int i = 0; i < MAX_SATS_USED; i++) {
+    if (part == 1 && i < view.usedCount) {
+      sentence.fieldUInt(constellation[view.visible[i]].prn, 2);
+    } else {
+      sentence.emptyField();
+    }
+  }
+  sentence.fieldFixed(view.pdopCenti, 2);
+  sentence.fieldFixed(view.hdopCenti, 2);
+  sentence.fieldFixed(view.vdopCenti, 2);
+  sentence.fieldUInt(part == 1 ? 1 : 4);             // GNSS system ID
+  outputNMEASentence(sentence);
+}
+
+/**
+ * One GPGSV sentence - up to 4 satellites in view
+ * 
+ * @param page 0-based sentence number
+ */
+void sendGPGSVPage(int page) {
+  const ConstellationView& view = constellationView;
+  int pages = max(1, (view.visibleCount + 3) / 4);
+  
+  NMEASentenceWriter sentence;
+  sentence.begin("GPGSV");
+  sentence.fieldUInt(pages);
+  sentence.fieldUInt(page + 1);
+  sentence.fieldUInt(view.visibleCount, 2);
+  for (int i = page * 4; i < min(view.visibleCount, page * 4 + 4); i++) {
+    const Satellite& sat = constellation[view.visible[i]];
+    sentence.fieldUInt(sat.prn, 2);
+    sentence.fieldUInt(sat.elevation, 2);
+    sentence.fieldUInt(sat.azimuth, 3);
+    sentence.fieldUInt(sat.snr, 2);
+  }
+  sentence.fieldUInt(0);                             // Signal ID (NMEA 4.10)
+  outputNMEASentence(sentence);
+}
+
+void sendGPGSV(int part) {
+  // Part 1 is the first sentence, part 2 the rest (0-2 more)
+  int pages = max(1, (constellationView.visibleCount + 3) / 4);
+  if (part == 1) {
+    sendGPGSVPage(0);
+  } else {
+    for (int page = 1; page < pages; page++) {
+      sendGPGSVPage(page);
+    }
+  }
+}
+
+void sendBDGSV() {
+  queueNMEASentence(bdgsvSentence);
+}
+
+void sendGNTXT() {
+  queueNMEASentence(txtSentence);
+}
+
+// =============================================================================
+// UBX BINARY PROTOCOL
+// =============================================================================
+
+// Framing and the Fletcher checksum (UBXFrameWriter) live in lib/gps_core
+
+// Fixed values the simulated fix shares with the NMEA GGA sentence
+const int32_t GPS_ALTITUDE_MSL_MM = 56300;       // "56.3,M" in GGA
+const int32_t GEOID_SEPARATION_MM = 46900;       // "46.9,M" in GGA
+const uint32_t GPS_UNIX_EPOCH_OFFSET = 315964800UL; // 1980-01-06 in Unix time
+const uint32_t GPS_LEAP_SECONDS = 18;            // GPS - UTC since 2017-01-01
+
+// GPS time of week in milliseconds for the current epoch
+uint32_t gpsTimeOfWeekMs() {
+  uint64_t gpsMillis = epochUtcMillis - GPS_UNIX_EPOCH_OFFSET * 1000ULL + GPS_LEAP_SECONDS * 1000ULL;
+  return gpsMillis % (604800ULL * 1000ULL);
+}
+
+uint16_t gpsWeekNumber() {
+  uint64_t gpsMillis = epochUtcMillis - GPS_UNIX_EPOCH_OFFSET * 1000ULL + GPS_LEAP_SECONDS * 1000ULL;
+  return gpsMillis / (604800ULL * 1000ULL);
+}
+
+// Estimated accuracies derived from HDOP with a typical 2.5m UERE
+uint32_t horizontalAccuracyMm(const GPSData& gps) { return (uint32_t)(gps.hdop * 2500.0f); }
+uint32_t verticalAccuracyMm(const GPSData& gps) { return horizontalAccuracyMm(gps) * 3 / 2; }
+uint16_t positionDopCenti(const GPSData& gps) { return constellationView.pdopCenti; }
+
+int32_t groundSpeedMmPerSec(const GPSData& gps) { return lroundf(gps.gps_speed_knots * 514.444f); }
+
+/**
+ * Queue a finished UBX frame for the channels configured for UBX
+ */
+void outputUBXFrame(UBXFrameWriter& frame) {
+  uint32_t start = ESP.getCycleCount();
+  frame.finish();
+  recordStage(STAGE_CHECKSUM, start);
+  queueOutput(frame.data(), frame.length(), channelsForProtocol(PROTOCOL_UBX), false);
+}
+
+/**
+ * NAV-POSLLH - geodetic position (28-byte payload)
+ */
+void sendUBXNavPOSLLH(const GPSData& gps) {
+  if (!gps.valid || !channelsForProtocol(PROTOCOL_UBX)) return;
+  
+  UBXFrameWriter frame;
+  frame.begin(UBX_CLASS_NAV, UBX_NAV_POSLLH);
+  frame.u4(gpsTimeOfWeekMs());                              // iTOW
+  frame.i4(gps.longitudeE7);                                // lon, 1e-7 deg
+  frame.i4(gps.latitudeE7);                                 // lat, 1e-7 deg
+  frame.i4(GPS_ALTITUDE_MSL_MM + GEOID_SEPARATION_MM);      // height above ellipsoid, mm
+  frame.i4(GPS_ALTITUDE_MSL_MM);                            // hMSL, mm
+  frame.u4(horizontalAccuracyMm(gps));                      // hAcc, mm
+  frame.u4(verticalAccuracyMm(gps));                        // vAcc, mm
+  outputUBXFrame(frame);
+}
+
+/**
+ * NAV-SOL - navigation solution in ECEF coordinates (52-byte payload)
+ */
+void sendUBXNavSOL(const GPSData& gps) {
+  if (!gps.valid || !channelsForProtocol(PROTOCOL_UBX)) return;
+  
+  // WGS84 geodetic → Earth-Centred Earth-Fixed
+  const double a = 6378137.0;              // Semi-major axis, m
+  const double e2 = 6.69437999014e-3;      // First eccentricity squared
+  double lat = gps.latitudeE7 * (DEG_TO_RAD / 1e7);
+  double lon = gps.longitudeE7 * (DEG_TO_RAD / 1e7);
+  double h = (GPS_ALTITUDE_MSL_MM + GEOID_SEPARATION_MM) / 1000.0;
+  double sinLat = sin(lat), cosLat = cos(lat), sinLon = sin(lon), cosLon = cos(lon);
+  double n = a / sqrt(1.0 - e2 * sinLat * sinLat);
+  
+  // Ground velocity (north/east) rotated into ECEF, vertical velocity zero
+  double speed = groundSpeedMmPerSec(gps) / 10.0;   // cm/s
+  double course = gps.gps_course * DEG_TO_RAD;
+  double velN = speed * cos(course), velE = speed * sin(course);
+  
+  UBXFrameWriter frame;
+  frame.begin(UBX_CLASS_NAV, UBX_NAV_SOL);
+  frame.u4(gpsTimeOfWeekMs());                              // iTOW
+  frame.i4(0);                                              // fTOW, ns
+  frame.i2(gpsWeekNumber());                                // week
+  frame.u1(0x03);                                           // gpsFix = 3D
+  frame.u1(0x0D);                                           // flags: gpsFixOK, WKNSET, TOWSET
+  frame.i4(lround((n + h) * cosLat * cosLon * 100.0));      // ecefX, cm
+  frame.i4(lround((n + h) * cosLat * sinLon * 100.0));      // ecefY, cm
+  frame.i4(lround((n * (1.0 - e2) + h) * sinLat * 100.0));  // ecefZ, cm
+  frame.u4(horizontalAccuracyMm(gps) / 10);                 // pAcc, cm
+  frame.i4(lround(-velN * sinLat * cosLon - velE * sinLon)); // ecefVX, cm/s
+  frame.i4(lround(-velN * sinLat * sinLon + velE * cosLon)); // ecefVY, cm/s
+  frame.i4(lround(velN * cosLat));                          // ecefVZ, cm/s
+  frame.u4(50);                                             // sAcc, cm/s
+  frame.u2(positionDopCenti(gps));                          // pDOP × 100
+  frame.reserved(1);
+  frame.u1(constellationView.usedCount);                    // numSV
+  frame.reserved(4);
+  outputUBXFrame(frame);
+}
+
+/**
+ * NAV-PVT - position, velocity and time in one message (92-byte payload)
+ */
+void sendUBXNavPVT(const GPSData& gps) {
+  if (!gps.valid || !channelsForProtocol(PROTOCOL_UBX)) return;
+  
+  uint32_t secondOfDay = (epochUtcMillis / 1000) % 86400;
+  
+  int32_t speed = groundSpeedMmPerSec(gps);
+  float course = gps.gps_course * DEG_TO_RAD;
+  
+  UBXFrameWriter frame;
+  frame.begin(UBX_CLASS_NAV, UBX_NAV_PVT);
+  frame.u4(gpsTimeOfWeekMs());                              // iTOW
+  frame.u2(epochDate.year);
+  frame.u1(epochDate.month);
+  frame.u1(epochDate.day);
+  frame.u1(secondOfDay / 3600);                             // hour
+  frame.u1((secondOfDay % 3600) / 60);                      // min
+  frame.u1(secondOfDay % 60);                               // sec
+  frame.u1(0x07);                                           // valid: date, time, fully resolved
+  frame.u4(50);                                             // tAcc, ns
+  frame.i4((epochUtcMillis % 1000) * 1000000L);             // nano, ns
+  frame.u1(0x03);                                           // fixType = 3D
+  frame.u1(0x01);                                           // flags: gnssFixOK
+  frame.u1(0x00);                                           // flags2
+  frame.u1(constellationView.usedCount);                    // numSV
+  frame.i4(gps.longitudeE7);                                // lon, 1e-7 deg
+  frame.i4(gps.latitudeE7);                                 // lat, 1e-7 deg
+  frame.i4(GPS_ALTITUDE_MSL_MM + GEOID_SEPARATION_MM);      // height, mm
+  frame.i4(GPS_ALTITUDE_MSL_MM);                            // hMSL, mm
+  frame.u4(horizontalAccuracyMm(gps));                      // hAcc, mm
+  frame.u4(verticalAccuracyMm(gps));                        // vAcc, mm
+  frame.i4(lroundf(speed * cosf(course)));                  // velN, mm/s
+  frame.i4(lroundf(speed * sinf(course)));                  // velE, mm/s
+  frame.i4(0);                                              // velD, mm/s
+  frame.i4(speed);                                          // gSpeed, mm/s
+  frame.i4(lroundf(gps.gps_course * 100000.0f));            // headMot, 1e-5 deg
+  frame.u4(500);                                            // sAcc, mm/s
+  frame.u4(lroundf(5.0f * 100000.0f));                      // headAcc, 1e-5 deg
+  frame.u2(positionDopCenti(gps));                          // pDOP × 100
+  frame.reserved(6);
+  frame.i4(0);                                              // headVeh (invalid)
+  frame.i2(0);                                              // magDec
+  frame.u2(0);                                              // magAcc
+  outputUBXFrame(frame);
+}
+
+// =============================================================================
+// NMEA BURST SCHEDULER
+// =============================================================================
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Non-blocking Timed Event Scheduler
+ * 
+ * WHAT: A table of "emit sentence X at offset T within this epoch" events
+ * WHY: The burst used to be sent with delay(50) between sentences, which froze
+ *      loop() for ~400ms of every second - buttons, NTP and the display lagged
+ *      and the 1 Hz epoch drifted by the time spent blocking
+ * HOW: simulateGPS() opens an epoch every 1000ms and serviceBurstScheduler()
+ *      emits every event whose offset has elapsed, then returns immediately
+ * GOTCHAS: Offsets are measured from the epoch start, not from the previous
+ *          sentence, so a late loop() iteration never accumulates into drift
+ * 
+ * Example: RMC at +0ms, GGA at +50ms ... TXT at +350ms (sigrok sample spacing)
+ */
+enum BurstSentence {
+  BURST_GNRMC,
+  BURST_GNGGA,
+  BURST_GNGSA_1,
+  BURST_GNGSA_2,
+  BURST_GPGSV_1,
+  BURST_GPGSV_2,
+  BURST_BDGSV,
+  BURST_GNTXT,
+  BURST_UBX_NAV_PVT,
+  BURST_UBX_NAV_POSLLH,
+  BURST_UBX_NAV_SOL
+};
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Per-message Output Rates
+ * 
+ * WHAT: Each message type has an enable flag and an "every N epochs" divisor,
+ *       the same model as u-blox CFG-MSG rates
+ * WHY: High-rate tests usually want only RMC+GGA, and satellite data changes
+ *      slowly enough that sending GSV every 5s is plenty - both cut UART bytes
+ *      per second and generation CPU
+ * HOW: burstEpochCount counts bursts; an event is emitted when its message is
+ *      enabled and burstEpochCount is a multiple of the divisor. Set from the
+ *      web UI (/output-config msg_XXX=N) or by the host (CFG-MSG, PUBX,40)
+ * GOTCHAS: A rate of 0 means "off" everywhere, matching CFG-MSG, so the web
+ *          parameter and the CFG-MSG poll both report enabled ? divisor : 0
+ * 
+ * Example: msg_GSV=5 at 1 Hz → GPGSV/BDGSV once every 5 seconds
+ */
+enum OutputMessage {
+  MSG_RMC,
+  MSG_GGA,
+  MSG_GSA,
+  MSG_GSV,
+  MSG_TXT,
+  MSG_NAV_PVT,
+  MSG_NAV_POSLLH,
+  MSG_NAV_SOL,
+  OUTPUT_MESSAGE_COUNT
+};
+
+struct OutputMessageConfig {
+  const char* name;          // NMEA sentence type or UBX message name
+  uint8_t ubxClass;          // CFG-MSG class - 0xF0 is "standard NMEA"
+  uint8_t ubxId;             // CFG-MSG id
+  bool optional;             // May be dropped when the UART byte budget is exceeded
+  bool enabled;              // Included in the burst at all
+  uint8_t divisor;           // Sent every N epochs (1 = every epoch)
+  uint16_t burstBytes;       // GPIO bytes it took when last sent, for budgeting
+};
+
+const int MAX_MESSAGE_DIVISOR = 255;  // CFG-MSG rate is a U1
+
+OutputMessageConfig outputMessages[OUTPUT_MESSAGE_COUNT] = {
+  { "RMC",        0xF0, 0x04, false, true, 1, 0 },
+  { "GGA",        0xF0, 0x00, false, true, 1, 0 },
+  { "GSA",        0xF0, 0x02, false, true, 1, 0 },
+  { "GSV",        0xF0, 0x03, true,  true, 1, 0 },
+  { "TXT",        0xF0, 0x41, true,  true, 1, 0 },
+  { "NAV-PVT",    0x01, 0x07, false, true, 1, 0 },
+  { "NAV-POSLLH", 0x01, 0x02, false, true, 1, 0 },
+  { "NAV-SOL",    0x01, 0x06, false, true, 1, 0 }
+};
+
+/**
+ * Set a message's rate in CFG-MSG terms: 0 = off, N = every N epochs
+ */
+void setMessageRate(OutputMessage message, uint8_t rate) {
+  outputMessages[message].enabled = rate != 0;
+  if (rate != 0) {
+    outputMessages[message].divisor = rate;
+  }
+}
+
+uint8_t messageRate(OutputMessage message) {
+  return outputMessages[message].enabled ? outputMessages[message].divisor : 0;
+}
+
+/**
+ * Message rates as a JSON object, e.g. {"RMC":1,"GGA":1,"GSV":5,...}
+ */
+void printMessageRatesJson(JsonPrinter& json, const char* key) {
+  json.beginObject(key);
+  for (int i = 0; i < OUTPUT_MESSAGE_COUNT; i++) {
+    json.field(outputMessages[i].name, messageRate((OutputMessage)i));
+  }
+  json.endObject();
+}
+
+/**
+ * Look up a message by its CFG-MSG class/id
+ * 
+ * @return the message, or OUTPUT_MESSAGE_COUNT if we don't generate it
+ */
+OutputMessage findOutputMessage(uint8_t ubxClass, uint8_t ubxId) {
+  for (int i = 0; i < OUTPUT_MESSAGE_COUNT; i++) {
+    if (outputMessages[i].ubxClass == ubxClass && outputMessages[i].ubxId == ubxId) {
+      return (OutputMessage)i;
+    }
+  }
+  return OUTPUT_MESSAGE_COUNT;
+}
+
+struct BurstEvent {
+  uint16_t offsetMs;         // Milliseconds after the epoch start
+  BurstSentence sentence;    // Which sentence to emit
+  OutputMessage message;     // Rate and budget entry that controls it
+};
+
+// Burst layout - same order and 50ms spacing as the original delay() chain
+const BurstEvent BURST_SCHEDULE[] = {
+  {   0, BURST_GNRMC,   MSG_RMC },
+  {  50, BURST_GNGGA,   MSG_GGA },
+  { 100, BURST_GNGSA_1, MSG_GSA },
+  { 150, BURST_GNGSA_2, MSG_GSA },
+  { 200, BURST_GPGSV_1, MSG_GSV },
+  { 250, BURST_GPGSV_2, MSG_GSV },
+  { 300, BURST_BDGSV,   MSG_GSV },
+  { 350, BURST_GNTXT,   MSG_TXT },
+  // UBX messages follow the NMEA burst, as on a receiver with both enabled
+  { 400, BURST_UBX_NAV_PVT,    MSG_NAV_PVT    },
+  { 450, BURST_UBX_NAV_POSLLH, MSG_NAV_POSLLH },
+  { 500, BURST_UBX_NAV_SOL,    MSG_NAV_SOL    }
+};
+const int BURST_EVENT_COUNT = sizeof(BURST_SCHEDULE) / sizeof(BURST_SCHEDULE[0]);
+
+// Fix rates the neo-6m supports via CFG-RATE (1 Hz is the module default)
+const uint8_t SUPPORTED_FIX_RATES_HZ[] = {1, 2, 5, 10};
+uint8_t gpsFixRateHz = 1;
+
+/**
+ * Check a requested fix rate against SUPPORTED_FIX_RATES_HZ
+ */
+bool isSupportedFixRate(int hz) {
+  for (uint8_t candidate : SUPPORTED_FIX_RATES_HZ) {
+    if (hz == candidate) return true;
+  }
+  return false;
+}
+
+// Epoch period for GPS fixes at the configured rate
+unsigned long gpsEpochMs() {
+  return 1000UL / gpsFixRateHz;
+}
+
+int burstNextEvent = BURST_EVENT_COUNT;  // Index of next event, COUNT = no burst in progress
+bool burstSpacingEnabled = false;        // true = 50ms offsets, false = whole burst at once
+int64_t burstStartUs = 0;                // esp_timer time of the current burst's start
+uint32_t burstEpochCount = 0;            // Bursts started, for the message divisors
+unsigned long burstEpochStart = 0;       // millis() at which the current epoch began
+
+// =============================================================================
+// UART BAUD RATE AND BURST BYTE BUDGET
+// =============================================================================
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Per-epoch Byte Budget
+ * 
+ * WHAT: Checks that a burst can physically leave the UART within one epoch
+ * WHY: 8N1 framing sends 10 bits per byte, so 9600 baud carries 960 bytes/s.
+ *      The full ~600 byte burst barely fits at 1 Hz and cannot fit at 5 Hz -
+ *      sentences would queue up ever later until the ring buffer overflowed
+ * HOW: The bytes each message takes are measured whenever it is sent. The
+ *      enabled mandatory (RMC/GGA/GSA) and optional (GSV/TXT) sizes are summed
+ *      for the worst-case epoch - one where every divisor lines up. If both
+ *      don't fit in the budget the optional ones are dropped; if even the
+ *      mandatory ones don't, the user is warned to raise the baud rate or
+ *      lower the fix rate
+ * GOTCHAS: The budget keeps a 10% margin for inter-byte gaps and jitter. A
+ *          message's size is remembered while dropped, so it comes back as soon
+ *          as the configuration makes room
+ * 
+ * Example: 9600 baud at 5 Hz → 172 bytes per epoch: RMC+GGA+GSA only
+ */
+const uint32_t SUPPORTED_BAUD_RATES[] = {4800, 9600, 19200, 38400, 57600, 115200};
+
+enum BurstBudgetState {
+  BUDGET_OK,                // Whole burst fits
+  BUDGET_DROPPING_OPTIONAL, // GSV/TXT suppressed to make RMC/GGA/GSA fit
+  BUDGET_OVERRUN            // Even the mandatory sentences do not fit
+};
+
+BurstBudgetState burstBudgetState = BUDGET_OK;
+uint32_t mandatoryBurstBytes = 0;         // Worst-case size of the enabled mandatory messages
+uint32_t optionalBurstBytes = 0;          // Worst-case size of the enabled optional messages
+uint16_t burstMessageAccum[OUTPUT_MESSAGE_COUNT];  // Bytes queued per message in this burst
+bool burstMessageSent[OUTPUT_MESSAGE_COUNT];
+bool burstDropOptional = false;           // Decision for the burst in progress
+uint32_t optionalSentencesDropped = 0;    // Sentences skipped for lack of budget
+
+/**
+ * Bytes the GPIO UART can transmit in one epoch, less a 10% margin
+ */
+uint32_t epochByteBudget() {
+  return (gpsBaudRate / 10) * gpsEpochMs() / 1000 * 9 / 10;
+}
+
+/**
+ * Decide which sentences the next burst can include
+ */
+void planBurstBudget() {
+  mandatoryBurstBytes = 0;
+  optionalBurstBytes = 0;
+  for (const OutputMessageConfig& message : outputMessages) {
+    if (!message.enabled) continue;
+    (message.optional ? optionalBurstBytes : mandatoryBurstBytes) += message.burstBytes;
+  }
+  
+  uint32_t budget = epochByteBudget();
+  BurstBudgetState newState;
+  if (mandatoryBurstBytes + optionalBurstBytes <= budget) {
+    newState = BUDGET_OK;
+  } else if (mandatoryBurstBytes <= budget) {
+    newState = BUDGET_DROPPING_OPTIONAL;
+  } else {
+    newState = BUDGET_OVERRUN;
+  }
+  burstDropOptional = newState != BUDGET_OK;
+  
+  if (newState != burstBudgetState) {
+    burstBudgetState = newState;
+    const char* message = "UART budget OK";
+    if (newState == BUDGET_DROPPING_OPTIONAL) {
+      message = "UART budget: GSV/TXT dropped";
+    } else if (newState == BUDGET_OVERRUN) {
+      message = "UART overrun: raise baud";
+    }
+    setStatus(message);
+    LOG_INFO("Burst budget: %u+%u bytes vs %u per epoch - %s",
+                  mandatoryBurstBytes, optionalBurstBytes, budget, message);
+  }
+}
+
+/**
+ * Check a requested baud rate against the neo-6m's supported set
+ */
+bool isSupportedBaudRate(uint32_t baud) {
+  for (uint32_t candidate : SUPPORTED_BAUD_RATES) {
+    if (baud == candidate) return true;
+  }
+  return false;
+}
+
+/**
+ * Load saved GPIO UART baud rate from SPIFFS
+ * 
+ * @return saved rate, or 9600 if none is saved
+ */
+uint32_t loadBaudRatePreference() {
+  File baudFile = SPIFFS.open("/gps_baud.txt", "r");
+  if (!baudFile) {
+    return 9600;
+  }
+  
+  uint32_t baud = baudFile.readStringUntil('\n').toInt();
+  baudFile.close();
+  return isSupportedBaudRate(baud) ? baud : 9600;
+}
+
+/**
+ * Change the GPIO UART baud rate and optionally save it for the next boot
+ * 
+ * The switch itself happens in the output task between sentences, so a
+ * sentence is never split across two baud rates - and anything queued before
+ * this call (such as the ACK for a CFG-PRT) still goes out at the old rate.
+ * 
+ * @param baud New rate, already validated with isSupportedBaudRate()
+ * @param persist false for host commands, which like a real module are
+ *                forgotten at power-off
+ */
+void setBaudRate(uint32_t baud, bool persist = true) {
+  if (baud == gpsBaudRate) return;
+  
+  gpsBaudRate = baud;
+  pendingBaudRate = baud;
+  if (gpsOutputTaskHandle) {
+    xTaskNotifyGive(gpsOutputTaskHandle);
+  }
+  
+  if (!persist) return;
+  File baudFile = SPIFFS.open("/gps_baud.txt", "w");
+  if (baudFile) {
+    baudFile.println(baud);
+    baudFile.close();
+  }
+}
+
+/**
+ * Emit a single scheduled sentence of the burst
+ * 
+ * @param sentence Which sentence of the burst to send
+ * @param epochGPS The channel's interpolated fix for this epoch
+ */
+void emitBurstSentence(BurstSentence sentence, const GPSData& epochGPS) {
+  switch (sentence) {
+    case BURST_GNRMC:   sendGNRMC(epochGPS); break;
+    case BURST_GNGGA:   sendGNGGA(epochGPS); break;
+    case BURST_GNGSA_1: sendGNGSA(1); break;
+    case BURST_GNGSA_2: sendGNGSA(2); break;
+    case BURST_GPGSV_1: sendGPGSV(1); break;
+    case BURST_GPGSV_2: sendGPGSV(2); break;
+    case BURST_BDGSV:   sendBDGSV(); break;
+    case BURST_GNTXT:   sendGNTXT(); break;
+    case BURST_UBX_NAV_PVT:    sendUBXNavPVT(epochGPS); break;
+    case BURST_UBX_NAV_POSLLH: sendUBXNavPOSLLH(epochGPS); break;
+    case BURST_UBX_NAV_SOL:    sendUBXNavSOL(epochGPS); break;
+  }
+}
+
+bool burstInProgress() {
+  return burstNextEvent < BURST_EVENT_COUNT;
+}
+
+/**
+ * Start a new burst at the given epoch time
+ * 
+ * @param epochStart millis() value the event offsets are relative to
+ */
+void startBurst(unsigned long epochStart) {
+  burstEpochStart = epochStart;
+  burstStartUs = esp_timer_get_time();
+  burstNextEvent = 0;
+  burstEpochCount++;
+  memset(burstMessageAccum, 0, sizeof(burstMessageAccum));
+  memset(burstMessageSent, 0, sizeof(burstMessageSent));
+  planBurstBudget();
+}
+
+/**
+ * Emit every burst event that has become due, without blocking
+ * 
+ * @return true when the final event of the burst was emitted by this call
+ */
+bool serviceBurstScheduler() {
+  if (!burstInProgress()) return false;
+  
+  // Offsets are laid out for a 1000ms epoch - compress them to fit faster rates.
+  // Without spacing every event is due at once, like a real receiver's burst
+  unsigned long elapsed = burstSpacingEnabled ? (millis() - burstEpochStart) * gpsFixRateHz : ULONG_MAX;
+  while (burstInProgress() && elapsed >= BURST_SCHEDULE[burstNextEvent].offsetMs) {
+    const BurstEvent& event = BURST_SCHEDULE[burstNextEvent];
+    const OutputMessageConfig& message = outputMessages[event.message];
+    if (!message.enabled || burstEpochCount % message.divisor != 0) {
+      // Switched off, or not due this epoch - not a budget drop
+    } else if (message.optional && burstDropOptional) {
+      optionalSentencesDropped++;
+    } else {
+      // Only bytes bound for the GPIO UART count against its budget
+      uint32_t before = outputRing.gpioQueuedBytes;
+      uint32_t start = ESP.getCycleCount();
+      emitBurstSentence(event.sentence, primaryChannel.epochGPS);
+      recordStage(STAGE_FORMAT, start);
+      burstMessageAccum[event.message] += outputRing.gpioQueuedBytes - before;
+      burstMessageSent[event.message] = true;
+    }
+    burstNextEvent++;
+  }
+  
+  if (burstInProgress()) return false;
+  
+  // Tell the output task the burst is complete so it goes out in one write
+  if (outputRing.pushBurstEnd(burstStartUs) && gpsOutputTaskHandle) {
+    xTaskNotifyGive(gpsOutputTaskHandle);
+  }
+  
+  // Remember the measured sizes for planning the next burst; messages that
+  // weren't sent keep their last known size
+  for (int i = 0; i < OUTPUT_MESSAGE_COUNT; i++) {
+    if (burstMessageSent[i]) {
+      outputMessages[i].burstBytes = burstMessageAccum[i];
+    }
+  }
+  return true;
+}
+
+// =============================================================================
+// COMPILED BINARY TRACK FORMAT
+// =============================================================================
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Pre-compiled Binary Track
+ * 
+ * WHAT: The uploaded CSV is transcoded once into fixed-size binary records
+ * WHY: Each CSV line is ~70 columns, but only six fields matter. Re-parsing the
+ *      text with indexOf/substring for every fix wasted CPU and flash reads;
+ *      a 20-byte record is read straight into a struct with one call
+ * HOW: TrackFileHeader, then recordCount TrackRecords. Values are scaled
+ *      integers (lat/lon in 1e-7 degrees, speed in 1/100 knot, ...)
+ * GOTCHAS: Structs are packed and little-endian (native ESP32 layout).
+ *          Bump TRACK_FORMAT_VERSION whenever TrackRecord changes - old files
+ *          are then rejected and recompiled from the CSV
+ * 
+ * Example: 3384-row sample CSV (1.5MB) → 16 + 3384 × 20 bytes = 68KB
+ */
+const uint32_t TRACK_MAGIC = 0x4B525447;  // "GTRK" in little-endian byte order
+const uint16_t TRACK_FORMAT_VERSION = 1;
+
+struct __attribute__((packed)) TrackFileHeader {
+  uint32_t magic;           // TRACK_MAGIC
+  uint16_t version;         // TRACK_FORMAT_VERSION
+  uint16_t recordSize;      // sizeof(TrackRecord), sanity check
+  uint32_t recordCount;     // Number of records following the header
+  uint32_t reserved;        // Zero
+};
+
+struct __attribute__((packed)) TrackRecord {
+  uint32_t timeOffsetMs;    // UTC_time relative to the first fix
+  int32_t latitudeE7;       // Latitude in 1e-7 degrees (positive = North)
+  int32_t longitudeE7;      // Longitude in 1e-7 degrees (positive = East)
+  uint16_t courseCentiDeg;  // Course over ground in 0.01 degrees
+  uint16_t speedCentiKnots; // Speed over ground in 0.01 knots
+  uint16_t hdopCenti;       // HDOP × 100
+  uint8_t sats;             // Satellites used in fix
+  uint8_t reserved;         // Zero
+};
+
+/**
+ * Does a header describe a track this firmware can read?
+ */
+bool isValidTrackHeader(const TrackFileHeader& header) {
+  return header.magic == TRACK_MAGIC &&
+         header.version == TRACK_FORMAT_VERSION &&
+         header.recordSize == sizeof(TrackRecord);
+}
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Streaming CSV Ingest
+ * 
+ * WHAT: Incremental parser fed with arbitrary chunks of CSV text, writing
+ *       binary TrackRecords to flash as each line completes
+ * WHY: Writing the upload to flash and then re-reading the whole file to
+ *      compile it doubled the flash traffic and left a 1MB track unusable for
+ *      seconds after the upload finished
+ * HOW: Bytes are collected into a fixed line buffer. Each '\n' completes a
+ *      line: the first is validated as the header, the rest become records.
+ *      Chunk boundaries can fall anywhere, even in the middle of a CR/LF
+ * GOTCHAS: Lines longer than CSV_MAX_LINE are counted as errors and skipped,
+ *          not truncated - a truncated row would silently lose its last columns
+ * 
+ * Example: AsyncWebServer delivers a 1.5MB upload as ~1.4KB chunks; each one
+ *          goes straight to feed() and the track is ready when final arrives
+ */
+const int CSV_MAX_LINE = 2048;  // The sample header is ~1.6KB, data rows ~500 bytes
+
+// Outcome of an ingest, reported back to the uploader
+struct TrackIngestResult {
+  uint32_t rows = 0;        // Data rows seen (header excluded)
+  uint32_t fixes = 0;       // Records written
+  uint32_t skipped = 0;     // Rows without a usable fix
+  uint32_t overlong = 0;    // Rows longer than CSV_MAX_LINE
+  uint32_t durationMs = 0;  // Offset of the last fix
+  int32_t minLatitudeE7 = INT32_MAX;   // Bounding box of the fixes written
+  int32_t maxLatitudeE7 = INT32_MIN;
+  int32_t minLongitudeE7 = INT32_MAX;
+  int32_t maxLongitudeE7 = INT32_MIN;
+  String error;             // Empty on success
+};
+
+/**
+ * Widen an ingest's bounding box and duration to take in one more record
+ */
+void includeInTrackExtent(TrackIngestResult& result, const TrackRecord& record) {
+  result.durationMs = record.timeOffsetMs;
+  result.minLatitudeE7 = min(result.minLatitudeE7, record.latitudeE7);
+  result.maxLatitudeE7 = max(result.maxLatitudeE7, record.latitudeE7);
+  result.minLongitudeE7 = min(result.minLongitudeE7, record.longitudeE7);
+  result.maxLongitudeE7 = max(result.maxLongitudeE7, record.longitudeE7);
+}
+
+class CSVTrackIngest {
+public:
+  /**
+   * Start a new ingest writing to an open, empty track file
+   */
+  void begin(File& output) {
+    out = &output;
+    lineLength = 0;
+    discarding = false;
+    headerSeen = false;
+    failed = false;
+    firstSecond = -1;
+    previousSecond = 0;
+    dayOffset = 0;
+    result = TrackIngestResult();
+    
+    // Placeholder header - recordCount is patched in by finish()
+    header = {TRACK_MAGIC, TRACK_FORMAT_VERSION, sizeof(TrackRecord), 0, 0};
+    out->write((const uint8_t*)&header, sizeof(header));
+  }
+  
+  /**
+   * Consume the next chunk of CSV text
+   */
+  void feed(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len && !failed; i++) {
+      char c = (char)data[i];
+      if (c == '\n') {
+        endLine();
+      } else if (discarding) {
+        continue;
+      } else if (lineLength < CSV_MAX_LINE - 1) {
+        lineBuffer[lineLength++] = c;
+      } else {
+        discarding = true;  // Skip the rest of this overlong line
+      }
+    }
+  }
+  
+  /**
+   * Flush the last (unterminated) line and patch the file header
+   * 
+   * @return the ingest statistics; result.error is set on failure
+   */
+  const TrackIngestResult& finish() {
+    if (!failed && (lineLength > 0 || discarding)) {
+      endLine();
+    }
+    if (!failed && !headerSeen) {
+      fail("CSV is empty");
+    }
+    if (!failed && result.fixes == 0) {
+      fail("CSV has no valid fixes");
+    }
+    
+    header.recordCount = result.fixes;
+    out->seek(0);
+    out->write((const uint8_t*)&header, sizeof(header));
+    return result;
+  }
+  
+  bool ok() const { return !failed; }
+  
+private:
+  void endLine() {
+    if (lineLength > 0 && lineBuffer[lineLength - 1] == '\r') {
+      lineLength--;  // CR/LF line endings
+    }
+    lineBuffer[lineLength] = '\0';
+    
+    if (discarding) {
+      result.rows++;
+      result.overlong++;
+    } else if (!headerSeen) {
+      headerSeen = true;
+      validateHeader();
+    } else if (lineLength > 0) {
+      result.rows++;
+      processRow();
+    }
+    
+    lineLength = 0;
+    discarding = false;
+  }
+  
+  void validateHeader() {
+    const char* missing = parseCSVHeader(lineBuffer, columns);
+    if (missing) {
+      fail(String("CSV header missing column ") + missing);
+    }
+  }
+  
+  void processRow() {
+    GPSData gps;
+    parseCSVLine(lineBuffer, columns, gps);
+    
+    long second = gps.valid ? parseTimeOfDay(gps.utc_time) : -1;
+    if (second < 0) {
+      result.skipped++;
+      return;
+    }
+    if (firstSecond < 0) firstSecond = previousSecond = second;
+    if (second < previousSecond) dayOffset += 86400L;  // Crossed UTC midnight
+    previousSecond = second;
+    
+    TrackRecord record;
+    record.timeOffsetMs = (uint32_t)(second + dayOffset - firstSecond) * 1000UL;
+    record.latitudeE7 = gps.latitudeE7;
+    record.longitudeE7 = gps.longitudeE7;
+    record.courseCentiDeg = (uint16_t)lroundf(gps.gps_course * 100);
+    record.speedCentiKnots = (uint16_t)lroundf(gps.gps_speed_knots * 100);
+    record.hdopCenti = (uint16_t)lroundf(gps.hdop * 100);
+    record.sats = (uint8_t)gps.sats;
+    record.reserved = 0;
+    
+    if (out->write((const uint8_t*)&record, sizeof(record)) != sizeof(record)) {
+      fail("Flash full - track truncated");
+      return;
+    }
+    result.fixes++;
+    includeInTrackExtent(result, record);
+  }
+  
+  void fail(const String& message) {
+    failed = true;
+    result.error = message;
+  }
+  
+  File* out = nullptr;
+  TrackFileHeader header;
+  TrackIngestResult result;
+  CSVColumnMap columns;      // Built from the header line
+  
+  char lineBuffer[CSV_MAX_LINE];
+  int lineLength = 0;
+  bool discarding = false;   // Inside an overlong line
+  bool headerSeen = false;
+  bool failed = false;
+  
+  long firstSecond = -1;     // UTC second of the first fix
+  long previousSecond = 0;
+  long dayOffset = 0;        // Adds 86400 for every UTC midnight crossed
+};
+
+// One ingest at a time - used by the upload handler and the boot-time migration
+CSVTrackIngest trackIngest;
+TrackIngestResult lastIngestResult;
+
+/**
+ * Compile a CSV left on flash by older firmware into a binary track
+ * 
+ * New uploads are ingested while they stream in and never stored as CSV.
+ * 
+ * @param path Where to write the compiled track
+ * @return true if a valid track was written; lastIngestResult has its statistics
+ */
+bool compileTrack(const String& path) {
+  File csv = SPIFFS.open(TRACK_CSV_PATH, "r");
+  if (!csv) {
+    setStatus("Failed to open CSV");
+    LOG_ERROR("compileTrack(): Failed to open CSV");
+    return false;
+  }
+  
+  File bin = SPIFFS.open(path, "w");
+  if (!bin) {
+    csv.close();
+    setStatus("Failed to create track");
+    LOG_ERROR("compileTrack(): Failed to create track");
+    return false;
+  }
+  
+  uint8_t chunk[512];
+  trackIngest.begin(bin);
+  while (csv.available() && trackIngest.ok()) {
+    size_t count = csv.read(chunk, sizeof(chunk));
+    trackIngest.feed(chunk, count);
+  }
+  lastIngestResult = trackIngest.finish();
+  csv.close();
+  bin.close();
+  
+  LOG_INFO("compileTrack(): %u fixes compiled", lastIngestResult.fixes);
+  if (!trackIngest.ok()) {
+    SPIFFS.remove(path);
+    setStatus(lastIngestResult.error);
+    return false;
+  }
+  return true;
+}
+
+// =============================================================================
+// TRACK STORE (RAM-RESIDENT OR FLASH)
+// =============================================================================
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: RAM-resident Track Cache
+ * 
+ * WHAT: The compiled records are copied into one heap array when they fit
+ * WHY: Reading each fix from SPIFFS costs a filesystem call (and a flash read
+ *      that stalls both cores' instruction cache) in the 1 Hz path; looping
+ *      and jumping around the track needed seeks or a reopen
+ * HOW: readTrackRecord(index) is a plain array access when the cache is
+ *      loaded and falls back to seek+read on the file otherwise - callers
+ *      never need to know which
+ * GOTCHAS: A contiguous block must be available; we keep TRACK_HEAP_RESERVE
+ *          bytes free for WiFi, the web server and uploads, so very long tracks
+ *          stay on flash. esp_partition_mmap() was not an option - SPIFFS
+ *          scatters a file's pages across the partition, so the records are
+ *          not contiguous in the mapped address space
+ * 
+ * Example: the 3384-fix sample track uses 68KB of RAM
+ */
+const size_t TRACK_RAM_CACHE_MAX_BYTES = 160 * 1024;  // 0 disables the cache
+const size_t TRACK_HEAP_RESERVE = 48 * 1024;          // Left free after caching
+
+/**
+ * Fetch a record by index - O(1) with no filesystem access when cached
+ * 
+ * @return false if index is beyond the end of the track
+ */
+bool readTrackRecord(SimChannel& ch, uint32_t index, TrackRecord& record) {
+  if (index >= ch.trackRecordCount) return false;
+  
+  if (ch.trackRecords) {
+    record = ch.trackRecords[index];
+    return true;
+  }
+  
+  return ch.trackFile &&
+         ch.trackFile.seek(sizeof(TrackFileHeader) + index * sizeof(TrackRecord)) &&
+         ch.trackFile.read((uint8_t*)&record, sizeof(record)) == sizeof(record);
+}
+
+/**
+ * Release a channel's RAM copy of its track (if any)
+ */
+void freeTrackCache(SimChannel& ch) {
+  free(ch.trackRecords);
+  ch.trackRecords = nullptr;
+  ch.trackResidentBytes = 0;
+}
+
+// A track opened (and cached) outside gpsStateMutex, waiting to be swapped
+// into a channel - afterwards it holds the channel's old track until released
+struct StagedTrack {
+  File file;
+  TrackRecord* records = nullptr;
+  size_t residentBytes = 0;
+  uint32_t recordCount = 0;
+  uint32_t durationMs = 0;
+  bool usable = false;
+};
+
+/**
+ * Try to copy a staged track's records into RAM
+ * 
+ * @return true if the track is now RAM-resident
+ */
+bool cacheTrackInRam(StagedTrack& track) {
+  size_t bytes = track.recordCount * sizeof(TrackRecord);
+  if (bytes == 0 || bytes > TRACK_RAM_CACHE_MAX_BYTES ||
+      heap_caps_get_largest_free_block(MALLOC_CAP_8BIT) < bytes + TRACK_HEAP_RESERVE) {
+    return false;
+  }
+  
+  TrackRecord* records = (TrackRecord*)malloc(bytes);
+  if (!records) return false;
+  
+  track.file.seek(sizeof(TrackFileHeader));
+  if (track.file.read((uint8_t*)records, bytes) != bytes) {
+    free(records);
+    return false;
+  }
+  
+  track.records = records;
+  track.residentBytes = bytes;
+  return true;
+}
+
+/**
+ * Move playback to an arbitrary fix
+ * 
+ * @param index Record to be returned by the next getNextGPSData()
+ */
+void seekTrack(SimChannel& ch, uint32_t index) {
+  ch.currentLine = index < ch.trackRecordCount ? index : 0;
+}
+
+/**
+ * Close a channel's track and forget its playback position
+ */
+void unloadTrack(SimChannel& ch) {
+  ch.trackFile.close();
+  freeTrackCache(ch);
+  ch.trackRecordCount = 0;
+  ch.trackDurationMs = 0;
+  ch.csvLoaded = false;
+  ch.currentGPS = GPSData();
+}
+
+uint32_t catalogDurationMs(const char* name);  // Defined with the TRACK CATALOG
+
+/**
+ * Open a library track and cache its records when they fit
+ * 
+ * Flash and heap work only - no channel state is touched, so this runs
+ * without gpsStateMutex while the generator carries on.
+ * 
+ * @param channelName For the log
+ * @return true if track holds a usable track
+ */
+bool stageTrack(const char* channelName, const char* name, StagedTrack& track) {
+  String path = trackPath(name);
+  if (name[0] == '\0' || !SPIFFS.exists(path)) {
+    setStatus("No track selected");
+    LOG_INFO("loadTrack(%s): No track selected", channelName);
+    return false;
+  }
+  
+  track.file = SPIFFS.open(path, "r");
+  if (!track.file) {
+    setStatus("Failed to open track");
+    LOG_ERROR("loadTrack(%s): Failed to open track", channelName);
+    return false;
+  }
+  
+  TrackFileHeader header;
+  if (track.file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+      !isValidTrackHeader(header)) {
+    // Stale or corrupt - left in the library for the user to delete or replace
+    track.file.close();
+    setStatus("Track format invalid");
+    LOG_WARN("loadTrack(%s): Track format invalid", channelName);
+    return false;
+  }
+  
+  track.recordCount = header.recordCount;
+  track.durationMs = catalogDurationMs(name);  // Indexed at upload - no record read
+  if (cacheTrackInRam(track)) {
+    track.file.close();  // Everything needed is in RAM now
+  }
+  track.usable = true;
+  return true;
+}
+
+/**
+ * Swap a staged track into a channel and position it at the first record
+ * 
+ * Caller holds gpsStateMutex; this is assignments only. The channel's old
+ * file and cache move into track, to be released after the mutex is given back.
+ */
+void swapInTrack(SimChannel& ch, StagedTrack& track) {
+  std::swap(ch.trackFile, track.file);
+  std::swap(ch.trackRecords, track.records);
+  std::swap(ch.trackResidentBytes, track.residentBytes);
+  ch.trackRecordCount = track.usable ? track.recordCount : 0;
+  ch.trackDurationMs = track.usable ? track.durationMs : 0;
+  ch.csvLoaded = track.usable;
+  ch.currentGPS = GPSData();
+  seekTrack(ch, 0);
+}
+
+/**
+ * Release whatever a staged track still holds
+ */
+void releaseStagedTrack(StagedTrack& track) {
+  track.file.close();
+  free(track.records);
+  track = StagedTrack();
+}
+
+/**
+ * Open the library track a channel has selected and position it at the first record
+ * 
+ * The records are cached in RAM when they fit. Only the final swap holds
+ * gpsStateMutex - the caller must not hold it.
+ * 
+ * @return true if a usable track is open
+ */
+bool loadTrack(SimChannel& ch) {
+  StagedTrack track;
+  bool usable = stageTrack(ch.name, ch.trackName, track);
+  
+  xSemaphoreTake(gpsStateMutex, portMAX_DELAY);
+  swapInTrack(ch, track);
+  xSemaphoreGive(gpsStateMutex);
+  releaseStagedTrack(track);  // The previous track's file and cache
+  
+  if (usable) {
+    setStatus("Track " + String(ch.trackName) + " loaded");
+    LOG_INFO("loadTrack(%s): track %s loaded (%u fixes, %s)", ch.name, ch.trackName, ch.trackRecordCount,
+                  ch.trackRecords ? "RAM" : "flash");
+  }
+  return usable;
+}
+
+/**
+ * Read the next fix from a channel's compiled track
+ * 
+ * @return the fix, with valid == false at end of track
+ */
+GPSData getNextGPSData(SimChannel& ch) {
+  GPSData gps;
+  TrackRecord record;
+  
+  if (!readTrackRecord(ch, ch.currentLine, record)) {
+    return gps; // Invalid GPS data
+  }
+  
+  gps.latitudeE7 = record.latitudeE7;
+  gps.longitudeE7 = record.longitudeE7;
+  gps.gps_course = record.courseCentiDeg / 100.0f;
+  gps.gps_speed_knots = record.speedCentiKnots / 100.0f;
+  gps.hdop = record.hdopCenti / 100.0f;
+  gps.sats = record.sats;
+  gps.track_time_ms = record.timeOffsetMs;
+  gps.valid = true;
+  ch.currentLine++;
+  
+  return gps;
+}
+
+// =============================================================================
+// EPOCH CLOCK AND PPS
+// =============================================================================
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Timer-driven Epoch Clock
+ * 
+ * WHAT: A one-shot esp_timer fires at every epoch boundary of UTC time and
+ *       wakes the generator task; on whole seconds it also raises PPS_PIN
+ * WHY: Epochs used to be found by comparing millis() in a polling loop, so
+ *      each burst started up to a tick (plus any mutex wait) late and the
+ *      jitter was visible to a receiver timing the first byte. A real module
+ *      starts its burst a fixed time after its timepulse, every time
+ * HOW: UTC is kept as an offset against esp_timer_get_time(), the free-running
+ *      1µs system timer. The next boundary is the next multiple of the epoch
+ *      period in UTC, converted back to timer time, so epochs line up with
+ *      the top of the second at any fix rate. The callback re-arms itself for
+ *      the following boundary and notifies the generator, which now blocks in
+ *      ulTaskNotifyTake() rather than polling
+ * GOTCHAS: esp_timer callbacks run in the high-priority esp_timer task, not an
+ *          ISR - they must stay short and must not block. The offset is 64
+ *          bits, so it is read and written inside a critical section. After
+ *          a rate change or a clock step the boundary already armed may not
+ *          be an epoch any more - it is skipped, not emitted
+ * 
+ * Example: 5 Hz → timer fires at xx.000, .200, .400 ... PPS rises at xx.000
+ *          and the RMC of that epoch follows within a few hundred µs
+ */
+
+portMUX_TYPE epochClockMux = portMUX_INITIALIZER_UNLOCKED;
+// Until the first sync the clock starts at 2000-01-01 00:00:00 UTC
+const int64_t UNSYNCED_EPOCH_UTC_US = 946684800LL * 1000000LL;
+
+int64_t utcOffsetUs = UNSYNCED_EPOCH_UTC_US;  // UTC µs since 1970 minus esp_timer_get_time()
+int64_t slewRemainingUs = 0;       // Correction still to be slewed into the offset
+bool epochClockSet = false;        // Set by the first NTP sample
+
+esp_timer_handle_t epochTimer = nullptr;
+esp_timer_handle_t ppsOffTimer = nullptr;
+int64_t epochTimerTargetUs = 0;    // esp_timer time the armed boundary is due
+int64_t dueEpochUtcUs = 0;         // UTC of the latest boundary, for the generator
+int64_t dueEpochTimerUs = 0;       // ...and its esp_timer time, for the burst jitter
+bool epochDue = false;
+
+bool ppsOutputEnabled = false;     // Timepulse on PPS_PIN, set by /output-config
+volatile uint32_t ppsPulses = 0;
+
+// Measured lateness of an event against its ideal time, in µs
+struct JitterStats {
+  volatile int32_t lastUs = 0;
+  volatile int32_t maxUs = 0;
+  volatile uint32_t meanUs = 0;    // Running mean (1/16 weight) - tracks recent behaviour
+  volatile uint32_t samples = 0;
+};
+JitterStats epochTimerJitter;      // Timer callback vs the boundary it was armed for
+JitterStats burstStartJitter;      // Burst start in the generator vs the boundary
+
+void recordJitter(JitterStats& stats, int64_t errorUs) {
+  int32_t error = (int32_t)constrain(errorUs, (int64_t)INT32_MIN, (int64_t)INT32_MAX);
+  uint32_t magnitude = error < 0 ? -error : error;
+  stats.lastUs = error;
+  if (magnitude > (uint32_t)abs(stats.maxUs)) stats.maxUs = error;
+  stats.meanUs = stats.samples ? stats.meanUs + ((int32_t)(magnitude - stats.meanUs) >> 4) : magnitude;
+  stats.samples++;
+}
+
+void printJitterJson(JsonPrinter& json, const char* key, const JitterStats& stats) {
+  json.beginObject(key)
+      .field("last_us", stats.lastUs)
+      .field("max_us", stats.maxUs)
+      .field("mean_us", stats.meanUs)
+      .field("samples", stats.samples)
+      .endObject();
+}
+
+int64_t readUtcOffset() {
+  portENTER_CRITICAL(&epochClockMux);
+  int64_t offset = utcOffsetUs;
+  portEXIT_CRITICAL(&epochClockMux);
+  return offset;
+}
+
+// Current UTC time in µs since 1970
+int64_t utcMicros() {
+  return esp_timer_get_time() + readUtcOffset();
+}
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Time Service (NTP Offset with Slew)
+ * 
+ * WHAT: The offset above is the whole time service. The ESP-IDF SNTP client
+ *       refreshes it in the background and small corrections are slewed in
+ * WHY: NTPClient::update() is a blocking UDP round trip and was called from
+ *      the generator every 30s and loop() every 60s - either could stall an
+ *      epoch. It also only knew whole seconds, so the fallback truncated and
+ *      the phase of the epochs within the second was arbitrary
+ * HOW: configTime() starts lwIP's SNTP client, which polls on its own from
+ *      the tcpip task. Its sync callback pairs gettimeofday() (µs from the
+ *      NTP fraction) with esp_timer_get_time() for a fresh offset sample. The
+ *      first sample, or one off by more than TIME_STEP_THRESHOLD_US, steps
+ *      the clock; smaller errors are slewed by the epoch timer, at most
+ *      TIME_SLEW_PPM of each epoch period. Reading the time is one addition
+ * GOTCHAS: A step makes one epoch short, long or repeated - exactly what
+ *          slewing avoids, so it is kept for large errors. The callback runs
+ *          in another task, so the pending slew shares the offset's lock
+ * 
+ * Example: sample 3ms ahead → at 500ppm it is slewed in over 6 seconds at
+ *          1 Hz, each of those epochs 500µs shorter than nominal
+ */
+const int64_t TIME_STEP_THRESHOLD_US = 128000;          // Same step threshold as ntpd
+const int64_t TIME_SLEW_PPM = 500;                      // Same maximum slew as adjtime()
+const uint32_t TIME_SYNC_INTERVAL_MS = 15 * 60 * 1000;  // Background SNTP refresh
+volatile int32_t lastTimeCorrectionUs = 0;              // Error of the latest NTP sample
+
+/**
+ * Slew part of any pending correction into the offset (called per epoch)
+ */
+void applyTimeSlew() {
+  int64_t limitUs = gpsEpochMs() * 1000LL * TIME_SLEW_PPM / 1000000LL;
+  portENTER_CRITICAL(&epochClockMux);
+  int64_t stepUs = constrain(slewRemainingUs, -limitUs, limitUs);
+  utcOffsetUs += stepUs;
+  slewRemainingUs -= stepUs;
+  portEXIT_CRITICAL(&epochClockMux);
+}
+
+/**
+ * Arm the epoch timer for the next boundary after now
+ */
+void armEpochTimer() {
+  int64_t periodUs = gpsEpochMs() * 1000LL;
+  int64_t now = esp_timer_get_time();
+  int64_t offset = readUtcOffset();
+  int64_t nextUtc = ((now + offset) / periodUs + 1) * periodUs;
+  epochTimerTargetUs = nextUtc - offset;
+  esp_timer_start_once(epochTimer, epochTimerTargetUs - now);
+}
+
+void onPpsOffTimer(void* arg) {
+  gpio_set_level((gpio_num_t)PPS_PIN, 0);
+}
+
+void onEpochTimer(void* arg) {
+  int64_t firedUs = esp_timer_get_time();
+  int64_t targetUs = epochTimerTargetUs;
+  int64_t boundaryUtc = targetUs + readUtcOffset();
+  
+  // Timepulse first - it is the reference everything else is measured from
+  if (ppsOutputEnabled && boundaryUtc % 1000000LL == 0) {
+    gpio_set_level((gpio_num_t)PPS_PIN, 1);
+    esp_timer_start_once(ppsOffTimer, PPS_PULSE_US);
+    ppsPulses++;
+  }
+  recordJitter(epochTimerJitter, firedUs - targetUs);
+  
+  // Skip boundaries left over from a previous rate or before a clock step
+  if (boundaryUtc % (gpsEpochMs() * 1000LL) == 0) {
+    portENTER_CRITICAL(&epochClockMux);
+    dueEpochUtcUs = boundaryUtc;
+    dueEpochTimerUs = targetUs;
+    epochDue = true;
+    portEXIT_CRITICAL(&epochClockMux);
+    if (gpsGeneratorTaskHandle) xTaskNotifyGive(gpsGeneratorTaskHandle);
+  }
+  
+  applyTimeSlew();
+  armEpochTimer();
+}
+
+/**
+ * Claim the latest due epoch, if any (called by the generator)
+ * 
+ * @param utcUs Receives the epoch's UTC time in µs since 1970
+ * @param timerUs Receives the esp_timer time it was due
+ * @return false if no epoch has become due since the last claim
+ */
+bool takeDueEpoch(int64_t& utcUs, int64_t& timerUs) {
+  portENTER_CRITICAL(&epochClockMux);
+  bool due = epochDue;
+  epochDue = false;
+  utcUs = dueEpochUtcUs;
+  timerUs = dueEpochTimerUs;
+  portEXIT_CRITICAL(&epochClockMux);
+  return due;
+}
+
+/**
+ * Sync callback of the SNTP client - runs in the lwIP tcpip task
+ * 
+ * @param tv The time just set (unused - re-read alongside esp_timer below)
+ */
+void onTimeSync(struct timeval* tv) {
+  struct timeval now;
+  gettimeofday(&now, nullptr);
+  int64_t timerUs = esp_timer_get_time();
+  int64_t sampleOffsetUs = now.tv_sec * 1000000LL + now.tv_usec - timerUs;
+  
+  portENTER_CRITICAL(&epochClockMux);
+  // Error against where the clock is already heading once its slew is done
+  int64_t errorUs = sampleOffsetUs - (utcOffsetUs + slewRemainingUs);
+  bool step = !epochClockSet || llabs(errorUs) > TIME_STEP_THRESHOLD_US;
+  if (step) {
+    utcOffsetUs = sampleOffsetUs;
+    slewRemainingUs = 0;
+  } else {
+    slewRemainingUs += errorUs;
+  }
+  epochClockSet = true;
+  portEXIT_CRITICAL(&epochClockMux);
+  
+  lastTimeCorrectionUs = (int32_t)constrain(errorUs, (int64_t)INT32_MIN, (int64_t)INT32_MAX);
+  lastSuccessfulNtpSync = millis();
+  ntpSyncCompleted = true;
+  timeSyncCount++;
+  LOG_INFO("Time service: NTP sample %s by %lld us", step ? "stepped" : "slewing", (long long)errorUs);
+}
+
+/**
+ * Start (or restart) the background SNTP client - needs a WiFi connection
+ */
+void startTimeService() {
+  sntp_set_time_sync_notification_cb(onTimeSync);
+  sntp_set_sync_mode(SNTP_SYNC_MODE_IMMED);  // We slew our own offset, not the system time
+  sntp_set_sync_interval(TIME_SYNC_INTERVAL_MS);
+  configTime(0, 0, NTP_SERVER);  // UTC - NMEA and UBX times are always UTC
+}
+
+/**
+ * Start the epoch clock and configure the PPS pin
+ */
+void initEpochClock() {
+  pinMode(PPS_PIN, OUTPUT);
+  gpio_set_level((gpio_num_t)PPS_PIN, 0);
+  
+  esp_timer_create_args_t epochArgs = {};
+  epochArgs.callback = onEpochTimer;
+  epochArgs.name = "gpsEpoch";
+  esp_timer_create(&epochArgs, &epochTimer);
+  
+  esp_timer_create_args_t ppsArgs = {};
+  ppsArgs.callback = onPpsOffTimer;
+  ppsArgs.name = "ppsOff";
+  esp_timer_create(&ppsArgs, &ppsOffTimer);
+  
+  armEpochTimer();
+}
+
+// =============================================================================
+// RAW LOG REPLAY
+// =============================================================================
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Indexed Replay File
+ * 
+ * WHAT: A capture uploaded to /replay/upload is split into epochs (see
+ *       ReplayLog.h) while it streams in, and stored as one binary file
+ * WHY: A replay must be byte-exact and on time. Scanning log text from the
+ *      1ms generator loop would be neither cheap nor predictable; reading one
+ *      ready-made epoch per fix is a few flash reads
+ * HOW: ReplayFileHeader, then per epoch its ReplayEpochHeader, sentence table
+ *      and wire bytes, then one ReplayIndexEntry per epoch for seeking. The
+ *      index goes to a side file during the upload and is appended at the
+ *      end, because the epoch count is only known then
+ * GOTCHAS: Packed little-endian, as the track format. There is one replay -
+ *          a new upload replaces it. The replay itself is not a track: speed,
+ *          loop range and the message settings do not apply to it
+ * 
+ * Example: the NEO-6M sample stores ~600 bytes per epoch, 8 of them index
+ */
+const char* REPLAY_PATH = "/replay.bin";
+const char* REPLAY_UPLOAD_PATH = "/replay.tmp";
+const char* REPLAY_INDEX_UPLOAD_PATH = "/replay.idx";
+const uint32_t REPLAY_MAGIC = 0x594C5052;  // "RPLY" in little-endian byte order
+const uint16_t REPLAY_FORMAT_VERSION = 1;
+
+struct __attribute__((packed)) ReplayFileHeader {
+  uint32_t magic;           // REPLAY_MAGIC
+  uint16_t version;         // REPLAY_FORMAT_VERSION
+  uint16_t reserved;        // Zero
+  uint32_t epochCount;      // Epochs (and index entries) in the file
+  uint32_t sentenceCount;
+  uint32_t durationMs;      // Offset of the last epoch
+  uint32_t indexOffset;     // File position of the first ReplayIndexEntry
+};
+
+struct __attribute__((packed)) ReplayIndexEntry {
+  uint32_t offsetMs;        // The epoch's ReplayEpochHeader::offsetMs
+  uint32_t position;        // File position of its ReplayEpochHeader
+};
+
+// Outcome of a replay upload, reported back to the uploader
+struct ReplayIngestResult {
+  ReplayScanStats stats;
+  String error;             // Empty on success
+};
+
+class ReplayLogIngest {
+public:
+  /**
+   * Start a new ingest into the two upload files
+   * 
+   * @return false if either file could not be created
+   */
+  bool begin() {
+    result = ReplayIngestResult();
+    failed = false;
+    written = 0;
+    out = SPIFFS.open(REPLAY_UPLOAD_PATH, "w");
+    index = SPIFFS.open(REPLAY_INDEX_UPLOAD_PATH, "w");
+    if (!out || !index) {
+      out.close();
+      index.close();
+      SPIFFS.remove(REPLAY_UPLOAD_PATH);
+      SPIFFS.remove(REPLAY_INDEX_UPLOAD_PATH);
+      return false;
+    }
+    
+    // Placeholder header - counts and the index position are patched in by finish()
+    header = {REPLAY_MAGIC, REPLAY_FORMAT_VERSION, 0, 0, 0, 0, 0};
+    write(&header, sizeof(header));
+    scanner.begin(storeEpoch, this);
+    return true;
+  }
+  
+  /**
+   * Consume the next chunk of the capture
+   */
+  void feed(const uint8_t* data, size_t len) {
+    scanner.feed(data, len);
+  }
+  
+  /**
+   * Hand over the last epoch, append the index and patch the file header
+   * 
+   * Leaves a complete file at REPLAY_UPLOAD_PATH on success and removes
+   * both upload files otherwise.
+   * 
+   * @return the ingest statistics; result.error is set on failure
+   */
+  const ReplayIngestResult& finish() {
+    result.stats = scanner.finish();
+    if (!failed && result.stats.epochs == 0) {
+      fail("No NMEA sentences found");
+    }
+    
+    index.close();
+    if (!failed) {
+      header.epochCount = result.stats.epochs;
+      header.sentenceCount = result.stats.sentences;
+      header.durationMs = result.stats.durationMs;
+      header.indexOffset = written;
+      
+      File entries = SPIFFS.open(REPLAY_INDEX_UPLOAD_PATH, "r");
+      uint8_t chunk[256];
+      size_t count;
+      while (!failed && (count = entries.read(chunk, sizeof(chunk))) > 0) {
+        write(chunk, count);
+      }
+      entries.close();
+      out.seek(0);
+      out.write((const uint8_t*)&header, sizeof(header));
+    }
+    out.close();
+    
+    SPIFFS.remove(REPLAY_INDEX_UPLOAD_PATH);
+    if (failed) {
+      SPIFFS.remove(REPLAY_UPLOAD_PATH);
+    }
+    return result;
+  }
+  
+  bool ok() const { return !failed && scanner.ok(); }
+  
+private:
+  static bool storeEpoch(const ReplayEpoch& epoch, void* context) {
+    ReplayLogIngest& ingest = *(ReplayLogIngest*)context;
+    ReplayIndexEntry entry = {epoch.header.offsetMs, ingest.written};
+    if (ingest.index.write((const uint8_t*)&entry, sizeof(entry)) != sizeof(entry)) {
+      ingest.fail("Flash full - replay truncated");
+      return false;
+    }
+    ingest.write(&epoch.header, sizeof(epoch.header));
+    ingest.write(epoch.sentences, epoch.header.sentenceCount * sizeof(ReplaySentence));
+    ingest.write(epoch.bytes, epoch.header.byteCount);
+    return !ingest.failed;
+  }
+  
+  void write(const void* data, size_t length) {
+    if (failed) return;
+    if (out.write((const uint8_t*)data, length) != length) {
+      fail("Flash full - replay truncated");
+      return;
+    }
+    written += length;
+  }
+  
+  void fail(const String& message) {
+    failed = true;
+    result.error = message;
+  }
+  
+  ReplayLogScanner scanner;  // Holds the epoch being assembled (~1.2KB)
+  File out;
+  File index;
+  ReplayFileHeader header;
+  ReplayIngestResult result;
+  uint32_t written = 0;      // Bytes in out so far - the next epoch's position
+  bool failed = false;
+};
+
+// One ingest at a time - used by the upload handler
+ReplayLogIngest replayIngest;
+ReplayIngestResult lastReplayResult;
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Playing Back at the Capture's Own Cadence
+ * 
+ * WHAT: With the replay enabled, channel A sends the capture's epochs in
+ *       place of its synthesized bursts - same outputs, same output task
+ * WHY: Recorded bytes reproduce exactly what a real module sent (its TXT
+ *      banners, GSV layouts, field widths) for tests against real captures
+ * HOW: The next epoch is always read ahead. Offset 0 is anchored to the
+ *      esp_timer clock when playback starts (or resumes, or seeks), and each
+ *      epoch is queued whole once its offset has passed, followed by a burst
+ *      marker - so the wire carries each burst back to back, one per epoch
+ * GOTCHAS: The epoch clock keeps ticking and its epochs are drained unused:
+ *          the capture's own times decide. Rewriting times needs the UTC
+ *          clock set (NTP) to mean anything. An epoch is only queued when the
+ *          ring has a slot for each of its sentences and the marker
+ * 
+ * Example: a capture of 120 epochs loops after 120s - the first epoch goes
+ *          out one epoch interval after the last, as the module would send it
+ */
+struct ReplayPlayer {
+  File file;                // Open while loaded - generator task only
+  ReplayFileHeader header;
+  bool loaded = false;
+  bool enabled = false;     // Channel A plays the replay instead of its track
+  bool rewriteTime = false; // Stamp the current UTC time and date into each epoch
+  bool running = false;     // Clock anchored - false while stopped or after a seek
+  ReplayEpoch next;         // Read ahead, queued once due
+  uint32_t nextEpoch = 0;   // Number of the epoch in next
+  uint32_t fileEpoch = 0;   // Number of the epoch at the file's read position
+  int64_t startUs = 0;      // esp_timer time of offset 0
+  int64_t startUtcMs = 0;   // UTC of offset 0, for rewritten times
+  uint32_t epochsSent = 0;
+};
+
+ReplayPlayer replay;
+
+/**
+ * Read the epoch at the file position into replay.next, looping at the end
+ * 
+ * An unreadable epoch unloads the replay - channel A goes back to its track.
+ * 
+ * @return false if the file could not be read
+ */
+bool readNextReplayEpoch() {
+  ReplayFileHeader& header = replay.header;
+  if (replay.fileEpoch >= header.epochCount) {
+    // Back to the start, one epoch interval after the last epoch
+    uint32_t gapMs = header.epochCount > 1 ? header.durationMs / (header.epochCount - 1) : 1000;
+    replay.startUs += (int64_t)(header.durationMs + gapMs) * 1000;
+    replay.startUtcMs += header.durationMs + gapMs;
+    replay.file.seek(sizeof(ReplayFileHeader));
+    replay.fileEpoch = 0;
+  }
+  
+  ReplayEpoch& epoch = replay.next;
+  size_t tableBytes = 0;
+  bool readOk = replay.file.read((uint8_t*)&epoch.header, sizeof(epoch.header)) == sizeof(epoch.header) &&
+                epoch.header.sentenceCount <= REPLAY_EPOCH_SENTENCES_MAX &&
+                epoch.header.byteCount <= REPLAY_EPOCH_BYTES_MAX;
+  if (readOk) {
+    tableBytes = epoch.header.sentenceCount * sizeof(ReplaySentence);
+    readOk = replay.file.read((uint8_t*)epoch.sentences, tableBytes) == tableBytes &&
+             replay.file.read((uint8_t*)epoch.bytes, epoch.header.byteCount) == epoch.header.byteCount;
+  }
+  if (!readOk) {
+    LOG_WARN("readNextReplayEpoch(): epoch %u unreadable", replay.fileEpoch);
+    setStatus("Replay file unreadable");
+    replay.file.close();
+    replay.loaded = false;
+    replay.enabled = false;
+    return false;
+  }
+  replay.nextEpoch = replay.fileEpoch++;
+  return true;
+}
+
+/**
+ * Open the stored replay and read its first epoch
+ * 
+ * Caller holds gpsStateMutex (or the generator task is not yet running).
+ * 
+ * @return true if a valid replay is ready to play
+ */
+bool loadReplay() {
+  replay.file.close();
+  replay.loaded = false;
+  replay.running = false;
+  if (!SPIFFS.exists(REPLAY_PATH)) return false;
+  
+  replay.file = SPIFFS.open(REPLAY_PATH, "r");
+  ReplayFileHeader& header = replay.header;
+  bool valid = replay.file &&
+               replay.file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+               header.magic == REPLAY_MAGIC && header.version == REPLAY_FORMAT_VERSION &&
+               header.epochCount > 0 &&
+               header.indexOffset + header.epochCount * sizeof(ReplayIndexEntry) <= replay.file.size();
+  if (!valid) {
+    LOG_WARN("loadReplay(): %s is not a valid replay", REPLAY_PATH);
+    replay.file.close();
+    return false;
+  }
+  
+  replay.fileEpoch = 0;
+  replay.loaded = true;
+  if (!readNextReplayEpoch()) return false;
+  LOG_INFO("loadReplay(): %u epochs, %u sentences, %us", header.epochCount, header.sentenceCount,
+           header.durationMs / 1000);
+  return true;
+}
+
+/**
+ * Continue the replay from the last epoch at or before an offset
+ * 
+ * Caller holds gpsStateMutex. The clock is re-anchored at the next service,
+ * so the chosen epoch goes out straight away.
+ */
+void seekReplay(uint32_t offsetMs) {
+  if (!replay.loaded) return;
+  
+  // Binary search of the index stored at the end of the file
+  ReplayIndexEntry entry = {0, sizeof(ReplayFileHeader)};
+  uint32_t low = 0, high = replay.header.epochCount;
+  uint32_t found = 0;
+  while (low < high) {
+    uint32_t mid = (low + high) / 2;
+    ReplayIndexEntry probe;
+    replay.file.seek(replay.header.indexOffset + mid * sizeof(ReplayIndexEntry));
+    if (replay.file.read((uint8_t*)&probe, sizeof(probe)) != sizeof(probe)) break;
+    if (probe.offsetMs <= offsetMs) {
+      entry = probe;
+      found = mid;
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  
+  replay.file.seek(entry.position);
+  replay.fileEpoch = found;
+  replay.running = false;
+  readNextReplayEpoch();
+}
+
+/**
+ * Queue one epoch as a single burst, optionally with today's time and date
+ */
+void queueReplayEpoch(ReplayEpoch& epoch, int64_t dueUs) {
+  char hhmmss[7];
+  char ddmmyy[7];
+  if (replay.rewriteTime) {
+    int64_t utcMs = replay.startUtcMs + epoch.header.offsetMs;
+    long days = (long)(utcMs / 86400000LL);
+    long msOfDay = (long)(utcMs % 86400000LL);
+    int year, month, day;
+    civilFromDays(days, year, month, day);
+    snprintf(hhmmss, sizeof(hhmmss), "%02ld%02ld%02ld",
+             msOfDay / 3600000L, msOfDay / 60000L % 60, msOfDay / 1000L % 60);
+    snprintf(ddmmyy, sizeof(ddmmyy), "%02d%02d%02d", day, month, year % 100);
+  }
+  
+  uint8_t channels = channelsForProtocol(PROTOCOL_NMEA);
+  for (int i = 0; i < epoch.header.sentenceCount; i++) {
+    const ReplaySentence& sentence = epoch.sentences[i];
+    char* text = epoch.bytes + sentence.start;
+    if (replay.rewriteTime) {
+      rewriteReplaySentence(text, sentence, hhmmss, ddmmyy);
+    }
+    queueOutput(text, sentence.length, channels, false);  // CR/LF already stored
+  }
+  
+  if (outputRing.pushBurstEnd(dueUs) && gpsOutputTaskHandle) {
+    xTaskNotifyGive(gpsOutputTaskHandle);
+  }
+  replay.epochsSent++;
+}
+
+/**
+ * Queue every epoch that has fallen due - called by the generator task
+ */
+void serviceReplay() {
+  if (!replay.loaded) return;
+  
+  int64_t nowUs = esp_timer_get_time();
+  if (!replay.running) {
+    // Started, resumed or seeked: the read-ahead epoch goes out now
+    replay.startUs = nowUs - (int64_t)replay.next.header.offsetMs * 1000;
+    replay.startUtcMs = utcMicros() / 1000 - replay.next.header.offsetMs;
+    replay.running = true;
+  }
+  
+  while (replay.loaded) {
+    int64_t dueUs = replay.startUs + (int64_t)replay.next.header.offsetMs * 1000;
+    if (nowUs < dueUs) return;
+    if (outputRing.freeSlots() <= replay.next.header.sentenceCount) return;  // Output task behind - next tick
+    
+    queueReplayEpoch(replay.next, dueUs);
+    readNextReplayEpoch();
+  }
+}
+
+/**
+ * Is channel A playing the replay rather than its track?
+ */
+bool replaySelected() {
+  return replay.enabled && replay.loaded;
+}
+
+/**
+ * Replace the stored replay with a completed upload
+ * 
+ * @return false if the rename failed or the new file is not a valid replay
+ */
+bool installUploadedReplay() {
+  xSemaphoreTake(gpsStateMutex, portMAX_DELAY);
+  replay.file.close();
+  replay.loaded = false;
+  SPIFFS.remove(REPLAY_PATH);
+  bool installed = SPIFFS.rename(REPLAY_UPLOAD_PATH, REPLAY_PATH) && loadReplay();
+  if (!installed) {
+    replay.enabled = false;
+  }
+  xSemaphoreGive(gpsStateMutex);
+  return installed;
+}
+
+/**
+ * Add the replay state to a JSON response
+ */
+void printReplayJson(JsonPrinter& json, const char* key) {
+  json.beginObject(key)
+      .field("loaded", replay.loaded)
+      .field("enabled", replay.enabled)
+      .field("rewrite_time", replay.rewriteTime)
+      .field("epochs", replay.loaded ? replay.header.epochCount : 0)
+      .field("sentences", replay.loaded ? replay.header.sentenceCount : 0)
+      .field("duration_s", replay.loaded ? replay.header.durationMs / 1000 : 0)
+      .field("position_s", replay.loaded ? replay.next.header.offsetMs / 1000 : 0)
+      .field("epochs_sent", replay.epochsSent)
+      .endObject();
+}
+
+// =============================================================================
+// TRACK TIMELINE AND INTERPOLATION ENGINE
+// =============================================================================
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Real-time Track Timeline
+ * 
+ * WHAT: Playback follows the CSV's UTC_time column. Every epoch advances the
+ *       track clock by one epoch period, and the output fix is interpolated
+ *       inside the segment of two track fixes that brackets that time
+ * WHY: Logged fixes are unevenly spaced (17:07:30, :34, :36 ...). Emitting one
+ *      row per second compressed time and made speeds inconsistent with the
+ *      distance travelled; the neo-6m always reports at its fixed rate
+ * HOW: Only two fixes are ever decoded - currentGPS (segment start) and nextGPS
+ *      (segment end). When the track clock passes nextGPS the segment slides
+ *      forward one fix, and its great-circle geometry is precomputed once
+ *      (lazily, one segment ahead) so each epoch is a couple of sin() calls.
+ *      At N Hz the time field carries k/N fractional seconds
+ * GOTCHAS: Course wraps at 360° - 350° → 10° must pass through 0°, not 180°.
+ *          The segment from the last fix back to the first (track loop) is
+ *          not interpolated, it would sweep across the whole track - the last
+ *          fix is held for one second instead
+ * 
+ * Example: fixes at 17:07:30 and 17:07:34 → outputs at :31, :32, :33 are
+ *          25%, 50% and 75% of the way along the great circle between them
+ */
+uint8_t epochIndex = 0;               // Epoch within the current second (0..rate-1), from the epoch clock
+unsigned long epochSecond = 0;        // UTC second (since 1970) being transmitted
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Time-warped Playback
+ * 
+ * WHAT: The track clock can run up to 60× faster than real time, jump to any
+ *       offset in the track and repeat a chosen range of it
+ * WHY: Playback was locked to real time, so validating a 3-hour dive log took
+ *      3 hours - and reaching the interesting part meant waiting for it
+ * HOW: Each epoch advances trackTimeMs by period × playbackSpeed, while the
+ *      epoch clock keeps ticking at the configured fix rate, so the receiver
+ *      sees the usual sentence cadence. Seeking binary-searches the compiled
+ *      records through readTrackRecord() - an hour into the sample track is
+ *      ~12 record reads, never a re-read of the file. Timestamps follow
+ *      timestampMode:
+ *      - TIMESTAMP_REALTIME: UTC from the epoch clock. The craft covers
+ *        playbackSpeed seconds of track per second, so SOG is scaled by
+ *        playbackSpeed to agree with the distance between timestamps
+ *      - TIMESTAMP_TRACK: a warped UTC clock, taken from the epoch clock when
+ *        the mode is chosen, that advances period × playbackSpeed per epoch -
+ *        time, position and logged speed all agree, as on the original dive
+ * GOTCHAS: Seeks and loops move the track clock, never the warped clock - a
+ *          receiver treats time running backwards as a fault. PPS keeps
+ *          marking real seconds, so it only lines up with TIMESTAMP_REALTIME
+ * 
+ * Example: 30× with a 17:00-17:20 loop replays those 20 minutes every 40s
+ */
+enum TimestampMode {
+  TIMESTAMP_REALTIME,                 // UTC from the epoch clock
+  TIMESTAMP_TRACK                     // Warped clock running at playbackSpeed
+};
+
+const uint8_t PLAYBACK_SPEED_MAX = 60;
+
+uint8_t playbackSpeed = 1;            // Seconds of track per second of output
+TimestampMode timestampMode = TIMESTAMP_REALTIME;
+uint32_t loopStartMs = 0;             // Loop range in track time - loopEndMs == 0
+uint32_t loopEndMs = 0;               // plays (and loops) the whole track
+int64_t warpedUtcUs = 0;              // TIMESTAMP_TRACK clock, 0 = start from the epoch clock
+
+/**
+ * Fetch the following fix, looping back to the start of the track
+ * 
+ * @param wrapped Set to true if the track looped to get it
+ */
+GPSData fetchNextFix(SimChannel& ch, bool& wrapped) {
+  uint32_t start = ESP.getCycleCount();
+  wrapped = false;
+  GPSData gps = getNextGPSData(ch);
+  if (!gps.valid) {
+    LOG_DEBUG("SimulateGPS(%s): end of file reached", ch.name);
+    // Restart from the first record if we reach end of file
+    seekTrack(ch, 0);
+    gps = getNextGPSData(ch);
+    wrapped = true;
+  }
+  recordStage(STAGE_DECODE, start);
+  return gps;
+}
+
+void toUnitVector(const GPSData& gps, double vector[3]) {
+  double lat = gps.latitudeE7 * (DEG_TO_RAD / 1e7);
+  double lon = gps.longitudeE7 * (DEG_TO_RAD / 1e7);
+  vector[0] = cos(lat) * cos(lon);
+  vector[1] = cos(lat) * sin(lon);
+  vector[2] = sin(lat);
+}
+
+/**
+ * Precompute the segment currentGPS → nextGPS
+ * 
+ * @param wrapped true if nextGPS was reached by looping the track
+ */
+void buildSegment(SimChannel& ch, bool wrapped) {
+  TrackSegment& seg = ch.currentSegment;
+  const GPSData& from = ch.currentGPS;
+  const GPSData& to = ch.nextGPS;
+  seg.startMs = from.track_time_ms;
+  seg.loops = wrapped;
+  seg.interpolate = !wrapped && to.track_time_ms > from.track_time_ms;
+  // Rows sharing a timestamp give a zero-length segment that is skipped at once
+  seg.durationMs = wrapped ? 1000 : to.track_time_ms - from.track_time_ms;
+  
+  toUnitVector(from, seg.fromVector);
+  toUnitVector(to, seg.toVector);
+  double dot = seg.fromVector[0] * seg.toVector[0] +
+               seg.fromVector[1] * seg.toVector[1] +
+               seg.fromVector[2] * seg.toVector[2];
+  seg.angle = acos(constrain(dot, -1.0, 1.0));
+  seg.sinAngle = sin(seg.angle);
+}
+
+/**
+ * Start playback at the next fix in the track
+ */
+void primeGPSData(SimChannel& ch) {
+  bool wrapped;
+  ch.currentGPS = fetchNextFix(ch, wrapped);
+  ch.nextGPS = fetchNextFix(ch, wrapped);
+  buildSegment(ch, wrapped);
+  ch.trackTimeMs = ch.currentGPS.track_time_ms;
+}
+
+/**
+ * Convert a user-supplied offset in seconds to track time
+ * 
+ * @return the offset in ms, clamped to 0 .. the channel's trackDurationMs
+ */
+uint32_t trackOffsetMs(const SimChannel& ch, long seconds) {
+  if (seconds <= 0) return 0;
+  if ((unsigned long)seconds > ch.trackDurationMs / 1000) return ch.trackDurationMs;
+  return seconds * 1000UL;
+}
+
+/**
+ * Restart playback at an arbitrary point in the track
+ * 
+ * Finds the segment containing offsetMs by binary search over the records
+ * (their offsets only ever increase) and interpolates from inside it.
+ * 
+ * @param offsetMs Track time to play next, clamped to the last fix
+ */
+void seekPlayback(SimChannel& ch, uint32_t offsetMs) {
+  // Invariant: record low is at or before offsetMs (record 0 is at 0)
+  uint32_t low = 0;
+  uint32_t high = ch.trackRecordCount;
+  while (high - low > 1) {
+    uint32_t mid = low + (high - low) / 2;
+    TrackRecord record;
+    if (!readTrackRecord(ch, mid, record)) break;
+    if (record.timeOffsetMs <= offsetMs) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+  
+  seekTrack(ch, low);
+  primeGPSData(ch);
+  const TrackSegment& seg = ch.currentSegment;
+  if (seg.interpolate && offsetMs < seg.startMs + seg.durationMs) {
+    ch.trackTimeMs = offsetMs;
+  }
+}
+
+/**
+ * Advance a channel's track clock by one epoch, sliding the segment forward
+ * past every fix it has overtaken
+ */
+void advanceGPSData(SimChannel& ch) {
+  ch.trackTimeMs += gpsEpochMs() * playbackSpeed;
+  
+  // The loop range is in the primary's track time
+  if (&ch == &primaryChannel && loopEndMs > loopStartMs && ch.trackTimeMs >= loopEndMs) {
+    seekPlayback(ch, loopStartMs);
+    return;
+  }
+  
+  while (ch.trackTimeMs >= ch.currentSegment.startMs + ch.currentSegment.durationMs) {
+    bool loopPoint = ch.currentSegment.loops;
+    ch.currentGPS = ch.nextGPS;
+    if (loopPoint) {
+      ch.trackTimeMs = ch.currentGPS.track_time_ms;  // Track clock restarts with the track
+    }
+    bool wrapped;
+    ch.nextGPS = fetchNextFix(ch, wrapped);
+    buildSegment(ch, wrapped);
+  }
+}
+
+/**
+ * Interpolate a channel's current segment at its track clock
+ * 
+ * Position follows the great circle between the two fixes; speed is linear
+ * and course takes the short way round the compass.
+ */
+GPSData interpolateGPS(const SimChannel& ch) {
+  const TrackSegment& seg = ch.currentSegment;
+  const GPSData& from = ch.currentGPS;
+  const GPSData& to = ch.nextGPS;
+  GPSData gps = from;
+  if (!seg.interpolate) return gps;
+  
+  double fraction = (double)(ch.trackTimeMs - seg.startMs) / seg.durationMs;
+  
+  // Spherical linear interpolation; fall back to linear for coincident fixes
+  if (seg.sinAngle > 1e-12) {
+    double a = sin((1.0 - fraction) * seg.angle) / seg.sinAngle;
+    double b = sin(fraction * seg.angle) / seg.sinAngle;
+    double x = a * seg.fromVector[0] + b * seg.toVector[0];
+    double y = a * seg.fromVector[1] + b * seg.toVector[1];
+    double z = a * seg.fromVector[2] + b * seg.toVector[2];
+    gps.latitudeE7 = lround(atan2(z, sqrt(x * x + y * y)) * (RAD_TO_DEG * 1e7));
+    gps.longitudeE7 = lround(atan2(y, x) * (RAD_TO_DEG * 1e7));
+  }
+  
+  gps.gps_speed_knots = from.gps_speed_knots + (to.gps_speed_knots - from.gps_speed_knots) * fraction;
+  
+  // Take the short way round the compass
+  float courseDelta = to.gps_course - from.gps_course;
+  if (courseDelta > 180.0f) courseDelta -= 360.0f;
+  if (courseDelta < -180.0f) courseDelta += 360.0f;
+  gps.gps_course = from.gps_course + courseDelta * fraction;
+  if (gps.gps_course < 0.0f) gps.gps_course += 360.0f;
+  if (gps.gps_course >= 360.0f) gps.gps_course -= 360.0f;
+  
+  return gps;
+}
+
+/**
+ * Is this channel taking part in the simulation?
+ */
+bool channelActive(const SimChannel& ch) {
+  return ch.csvLoaded && (&ch == &primaryChannel || ch.enabled);
+}
+
+/**
+ * Is this channel generating fixes? Channel A is not while a raw log replay
+ * plays in its place
+ */
+bool channelRunning(const SimChannel& ch) {
+  return channelActive(ch) && !(&ch == &primaryChannel && replaySelected());
+}
+
+/**
+ * Is there anything for /start or button A to start?
+ */
+bool simulationReady() {
+  if (replaySelected()) return true;
+  for (const SimChannel& ch : simChannels) {
+    if (channelActive(ch)) return true;
+  }
+  return false;
+}
+
+/**
+ * Move a channel on to the next epoch - the primary once its burst is out,
+ * a secondary as soon as its burst is encoded
+ */
+void advanceChannel(SimChannel& ch) {
+  if (ch.currentGPS.valid) {
+    advanceGPSData(ch);
+  }
+}
+
+/**
+ * Bytes a secondary module's UART can transmit in one epoch, less a 10% margin
+ */
+uint32_t channelByteBudget(const SimChannel& ch) {
+  return (ch.baudRate / 10) * gpsEpochMs() / 1000 * 9 / 10;
+}
+
+/**
+ * Encode a secondary channel's whole burst at once, in BURST_SCHEDULE order
+ * 
+ * Its sentences go to its own UART only. GSV and TXT are left out while the
+ * full burst would not fit the module's baud rate.
+ */
+void encodeSecondaryBurst(SimChannel& ch) {
+  if (!ch.epochGPS.valid) return;
+  
+  selectConstellationView(ch.epochGPS);   // Its own satellite count and DOPs
+  bool dropOptional = ch.burstBytes > channelByteBudget(ch);
+  uint32_t before = outputRing.auxQueuedBytes;
+  encodingOutputs = ch.outputs;
+  for (const BurstEvent& event : BURST_SCHEDULE) {
+    bool masked = event.message > MSG_TXT || !(ch.messageMask & (1 << event.message));
+    if (masked || (dropOptional && outputMessages[event.message].optional)) continue;
+    emitBurstSentence(event.sentence, ch.epochGPS);
+  }
+  encodingOutputs = 0;
+  
+  // Only a complete burst tells us whether the complete burst fits
+  if (!dropOptional) {
+    ch.burstBytes = outputRing.auxQueuedBytes - before;
+  }
+}
+
+void simulateGPS() {
+  if (!gpsSimActive) {
+    burstNextEvent = BURST_EVENT_COUNT;  // Abandon any half-sent burst
+    int64_t utcUs, timerUs;
+    takeDueEpoch(utcUs, timerUs);        // ...and epochs that fell due while stopped
+    replay.running = false;              // Resumes from the read-ahead epoch
+    return;
+  }
+  
+  // A raw log replay takes channel A's place and keeps its own time; the
+  // secondary modules carry on with their own tracks whatever A is doing
+  if (replaySelected()) {
+    serviceReplay();
+  }
+  bool primaryRunning = channelRunning(primaryChannel);
+  if (!primaryRunning) {
+    burstNextEvent = BURST_EVENT_COUNT;  // Abandon A's half-sent burst
+  }
+  
+  // Emit whatever part of the current burst has become due
+  if (burstInProgress()) {
+    if (serviceBurstScheduler()) {
+      // Move on to the next epoch once the whole burst has gone out
+      advanceChannel(primaryChannel);
+    }
+    return;
+  }
+  
+  int64_t epochUtcUs, epochTimerUs;
+  if (takeDueEpoch(epochUtcUs, epochTimerUs)) {
+    uint32_t epochStart = ESP.getCycleCount();
+    unsigned long period = gpsEpochMs();
+    
+    // Fetch the first fixes of a freshly started simulation (or channel);
+    // secondary channels start at their offset into their own track
+    for (SimChannel& ch : simChannels) {
+      if (!channelRunning(ch)) continue;
+      ch.lastGpsOutput = millis();
+      if (ch.currentGPS.valid) continue;
+      if (&ch == &primaryChannel) {
+        primeGPSData(ch);
+      } else {
+        seekPlayback(ch, ch.startOffsetMs);
+      }
+    }
+    
+    // The epoch clock's boundary is the epoch's UTC time - whole second
+    // plus which k/N of it - so the time field never runs backwards.
+    // Warped timestamps stay on the same period grid
+    int64_t stampUs = epochUtcUs;
+    if (timestampMode == TIMESTAMP_TRACK) {
+      if (warpedUtcUs == 0) warpedUtcUs = epochUtcUs;
+      stampUs = warpedUtcUs;
+      warpedUtcUs += (int64_t)period * playbackSpeed * 1000LL;  // The next epoch's stamp
+    }
+    epochSecond = stampUs / 1000000LL;
+    epochIndex = (stampUs % 1000000LL) / (period * 1000LL);
+    
+    int hours = (epochSecond % 86400L) / 3600;
+    int minutes = (epochSecond % 3600) / 60;
+    int seconds = epochSecond % 60;
+    int centiseconds = epochIndex * 100 / gpsFixRateHz;
+    setEpochUtcMillis(stampUs / 1000);
+    
+    // Every channel reports the same time - one interpolation pass each
+    uint32_t interpolateStart = ESP.getCycleCount();
+    for (SimChannel& ch : simChannels) {
+      if (!channelRunning(ch)) continue;
+      ch.epochGPS = interpolateGPS(ch);
+      if (timestampMode == TIMESTAMP_REALTIME) {
+        ch.epochGPS.gps_speed_knots *= playbackSpeed;  // Distance per real second
+      }
+      snprintf(ch.epochGPS.utc_time, sizeof(ch.epochGPS.utc_time), "%02d%02d%02d.%02d",
+               hours, minutes, seconds, centiseconds);
+    }
+    // Satellites move with the time the receiver is told, warped or not
+    GPSData& epochGPS = primaryChannel.epochGPS;
+    updateConstellation(timestampMode == TIMESTAMP_TRACK ? period * playbackSpeed : period);
+    recordStage(STAGE_INTERPOLATE, interpolateStart);
+    if (primaryRunning && epochGPS.valid) publishDisplaySnapshot(primaryChannel);
+    
+    // Secondary modules send their whole burst at once, ahead of the primary's,
+    // and move straight on to their next epoch
+    for (int i = 1; i < SIM_CHANNEL_COUNT; i++) {
+      SimChannel& ch = simChannels[i];
+      if (!channelRunning(ch)) continue;
+      encodeSecondaryBurst(ch);
+      advanceChannel(ch);
+    }
+    
+    if (!primaryRunning) return;
+    if (epochGPS.valid) {
+      // Send NMEA sentences in proper order, spaced by the burst schedule;
+      // the view stays A's until the next epoch's secondaries are encoded
+      selectConstellationView(epochGPS);
+      startBurst(primaryChannel.lastGpsOutput);
+      recordJitter(burstStartJitter, burstStartUs - epochTimerUs);
+      if (burstStartUs - epochTimerUs > LATE_EPOCH_US) lateEpochs++;
+      if (serviceBurstScheduler()) {
+        advanceChannel(primaryChannel);
+      }
+      recordStage(STAGE_EPOCH, epochStart);
+    }
+    else {
+      LOG_DEBUG("SimulateGPS(): current gps is invalid - skip");
+      primaryChannel.currentGPS.valid = false;  // Re-prime at the next epoch
+    }
+  }
+}
+
+// =============================================================================
+// SECONDARY CHANNEL SETTINGS
+// =============================================================================
+
+// Saved as one line per channel: "enabled baud sentence-mask start-offset-s"
+String channelPreferencePath(const SimChannel& ch) {
+  return "/channel_" + String(ch.name) + ".txt";
+}
+
+/**
+ * Load a secondary channel's module settings from SPIFFS
+ * 
+ * Missing or malformed files leave the defaults (disabled, 9600 baud, all sentences).
+ */
+void loadChannelPreferences(SimChannel& ch) {
+  File file = SPIFFS.open(channelPreferencePath(ch), "r");
+  if (!file) return;
+  
+  String line = file.readStringUntil('\n');
+  file.close();
+  int enabled;
+  unsigned long baud, mask, offsetSeconds;
+  if (sscanf(line.c_str(), "%d %lu %lu %lu", &enabled, &baud, &mask, &offsetSeconds) != 4 ||
+      !isSupportedBaudRate(baud)) {
+    return;
+  }
+  ch.enabled = enabled != 0;
+  ch.baudRate = baud;
+  ch.messageMask = mask & AUX_DEFAULT_MESSAGE_MASK;
+  ch.startOffsetMs = offsetSeconds * 1000UL;
+}
+
+void saveChannelPreferences(const SimChannel& ch) {
+  File file = SPIFFS.open(channelPreferencePath(ch), "w");
+  if (!file) return;
+  file.printf("%d %lu %u %lu\n", ch.enabled ? 1 : 0, (unsigned long)ch.baudRate,
+              ch.messageMask, (unsigned long)(ch.startOffsetMs / 1000));
+  file.close();
+}
+
+/**
+ * Change a secondary module's baud rate - applied by the output task
+ * between bursts, like the primary's
+ */
+void setChannelBaudRate(SimChannel& ch, uint32_t baud) {
+  if (baud == ch.baudRate) return;
+  ch.baudRate = baud;
+  ch.pendingBaudRate = baud;
+  if (gpsOutputTaskHandle) {
+    xTaskNotifyGive(gpsOutputTaskHandle);
+  }
+}
+
+/**
+ * Every channel as a JSON array for /status
+ * 
+ * The primary reports the GPIO UART's settings; its sentences follow the
+ * per-message rates in message_rates instead of a mask.
+ */
+void printChannelsJson(JsonPrinter& json, const char* key) {
+  json.beginArray(key);
+  for (const SimChannel& ch : simChannels) {
+    bool primary = &ch == &primaryChannel;
+    json.beginObject()
+        .field("name", ch.name)
+        .field("enabled", primary || ch.enabled)
+        .field("track", ch.trackName)
+        .field("csv_loaded", ch.csvLoaded)
+        .field("track_records", ch.trackRecordCount)
+        .field("track_time_s", ch.trackTimeMs / 1000)
+        .field("track_duration_s", ch.trackDurationMs / 1000)
+        .field("baud", primary ? gpsBaudRate : ch.baudRate)
+        .field("tx_pin", ch.txPin);
+    if (!primary) {
+      json.field("start_offset_s", ch.startOffsetMs / 1000)
+          .field("burst_bytes", ch.burstBytes)
+          .field("epoch_byte_budget", channelByteBudget(ch))
+          .beginObject("sentences");
+      for (int m = MSG_RMC; m <= MSG_TXT; m++) {
+        json.field(outputMessages[m].name, (ch.messageMask & (1 << m)) != 0);
+      }
+      json.endObject();
+    }
+    json.endObject();
+  }
+  json.endArray();
+}
+
+// =============================================================================
+// TRACK CATALOG
+// =============================================================================
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Track Library on Flash
+ * 
+ * WHAT: Several compiled tracks kept side by side in SPIFFS, with a small
+ *       index of each one's fixes, duration and bounding box
+ * WHY: With a single /gps_track.bin, changing scenario meant uploading the
+ *      next CSV over WiFi (minutes for 1MB) with the simulation stopped. A
+ *      compiled track is 20 bytes per fix, so the 1.4MB partition holds a
+ *      dozen or more logs that were a megabyte each as CSV
+ * HOW: Uploads compile into TRACK_UPLOAD_PATH and are renamed to
+ *      /tracks/<name>.bin once complete, so a failed upload never disturbs
+ *      the library or the track being played. Selecting a track for a
+ *      channel opens its file and refills the RAM cache outside the
+ *      generator's lock, then swaps them in - nothing is re-parsed.
+ *      trackCatalog[] is written to TRACK_INDEX_PATH on every change, so
+ *      listing the library never opens a track
+ * GOTCHAS: SPIFFS has no directories - "/tracks/" is only a name prefix. At
+ *          boot the index is checked against the files actually present and
+ *          any track it does not know (e.g. power lost between the rename and
+ *          the index write) is read through once to recover its entry.
+ *          Replacing a track needs room for both copies while the upload runs
+ * 
+ * Example: POST /tracks/select name=reef_dive&channel=B switches module B at
+ *          its next epoch while module A carries on with its own track
+ */
+const char* TRACK_INDEX_PATH = "/tracks/index.bin";
+const char* TRACK_UPLOAD_PATH = "/tracks/upload.tmp";
+const char* TRACK_SELECTION_PATH = "/tracks/selected.txt";  // "<channel> <track>" per line
+const int TRACK_CATALOG_MAX = 16;
+
+const uint32_t TRACK_INDEX_MAGIC = 0x58444954;  // "TIDX" in little-endian byte order
+const uint16_t TRACK_INDEX_VERSION = 1;
+
+struct __attribute__((packed)) TrackIndexHeader {
+  uint32_t magic;           // TRACK_INDEX_MAGIC
+  uint16_t version;         // TRACK_INDEX_VERSION
+  uint16_t entrySize;       // sizeof(TrackCatalogEntry), sanity check
+  uint32_t entryCount;      // Number of entries following the header
+};
+
+struct __attribute__((packed)) TrackCatalogEntry {
+  char name[TRACK_NAME_MAX + 1];  // NUL-terminated; the file is trackPath(name)
+  uint32_t recordCount;     // Fixes in the compiled track
+  uint32_t durationMs;      // Offset of the last fix
+  uint32_t fileBytes;       // Flash used by the compiled track
+  int32_t minLatitudeE7;    // Bounding box in 1e-7 degrees
+  int32_t maxLatitudeE7;
+  int32_t minLongitudeE7;
+  int32_t maxLongitudeE7;
+};
+
+// Only touched by setup() and the web handlers, which all run in one task
+TrackCatalogEntry trackCatalog[TRACK_CATALOG_MAX];
+int trackCatalogCount = 0;
+
+// Name the upload in progress is stored under, for the upload's reply
+char uploadTrackName[TRACK_NAME_MAX + 1] = "";
+
+/**
+ * Track names become file names: 1-16 letters, digits, '_' or '-'
+ */
+bool isValidTrackName(const String& name) {
+  if (name.length() == 0 || name.length() > (unsigned int)TRACK_NAME_MAX) return false;
+  for (unsigned int i = 0; i < name.length(); i++) {
+    unsigned char c = name[i];
+    if (!isalnum(c) && c != '_' && c != '-') return false;
+  }
+  return true;
+}
+
+/**
+ * Derive a track name from an uploaded file's name - "Reef dive 2.csv" → "Reef_dive_2"
+ */
+String trackNameFromFilename(const String& filename) {
+  int start = filename.lastIndexOf('/') + 1;
+  int end = filename.lastIndexOf('.');
+  if (end <= start) end = filename.length();
+  
+  String name;
+  for (int i = start; i < end && name.length() < (unsigned int)TRACK_NAME_MAX; i++) {
+    unsigned char c = filename[i];
+    name += (isalnum(c) || c == '-') ? (char)c : '_';
+  }
+  return name.length() ? name : String("track");
+}
+
+TrackCatalogEntry* findCatalogEntry(const char* name) {
+  for (int i = 0; i < trackCatalogCount; i++) {
+    if (strcmp(trackCatalog[i].name, name) == 0) return &trackCatalog[i];
+  }
+  return nullptr;
+}
+
+/**
+ * A library track's duration from the index, 0 if it is not in the library
+ */
+uint32_t catalogDurationMs(const char* name) {
+  const TrackCatalogEntry* entry = findCatalogEntry(name);
+  return entry ? entry->durationMs : 0;
+}
+
+/**
+ * Add a track to trackCatalog[], or refresh the entry of that name
+ * 
+ * @param extent Fix count, duration and bounding box from the ingest or a scan
+ * @return false if the catalog is full
+ */
+bool addCatalogEntry(const char* name, const TrackIngestResult& extent) {
+  TrackCatalogEntry* entry = findCatalogEntry(name);
+  if (!entry) {
+    if (trackCatalogCount >= TRACK_CATALOG_MAX) return false;
+    entry = &trackCatalog[trackCatalogCount++];
+  }
+  strlcpy(entry->name, name, sizeof(entry->name));
+  entry->recordCount = extent.fixes;
+  entry->durationMs = extent.durationMs;
+  entry->fileBytes = sizeof(TrackFileHeader) + extent.fixes * sizeof(TrackRecord);
+  entry->minLatitudeE7 = extent.minLatitudeE7;
+  entry->maxLatitudeE7 = extent.maxLatitudeE7;
+  entry->minLongitudeE7 = extent.minLongitudeE7;
+  entry->maxLongitudeE7 = extent.maxLongitudeE7;
+  return true;
+}
+
+void saveTrackCatalog() {
+  File file = SPIFFS.open(TRACK_INDEX_PATH, "w");
+  if (!file) {
+    LOG_ERROR("saveTrackCatalog(): cannot write %s", TRACK_INDEX_PATH);
+    return;
+  }
+  TrackIndexHeader header = {TRACK_INDEX_MAGIC, TRACK_INDEX_VERSION, sizeof(TrackCatalogEntry),
+                             (uint32_t)trackCatalogCount};
+  file.write((const uint8_t*)&header, sizeof(header));
+  file.write((const uint8_t*)trackCatalog, trackCatalogCount * sizeof(TrackCatalogEntry));
+  file.close();
+}
+
+/**
+ * Read the index into trackCatalog[]
+ * 
+ * @return false if it is missing or unreadable (the catalog is then empty)
+ */
+bool readTrackIndex() {
+  trackCatalogCount = 0;
+  File file = SPIFFS.open(TRACK_INDEX_PATH, "r");
+  if (!file) return false;
+  
+  TrackIndexHeader header;
+  size_t entryBytes = 0;
+  bool ok = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+            header.magic == TRACK_INDEX_MAGIC &&
+            header.version == TRACK_INDEX_VERSION &&
+            header.entrySize == sizeof(TrackCatalogEntry) &&
+            header.entryCount <= (uint32_t)TRACK_CATALOG_MAX;
+  if (ok) {
+    entryBytes = header.entryCount * sizeof(TrackCatalogEntry);
+    ok = file.read((uint8_t*)trackCatalog, entryBytes) == entryBytes;
+  }
+  file.close();
+  if (!ok) return false;
+  
+  trackCatalogCount = header.entryCount;
+  for (int i = 0; i < trackCatalogCount; i++) {
+    trackCatalog[i].name[TRACK_NAME_MAX] = '\0';
+  }
+  return true;
+}
+
+/**
+ * Recover a compiled track's catalog entry by reading it through once
+ * 
+ * @return false if the file is not a track this firmware can play
+ */
+bool scanTrackFile(const char* name, TrackIngestResult& extent) {
+  File file = SPIFFS.open(trackPath(name), "r");
+  if (!file) return false;
+  
+  TrackFileHeader header;
+  bool ok = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+            isValidTrackHeader(header) && header.recordCount > 0;
+  
+  TrackRecord records[32];
+  uint32_t remaining = ok ? header.recordCount : 0;
+  while (remaining > 0) {
+    uint32_t count = remaining < 32 ? remaining : 32;
+    size_t bytes = count * sizeof(TrackRecord);
+    if (file.read((uint8_t*)records, bytes) != bytes) {
+      ok = false;
+      break;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+      includeInTrackExtent(extent, records[i]);
+    }
+    remaining -= count;
+  }
+  file.close();
+  
+  extent.fixes = ok ? header.recordCount : 0;
+  return ok;
+}
+
+/**
+ * Bring trackCatalog[] in line with the track files actually on flash
+ * 
+ * Entries whose file has gone are dropped; files the index does not list,
+ * or lists at the wrong size, are scanned.
+ * 
+ * @return true if the catalog changed and should be saved
+ */
+bool reconcileTrackCatalog() {
+  bool changed = false;
+  for (int i = 0; i < trackCatalogCount; ) {
+    if (SPIFFS.exists(trackPath(trackCatalog[i].name))) {
+      i++;
+      continue;
+    }
+    memmove(&trackCatalog[i], &trackCatalog[i + 1], (trackCatalogCount - i - 1) * sizeof(TrackCatalogEntry));
+    trackCatalogCount--;
+    changed = true;
+  }
+  
+  File root = SPIFFS.open("/");
+  for (File file = root.openNextFile(); file; file = root.openNextFile()) {
+    String path = file.path();
+    size_t size = file.size();
+    file.close();
+    if (!path.startsWith("/tracks/") || !path.endsWith(".bin")) continue;
+    
+    String name = path.substring(8, path.length() - 4);
+    TrackCatalogEntry* entry = findCatalogEntry(name.c_str());
+    if (!isValidTrackName(name) || (entry && entry->fileBytes == size)) continue;
+    
+    TrackIngestResult extent;
+    if (scanTrackFile(name.c_str(), extent) && addCatalogEntry(name.c_str(), extent)) {
+      LOG_INFO("Track catalog: indexed %s (%u fixes)", name.c_str(), extent.fixes);
+      changed = true;
+    }
+  }
+  root.close();
+  return changed;
+}
+
+/**
+ * Move single-track files left by older firmware into the library
+ * 
+ * /gps_track.bin becomes track_A and /gps_track_b.bin track_B, each selected
+ * for the channel that used to play it; a raw CSV is compiled first.
+ */
+void migrateLegacyTracks() {
+  const char* legacyPaths[SIM_CHANNEL_COUNT] = { "/gps_track.bin", "/gps_track_b.bin" };
+  
+  if (SPIFFS.exists(TRACK_CSV_PATH) && !SPIFFS.exists(legacyPaths[0]) && compileTrack(legacyPaths[0])) {
+    SPIFFS.remove(TRACK_CSV_PATH);
+  }
+  
+  for (int i = 0; i < SIM_CHANNEL_COUNT; i++) {
+    if (!SPIFFS.exists(legacyPaths[i])) continue;
+    String name = "track_" + String(simChannels[i].name);
+    SPIFFS.remove(trackPath(name.c_str()));
+    if (SPIFFS.rename(legacyPaths[i], trackPath(name.c_str()).c_str())) {
+      strlcpy(simChannels[i].trackName, name.c_str(), sizeof(simChannels[i].trackName));
+      LOG_INFO("Track catalog: %s moved to %s", legacyPaths[i], name.c_str());
+    }
+  }
+}
+
+void loadTrackSelection() {
+  File file = SPIFFS.open(TRACK_SELECTION_PATH, "r");
+  if (!file) return;
+  
+  while (file.available()) {
+    String line = file.readStringUntil('\n');
+    line.trim();
+    int space = line.indexOf(' ');
+    if (space < 0) continue;
+    SimChannel* ch = findChannel(line.substring(0, space));
+    String name = line.substring(space + 1);
+    if (ch && isValidTrackName(name)) {
+      strlcpy(ch->trackName, name.c_str(), sizeof(ch->trackName));
+    }
+  }
+  file.close();
+}
+
+void saveTrackSelection() {
+  File file = SPIFFS.open(TRACK_SELECTION_PATH, "w");
+  if (!file) return;
+  for (const SimChannel& ch : simChannels) {
+    if (ch.trackName[0]) file.printf("%s %s\n", ch.name, ch.trackName);
+  }
+  file.close();
+}
+
+/**
+ * Set up the library at boot and load every channel's selected track
+ * 
+ * A primary with no (or a vanished) selection gets the first track in the library.
+ */
+void initTrackCatalog() {
+  migrateLegacyTracks();
+  SPIFFS.remove(TRACK_UPLOAD_PATH);  // Left by an upload cut short
+  
+  bool indexed = readTrackIndex();
+  if (reconcileTrackCatalog() || !indexed) {
+    saveTrackCatalog();
+  }
+  LOG_INFO("Track catalog: %d tracks", trackCatalogCount);
+  
+  loadTrackSelection();
+  for (SimChannel& ch : simChannels) {
+    if (!findCatalogEntry(ch.trackName)) ch.trackName[0] = '\0';
+  }
+  if (primaryChannel.trackName[0] == '\0' && trackCatalogCount > 0) {
+    strlcpy(primaryChannel.trackName, trackCatalog[0].name, sizeof(primaryChannel.trackName));
+  }
+  saveTrackSelection();
+  
+  for (SimChannel& ch : simChannels) {
+    loadTrack(ch);
+  }
+}
+
+/**
+ * Switch a channel to another library track - no re-parse
+ * 
+ * The new track is opened and cached while the old one keeps playing; the
+ * generator only waits for the pointer swap. A running primary keeps running
+ * from the new track's first fix, with the loop range (in the old track's
+ * time) cleared. A secondary restarts at its start offset.
+ * 
+ * @return false if the track could not be opened; the channel is then idle
+ */
+bool selectTrack(SimChannel& ch, const char* name) {
+  xSemaphoreTake(gpsStateMutex, portMAX_DELAY);
+  strlcpy(ch.trackName, name, sizeof(ch.trackName));
+  if (&ch == &primaryChannel) {
+    loopStartMs = 0;
+    loopEndMs = 0;
+  }
+  xSemaphoreGive(gpsStateMutex);
+  bool loaded = loadTrack(ch);
+  
+  saveTrackSelection();
+  return loaded;
+}
+
+/**
+ * Remove a track from the library, unloading it from any channel playing it
+ * 
+ * Deleting the last track being played stops the simulation.
+ */
+void deleteTrack(TrackCatalogEntry& entry) {
+  xSemaphoreTake(gpsStateMutex, portMAX_DELAY);
+  for (SimChannel& ch : simChannels) {
+    if (strcmp(ch.trackName, entry.name) != 0) continue;
+    unloadTrack(ch);
+    ch.trackName[0] = '\0';
+  }
+  if (!simulationReady()) gpsSimActive = false;
+  xSemaphoreGive(gpsStateMutex);
+  
+  SPIFFS.remove(trackPath(entry.name));
+  LOG_INFO("Track catalog: deleted %s", entry.name);
+  int index = &entry - trackCatalog;
+  memmove(&trackCatalog[index], &trackCatalog[index + 1], (trackCatalogCount - index - 1) * sizeof(TrackCatalogEntry));
+  trackCatalogCount--;
+  saveTrackCatalog();
+  saveTrackSelection();
+}
+
+/**
+ * Move a completed upload into the library under its name
+ * 
+ * A channel playing an older track of that name reloads the new one.
+ * 
+ * @return false if the library is full or the rename failed
+ */
+bool installUploadedTrack(const char* name, const TrackIngestResult& result) {
+  if (!findCatalogEntry(name) && trackCatalogCount >= TRACK_CATALOG_MAX) return false;
+  
+  // Only channels playing the old copy need to let go of it
+  bool playing[SIM_CHANNEL_COUNT] = {};
+  bool anyPlaying = false;
+  for (int i = 0; i < SIM_CHANNEL_COUNT; i++) {
+    playing[i] = strcmp(simChannels[i].trackName, name) == 0;
+    anyPlaying |= playing[i];
+  }
+  if (anyPlaying) {
+    xSemaphoreTake(gpsStateMutex, portMAX_DELAY);
+    for (int i = 0; i < SIM_CHANNEL_COUNT; i++) {
+      if (playing[i]) unloadTrack(simChannels[i]);
+    }
+    xSemaphoreGive(gpsStateMutex);
+  }
+  
+  String path = trackPath(name);
+  SPIFFS.remove(path);
+  bool renamed = SPIFFS.rename(TRACK_UPLOAD_PATH, path.c_str());
+  if (renamed) {
+    addCatalogEntry(name, result);
+    saveTrackCatalog();
+  }
+  
+  for (int i = 0; i < SIM_CHANNEL_COUNT; i++) {
+    if (playing[i]) loadTrack(simChannels[i]);  // Takes gpsStateMutex for the swap only
+  }
+  return renamed;
+}
+
+const size_t CATALOG_JSON_RESERVE = 3584;  // ~190 bytes per track, full library
+
+/**
+ * The library as JSON - GET /tracks, and the select/delete replies
+ * 
+ * @param key Member name inside an object, nullptr for the whole reply
+ */
+void printTrackCatalogJson(JsonPrinter& json, const char* key) {
+  json.beginObject(key).beginArray("tracks");
+  for (int i = 0; i < trackCatalogCount; i++) {
+    const TrackCatalogEntry& entry = trackCatalog[i];
+    char channels[SIM_CHANNEL_COUNT + 1];
+    int count = 0;
+    for (const SimChannel& ch : simChannels) {
+      if (strcmp(ch.trackName, entry.name) == 0) channels[count++] = ch.name[0];
+    }
+    channels[count] = '\0';
+    json.beginObject()
+        .field("name", entry.name)
+        .field("fixes", entry.recordCount)
+        .field("duration_s", entry.durationMs / 1000)
+        .field("bytes", entry.fileBytes)
+        .beginObject("bounds")
+        .field("min_lat", entry.minLatitudeE7 / 1e7, 6)
+        .field("min_lon", entry.minLongitudeE7 / 1e7, 6)
+        .field("max_lat", entry.maxLatitudeE7 / 1e7, 6)
+        .field("max_lon", entry.maxLongitudeE7 / 1e7, 6)
+        .endObject()
+        .field("channels", channels)
+        .endObject();
+  }
+  json.endArray()
+      .field("max_tracks", TRACK_CATALOG_MAX)
+      .field("flash_free_bytes", (uint32_t)(SPIFFS.totalBytes() - SPIFFS.usedBytes()))
+      .endObject();
+}
+
+/**
+ * Reply {"success":true,"catalog":{...}} after a library change
+ */
+void sendTrackCatalogChanged(AsyncWebServerRequest* request) {
+  AsyncResponseStream* response = request->beginResponseStream("application/json", CATALOG_JSON_RESERVE);
+  JsonPrinter json(*response);
+  json.beginObject().field("success", true);
+  printTrackCatalogJson(json, "catalog");
+  json.endObject();
+  request->send(response);
+}
+
+// =============================================================================
+// COMMAND RECEIVER (HOST CONFIGURATION ON GPIO 33)
+// =============================================================================
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: Receive-path Command Parser
+ * 
+ * WHAT: Reads configuration commands that the host sends to the "GPS module"
+ *       and applies them live - fix rate, baud rate, protocols and messages
+ * WHY: Firmware under test often negotiates at boot (e.g. CFG-RATE to 5 Hz,
+ *      CFG-PRT to 115200) and waits for an ACK before carrying on; a TX-only
+ *      simulator leaves it hanging forever
+ * HOW: A byte-at-a-time state machine, fed from whatever is in the UART RX
+ *      buffer on each generator task pass, so it never blocks. 0xB5 starts a
+ *      UBX frame (sync, class, id, length, payload, Fletcher checksum) and '$'
+ *      starts an NMEA command ($PUBX / $PMTK) terminated by CR/LF
+ * GOTCHAS: A CFG-PRT baud change must be ACKed at the OLD baud rate - the host
+ *          switches only after it sees the ACK - so the switch is queued behind
+ *          the ACK (see setBaudRate()). Commands apply to the whole simulator,
+ *          so a CFG-MSG from the GPIO host also affects USB output
+ * 
+ * Example: B5 62 06 08 06 00 C8 00 01 00 01 00 DE 6A (CFG-RATE 200ms = 5 Hz)
+ *          → fix rate becomes 5 Hz, reply B5 62 05 01 02 00 06 08 16 3F (ACK-ACK)
+ */
+const uint8_t UBX_CLASS_ACK = 0x05;
+const uint8_t UBX_ACK_NAK = 0x00;
+const uint8_t UBX_ACK_ACK = 0x01;
+const uint8_t UBX_CLASS_CFG = 0x06;
+const uint8_t UBX_CFG_PRT = 0x00;
+const uint8_t UBX_CFG_MSG = 0x01;
+const uint8_t UBX_CFG_RATE = 0x08;
+const uint8_t UBX_CFG_CFG = 0x09;
+
+// CFG-PRT port identifiers and protocol mask bits
+const uint8_t UBX_PORT_UART1 = 1;
+const uint8_t UBX_PORT_USB = 3;
+const uint16_t UBX_PROTO_UBX = 0x0001;
+const uint16_t UBX_PROTO_NMEA = 0x0002;
+
+const int COMMAND_MAX_PAYLOAD = 64;      // Largest config frame we accept (CFG-PRT is 20)
+const int COMMAND_MAX_SENTENCE = 83;     // NMEA 0183 limit incl. '$', without CR/LF
+
+uint32_t hostCommandsApplied = 0;        // Commands accepted (ACK or applied)
+uint32_t hostCommandsRejected = 0;       // NAKs, bad checksums and unknown commands
+
+class CommandReceiver {
+public:
+  enum Result { NONE, UBX_FRAME, NMEA_SENTENCE };
+  
+  /**
+   * Consume one received byte
+   * 
+   * @return UBX_FRAME or NMEA_SENTENCE when a complete, checksum-valid
+   *         command is ready; the accessors below then describe it
+   */
+  Result feed(uint8_t byte) {
+    switch (state) {
+      case IDLE:
+        if (byte == UBX_SYNC_1) {
+          state = UBX_SYNC;
+        } else if (byte == '$') {
+          sentenceLength = 0;
+          sentence[sentenceLength++] = '$';
+          state = NMEA_TEXT;
+        }
+        return NONE;
+        
+      case UBX_SYNC:
+        state = (byte == UBX_SYNC_2) ? UBX_HEADER : IDLE;
+        headerCount = 0;
+        ckA = ckB = 0;
+        return NONE;
+        
+      case UBX_HEADER:
+        checksum(byte);
+        header[headerCount++] = byte;
+        if (headerCount == 4) {
+          payloadLength = header[2] | (header[3] << 8);
+          payloadCount = 0;
+          if (payloadLength > COMMAND_MAX_PAYLOAD) {
+            hostCommandsRejected++;          // Not a config frame - resync
+            state = IDLE;
+          } else {
+            state = payloadLength ? UBX_PAYLOAD : UBX_CK_A;
+          }
+        }
+        return NONE;
+        
+      case UBX_PAYLOAD:
+        checksum(byte);
+        payload[payloadCount++] = byte;
+        if (payloadCount == payloadLength) state = UBX_CK_A;
+        return NONE;
+        
+      case UBX_CK_A:
+        state = (byte == ckA) ? UBX_CK_B : IDLE;
+        if (state == IDLE) hostCommandsRejected++;
+        return NONE;
+        
+      case UBX_CK_B:
+        state = IDLE;
+        if (byte != ckB) {
+          hostCommandsRejected++;
+          return NONE;
+        }
+        return UBX_FRAME;
+        
+      case NMEA_TEXT:
+        if (byte == '\r') return NONE;
+        if (byte == '\n') {
+          state = IDLE;
+          sentence[sentenceLength] = '\0';
+          if (!verifySentence()) {
+            hostCommandsRejected++;
+            return NONE;
+          }
+          return NMEA_SENTENCE;
+        }
+        if (sentenceLength >= COMMAND_MAX_SENTENCE) {
+          hostCommandsRejected++;            // Overlong - discard
+          state = IDLE;
+          return NONE;
+        }
+        sentence[sentenceLength++] = byte;
+        return NONE;
+    }
+    return NONE;
+  }
+  
+  uint8_t messageClass() const { return header[0]; }
+  uint8_t messageId() const { return header[1]; }
+  uint16_t length() const { return payloadLength; }
+  const uint8_t* data() const { return payload; }
   
-  String sentence = "$GNGGA," + gps.utc_time + ",";
+  // Sentence with '$' and "*HH" removed, split in place by the caller
+  char* sentenceBody() { return sentence + 1; }
   
-  // Latitude
-  float lat = abs(gps.latitude);
-  int latDeg = (int)lat;
-  float latMin = (lat - latDeg) * 60;
-  sentence += String(latDeg, 0) + String(latMin, 5) + ",";
-  sentence += gps.latitude >= 0 ? "N," : "S,";
+private:
+  enum State { IDLE, UBX_SYNC, UBX_HEADER, UBX_PAYLOAD, UBX_CK_A, UBX_CK_B, NMEA_TEXT };
   
-  // Longitude
-  float lng = abs(gps.longitude);
-  int lngDeg = (int)lng;
-  float lngMin = (lng - lngDeg) * 60;
-  sentence += String(lngDeg, 0) + String(lngMin, 5) + ",";
-  sentence += gps.longitude >= 0 ? "E," : "W,";
+  void checksum(uint8_t byte) {
+    ckA += byte;
+    ckB += ckA;
+  }
+  
+  /**
+   * Check and strip the "*HH" suffix of a received sentence
+   */
+  bool verifySentence() {
+    char* star = strrchr(sentence, '*');
+    if (!star || strlen(star) < 3) return false;
+    uint8_t expected = (uint8_t)strtoul(star + 1, nullptr, 16);
+    *star = '\0';
+    return calculateChecksum(sentence) == expected;
+  }
   
-  sentence += "1,";  // Fix quality
-  sentence += String(gps.sats, 0) + ",";  // Number of satellites
-  sentence += String(gps.hdop, 2) + ",";  // HDOP
-  sentence += "56.3,M,46.9,M,,";  // Altitude and geoidal separation
+  State state = IDLE;
+  uint8_t header[4];                      // Class, id, length (little-endian)
+  int headerCount = 0;
+  uint8_t payload[COMMAND_MAX_PAYLOAD];
+  uint16_t payloadLength = 0;
+  uint16_t payloadCount = 0;
+  uint8_t ckA = 0, ckB = 0;
+  char sentence[COMMAND_MAX_SENTENCE + 1];
+  int sentenceLength = 0;
+};
+
+CommandReceiver commandReceiver;
+
+// Replies go back to the host on the port the command came in on
+void replyUBX(UBXFrameWriter& frame) {
+  frame.finish();
+  queueOutput(frame.data(), frame.length(), CHANNEL_GPIO, false);
+}
+
+void replyNMEA(NMEASentenceWriter& sentence) {
+  sentence.finish();
+  if (!sentence.overflowed()) {
+    queueOutput(sentence.text(), sentence.length(), CHANNEL_GPIO, true);
+  }
+}
+
+void sendUBXAck(uint8_t messageClass, uint8_t messageId, bool accepted) {
+  UBXFrameWriter frame;
+  frame.begin(UBX_CLASS_ACK, accepted ? UBX_ACK_ACK : UBX_ACK_NAK);
+  frame.u1(messageClass);
+  frame.u1(messageId);
+  replyUBX(frame);
   
-  String fullSentence = createNMEASentence(sentence);
-  outputNMEASentence(fullSentence);
+  if (accepted) {
+    hostCommandsApplied++;
+  } else {
+    hostCommandsRejected++;
+  }
 }
 
-void sendGNGSA() {
-  String sentence1 = "$GNGSA,A,3,01,02,04,31,,,,,,,,,6.27,4.89,3.92,1";
-  String sentence2 = "$GNGSA,A,3,,,,,,,,,,,,,6.27,4.89,3.92,4";
-  
-  outputNMEASentence(createNMEASentence(sentence1));
-  delay(50);
-  outputNMEASentence(createNMEASentence(sentence2));
+/**
+ * Apply a host-requested fix rate (caller holds gpsStateMutex)
+ */
+void applyHostFixRate(uint8_t hz) {
+  if (hz == gpsFixRateHz) return;
+  gpsFixRateHz = hz;  // The epoch clock re-aligns at the next boundary
+  setStatus("Host set " + String(hz) + " Hz");
+  LOG_INFO("Command receiver: fix rate %u Hz", hz);
 }
 
-void sendGPGSV() {
-  String sentence1 = "$GPGSV,2,1,05,01,57,120,12,02,28,127,27,04,43,173,23,17,,,21";
-  String sentence2 = "$GPGSV,2,2,05,31,17,085,30";
+/**
+ * Apply a host-requested port protocol and (for UART1) baud rate
+ * 
+ * @return false if the request can't be honoured - nothing is changed
+ */
+bool applyHostPortConfig(uint8_t port, uint16_t outProtoMask, uint32_t baud) {
+  OutputProtocol protocol;
+  switch (outProtoMask & (UBX_PROTO_UBX | UBX_PROTO_NMEA)) {
+    case UBX_PROTO_UBX:                  protocol = PROTOCOL_UBX; break;
+    case UBX_PROTO_NMEA:                 protocol = PROTOCOL_NMEA; break;
+    case UBX_PROTO_UBX | UBX_PROTO_NMEA: protocol = PROTOCOL_BOTH; break;
+    default: return false;               // A silent port would look like a dead simulator
+  }
   
-  outputNMEASentence(createNMEASentence(sentence1));
-  delay(50);
-  outputNMEASentence(createNMEASentence(sentence2));
+  if (port == UBX_PORT_UART1) {
+    if (!isSupportedBaudRate(baud)) return false;
+    gpioProtocol = protocol;
+    if (baud != gpsBaudRate) {
+      setStatus("Host set " + String(baud) + " baud");
+      LOG_INFO("Command receiver: UART1 %u baud", baud);
+    }
+  } else if (port == UBX_PORT_USB) {
+    usbProtocol = protocol;
+  } else {
+    return false;
+  }
+  return true;
 }
 
-void sendBDGSV() {
-  String sentence = "$BDGSV,1,1,00";
-  outputNMEASentence(createNMEASentence(sentence));
+uint16_t outProtoMaskFor(OutputProtocol protocol) {
+  return ((protocol & PROTOCOL_UBX) ? UBX_PROTO_UBX : 0) |
+         ((protocol & PROTOCOL_NMEA) ? UBX_PROTO_NMEA : 0);
 }
 
-void sendGNTXT() {
-  String sentence = "$GNTXT,1,1,01,ANTENNA OK";
-  outputNMEASentence(createNMEASentence(sentence));
+void handleCfgRate(const uint8_t* payload, uint16_t length) {
+  if (length == 0) {
+    // Poll: report the current rate, then ACK
+    UBXFrameWriter frame;
+    frame.begin(UBX_CLASS_CFG, UBX_CFG_RATE);
+    frame.u2(gpsEpochMs());              // measRate, ms
+    frame.u2(1);                         // navRate, cycles
+    frame.u2(1);                         // timeRef = GPS time
+    replyUBX(frame);
+    sendUBXAck(UBX_CLASS_CFG, UBX_CFG_RATE, true);
+    return;
+  }
+  
+  uint16_t measRateMs = payload[0] | (payload[1] << 8);
+  bool valid = length == 6 && measRateMs > 0 && 1000 % measRateMs == 0 &&
+               isSupportedFixRate(1000 / measRateMs);
+  sendUBXAck(UBX_CLASS_CFG, UBX_CFG_RATE, valid);
+  if (valid) {
+    applyHostFixRate(1000 / measRateMs);
+  }
 }
 
-void parseCSVLine(String line, GPSData& gps) {
-  Serial.println("parseCSVLine(): entered");
-  int fieldIndex = 0;
-  int startPos = 0;
-  int commaPos = 0;
+void handleCfgPrt(const uint8_t* payload, uint16_t length) {
+  if (length <= 1) {
+    // Poll: current port (UART1) or the one named in the payload
+    uint8_t port = length ? payload[0] : UBX_PORT_UART1;
+    if (port != UBX_PORT_UART1 && port != UBX_PORT_USB) {
+      sendUBXAck(UBX_CLASS_CFG, UBX_CFG_PRT, false);
+      return;
+    }
+    bool uart = port == UBX_PORT_UART1;
+    UBXFrameWriter frame;
+    frame.begin(UBX_CLASS_CFG, UBX_CFG_PRT);
+    frame.u1(port);                                         // portID
+    frame.reserved(1);
+    frame.u2(0);                                            // txReady (disabled)
+    frame.u4(uart ? 0x000008C0 : 0);                        // mode: 8N1
+    frame.u4(uart ? gpsBaudRate : 0);                       // baudRate
+    frame.u2(UBX_PROTO_UBX | UBX_PROTO_NMEA);               // inProtoMask
+    frame.u2(outProtoMaskFor(uart ? gpioProtocol : usbProtocol)); // outProtoMask
+    frame.u2(0);                                            // flags
+    frame.reserved(2);
+    replyUBX(frame);
+    sendUBXAck(UBX_CLASS_CFG, UBX_CFG_PRT, true);
+    return;
+  }
   
-  gps.valid = false;
+  if (length != 20) {
+    sendUBXAck(UBX_CLASS_CFG, UBX_CFG_PRT, false);
+    return;
+  }
+  uint8_t port = payload[0];
+  uint32_t baud = payload[8] | (payload[9] << 8) | ((uint32_t)payload[10] << 16) | ((uint32_t)payload[11] << 24);
+  uint16_t outProtoMask = payload[14] | (payload[15] << 8);
   
-  while ((commaPos = line.indexOf(',', startPos)) != -1) {
-    String field = line.substring(startPos, commaPos);
-    
-    switch (fieldIndex) {
-      case 3: // UTC_time
-        gps.utc_time = field;
-        break;
-      case 6: // coordinates
-        if (field.length() > 4) {
-          int bracketStart = field.indexOf('[');
-          int commaIndex = field.indexOf(',', bracketStart);
-          int bracketEnd = field.indexOf(']', commaIndex);
-          
-          if (bracketStart != -1 && commaIndex != -1 && bracketEnd != -1) {
-            gps.latitude = field.substring(bracketStart + 1, commaIndex).toFloat();
-            gps.longitude = field.substring(commaIndex + 2, bracketEnd).toFloat();
-            gps.valid = true;
-          }
-        }
-        break;
-      case 16: // gps_course
-        gps.gps_course = field.toFloat();
-        break;
-      case 17: // gps_speed_knots
-        gps.gps_speed_knots = field.toFloat();
-        break;
-      case 18: // hdop
-        gps.hdop = field.toFloat();
-        break;
-      case 60: // sats
-        gps.sats = field.toInt();
-        if (gps.sats == 0) gps.sats = 4; // Default to 4 satellites
-        break;
-    }
-    
-    startPos = commaPos + 1;
-    fieldIndex++;
+  bool valid = applyHostPortConfig(port, outProtoMask, baud);
+  sendUBXAck(UBX_CLASS_CFG, UBX_CFG_PRT, valid);
+  if (valid && port == UBX_PORT_UART1) {
+    setBaudRate(baud, false);            // Queued behind the ACK just sent
   }
 }
 
-bool loadCSV() {
-  if (!SPIFFS.exists("/gps_track.csv")) {
-    statusMsg = "No CSV file found";
-    Serial.printf("loadCSV(): %s",statusMsg.c_str());
-    return false;
+void handleCfgMsg(const uint8_t* payload, uint16_t length) {
+  if (length < 2) {
+    sendUBXAck(UBX_CLASS_CFG, UBX_CFG_MSG, false);
+    return;
+  }
+  OutputMessage message = findOutputMessage(payload[0], payload[1]);
+  if (message == OUTPUT_MESSAGE_COUNT) {
+    sendUBXAck(UBX_CLASS_CFG, UBX_CFG_MSG, false);
+    return;
   }
   
-  csvFile = SPIFFS.open("/gps_track.csv", "r");
-  if (!csvFile) {
-    statusMsg = "Failed to open CSV";
-    Serial.printf("loadCSV(): %s",statusMsg.c_str());
-    return false;
+  if (length == 2) {
+    // Poll: rate per port (I2C, UART1, UART2, USB, SPI, reserved)
+    uint8_t rate = messageRate(message);
+    UBXFrameWriter frame;
+    frame.begin(UBX_CLASS_CFG, UBX_CFG_MSG);
+    frame.u1(payload[0]);
+    frame.u1(payload[1]);
+    for (int port = 0; port < 6; port++) {
+      frame.u1(rate);
+    }
+    replyUBX(frame);
+    sendUBXAck(UBX_CLASS_CFG, UBX_CFG_MSG, true);
+    return;
   }
   
-  // Skip header line
-  csvFile.readStringUntil('\n');
-  currentLine = 0;
-  csvLoaded = true;
-  statusMsg = "CSV loaded successfully";
-  Serial.printf("loadCSV(): %s",statusMsg.c_str());
-  return true;
+  // 3 bytes: rate on the current port; 8 bytes: rate per port, UART1 is [1]
+  if (length != 3 && length != 8) {
+    sendUBXAck(UBX_CLASS_CFG, UBX_CFG_MSG, false);
+    return;
+  }
+  uint8_t rate = (length == 3) ? payload[2] : payload[3];
+  setMessageRate(message, rate);
+  sendUBXAck(UBX_CLASS_CFG, UBX_CFG_MSG, true);
 }
 
-GPSData getNextGPSData() {
-  Serial.println("getNextGPSData(): entered");
-  GPSData gps;
-  if (!csvFile || !csvFile.available()) {
-    Serial.println("getNextGPSData(): csv file not available");
-    return gps; // Invalid GPS data
+/**
+ * Dispatch a complete, checksum-valid UBX frame
+ */
+void handleUBXCommand(uint8_t messageClass, uint8_t messageId, const uint8_t* payload, uint16_t length) {
+  if (messageClass != UBX_CLASS_CFG) {
+    hostCommandsRejected++;              // Only configuration is understood
+    return;
   }
   
-  String line = csvFile.readStringUntil('\n');
-  if (line.length() > 0) {
-    Serial.printf("getNextGPSData(): parse next line %i\n",currentLine);
-    parseCSVLine(line, gps);
-    currentLine++;
+  switch (messageId) {
+    case UBX_CFG_PRT:  handleCfgPrt(payload, length); break;
+    case UBX_CFG_MSG:  handleCfgMsg(payload, length); break;
+    case UBX_CFG_RATE: handleCfgRate(payload, length); break;
+    case UBX_CFG_CFG:
+      // Save/load/clear - accepted so start-up sequences complete, but host
+      // settings are deliberately not persisted
+      sendUBXAck(UBX_CLASS_CFG, UBX_CFG_CFG, true);
+      break;
+    default:
+      sendUBXAck(messageClass, messageId, false);
+      break;
+  }
+}
+
+/**
+ * Map an NMEA sentence type ("GGA") to its enable flag
+ */
+OutputMessage findNMEAMessage(const char* type) {
+  for (int i = 0; i < OUTPUT_MESSAGE_COUNT; i++) {
+    if (outputMessages[i].ubxClass == 0xF0 && strcmp(outputMessages[i].name, type) == 0) {
+      return (OutputMessage)i;
+    }
   }
-  else
-  {
-    Serial.println("getNextGPSData(): line length 0");
+  return OUTPUT_MESSAGE_COUNT;
+}
+
+/**
+ * $PUBX,00 reply - u-blox proprietary position report
+ */
+void sendPUBXPosition() {
+  const GPSData& gps = primaryChannel.epochGPS;
+  NMEASentenceWriter sentence;
+  sentence.begin("PUBX");
+  sentence.fieldUInt(0, 2);
+  if (gps.valid) {
+    sentence.field(gps.utc_time);
+    sentence.fieldCoordinate(gps.latitudeE7, 2, 'N', 'S');
+    sentence.fieldCoordinate(gps.longitudeE7, 3, 'E', 'W');
+    sentence.fieldFixed(GPS_ALTITUDE_MSL_MM + GEOID_SEPARATION_MM, 3);  // altRef, m
+    sentence.field("G3");                                               // navStat
+    sentence.fieldFixed(horizontalAccuracyMm(gps) / 10, 2);             // hAcc, m
+    sentence.fieldFixed(verticalAccuracyMm(gps) / 10, 2);               // vAcc, m
+    sentence.fieldFixed(lroundf(gps.gps_speed_knots * 1852.0f), 3);     // SOG, km/h
+    sentence.fieldFixed(lroundf(gps.gps_course * 100), 2);              // COG, deg
+    sentence.fields("0.000,");                                          // vVel, ageC
+    sentence.fieldFixed(lroundf(gps.hdop * 100), 2);                    // HDOP
+    sentence.fieldFixed(lroundf(gps.hdop * 150), 2);                    // VDOP
+    sentence.fieldFixed(lroundf(gps.hdop * 80), 2);                     // TDOP
+    sentence.fieldUInt(constellationView.usedCount);                    // numSvs
+    sentence.fields("0,0");                                             // reserved, DR
+  } else {
+    sentence.fields("000000.00,0000.00000,N,00000.00000,E,0.000,NF,0,0,0.000,0.00,0.000,,99.99,99.99,99.99,0,0,0");
   }
+  replyNMEA(sentence);
+}
+
+void sendPMTKAck(int command, bool accepted) {
+  NMEASentenceWriter sentence;
+  sentence.begin("PMTK001");
+  sentence.fieldUInt(command);
+  sentence.fieldUInt(accepted ? 3 : 1);  // 3 = succeeded, 1 = unsupported
+  replyNMEA(sentence);
   
-  return gps;
+  if (accepted) {
+    hostCommandsApplied++;
+  } else {
+    hostCommandsRejected++;
+  }
 }
 
-void simulateGPS() {
-  if (!gpsSimActive || !csvLoaded) return;
-  Serial.println("SimulateGPS(): entered");
-  unsigned long now = millis();
-  if (now - lastGpsOutput >= 1000) { // 1 second interval
-    Serial.println("SimulateGPS(): send next simulated message");
-    // Get current time and format as HHMMSS.00
-    // Use NTP time if available and synchronized, otherwise use system time
-    unsigned long epochTime;
-    if (ntpSyncAvailable && currentWiFiMode == WIFI_CLIENT_MODE) {
-      // In client mode with NTP available, get fresh NTP time periodically
-      static unsigned long lastNtpRefresh = 0;
-      if (millis() - lastNtpRefresh > 30000) {  // Refresh every 30 seconds
-        Serial.println("SimulateGPS(): refreshing Time by NTP (30 second cycle)");
-        timeClient.update();
-        lastNtpRefresh = millis();
+/**
+ * Dispatch a checksum-valid $PUBX or $PMTK command
+ * 
+ * @param body Sentence without '$' and "*HH", split into fields in place
+ */
+void handleNMEACommand(char* body) {
+  const int MAX_FIELDS = 24;
+  char* fields[MAX_FIELDS];
+  int count = 0;
+  for (char* p = body; count < MAX_FIELDS; ) {
+    fields[count++] = p;
+    p = strchr(p, ',');
+    if (!p) break;
+    *p++ = '\0';
+  }
+  
+  if (strcmp(fields[0], "PUBX") == 0 && count >= 2) {
+    int message = atoi(fields[1]);
+    if (message == 0) {
+      sendPUBXPosition();
+      hostCommandsApplied++;
+    } else if (message == 40 && count >= 5) {
+      // $PUBX,40,msgId,rddc,rus1,rus2,rusb,rspi - rus1 is our UART
+      OutputMessage target = findNMEAMessage(fields[2]);
+      if (target == OUTPUT_MESSAGE_COUNT) {
+        hostCommandsRejected++;
+        return;
       }
-      epochTime = timeClient.getEpochTime();
-    } else if (ntpSyncCompleted) {
-      // Use last known NTP time + elapsed time (more accurate than system clock)
-      unsigned long elapsedSinceSync = millis() - lastSuccessfulNtpSync;
-      epochTime = (lastSuccessfulNtpSync / 1000) + 946684800UL + (elapsedSinceSync / 1000);
-    } else {
-      // Fallback to system time if no NTP sync has occurred
-      epochTime = millis() / 1000 + 946684800UL;  // Use system millis as fallback
-    }
-    
-    int hours = (epochTime % 86400L) / 3600;
-    int minutes = (epochTime % 3600) / 60;
-    int seconds = epochTime % 60;
-    
-    char timeStr[12];
-    sprintf(timeStr, "%02d%02d%02d.00", hours, minutes, seconds);
-    currentGPS.utc_time = String(timeStr);
-    
-    if (currentGPS.valid) {
-      Serial.println("SimulateGPS(): current gps is valid - send");
-      // Send NMEA sentences in proper order
-      sendGNRMC(currentGPS);
-      delay(50);
-      sendGNGGA(currentGPS);
-      delay(50);
-      sendGNGSA();
-      delay(50);
-      sendGPGSV();
-      delay(50);
-      sendBDGSV();
-      delay(50);
-      sendGNTXT();
-      
-      // Load next GPS data point
-      currentGPS = getNextGPSData();
-      if (!currentGPS.valid) {
-        Serial.println("SimulateGPS(): end of file reached");
-        // Restart from beginning if we reach end of file
-        csvFile.close();
-        loadCSV();
-        currentGPS = getNextGPSData();
+      setMessageRate(target, constrain(atoi(fields[4]), 0, MAX_MESSAGE_DIVISOR));
+      hostCommandsApplied++;
+    } else if (message == 41 && count >= 6) {
+      // $PUBX,41,portId,inProto,outProto,baudrate,autobauding - masks are hex
+      uint8_t port = atoi(fields[2]);
+      uint16_t outProtoMask = strtoul(fields[4], nullptr, 16);
+      uint32_t baud = strtoul(fields[5], nullptr, 10);
+      if (!applyHostPortConfig(port, outProtoMask, baud)) {
+        hostCommandsRejected++;
+        return;
       }
-      else {
-        Serial.println("SimulateGPS(): got next gps data");
+      if (port == UBX_PORT_UART1) {
+        setBaudRate(baud, false);
       }
+      hostCommandsApplied++;
+    } else {
+      hostCommandsRejected++;
     }
-    else {
-      Serial.println("SimulateGPS(): current gps is invalid - skip");
+    return;
+  }
+  
+  // MediaTek commands, for host firmware written against PMTK modules
+  if (strncmp(fields[0], "PMTK", 4) == 0) {
+    int command = atoi(fields[0] + 4);
+    if (command == 220 && count >= 2) {
+      // $PMTK220,intervalMs - fix interval
+      int intervalMs = atoi(fields[1]);
+      bool valid = intervalMs > 0 && 1000 % intervalMs == 0 && isSupportedFixRate(1000 / intervalMs);
+      sendPMTKAck(command, valid);
+      if (valid) applyHostFixRate(1000 / intervalMs);
+    } else if (command == 251 && count >= 2) {
+      // $PMTK251,baud
+      uint32_t baud = strtoul(fields[1], nullptr, 10);
+      bool valid = isSupportedBaudRate(baud);
+      sendPMTKAck(command, valid);
+      if (valid) setBaudRate(baud, false);
+    } else if (command == 314 && count >= 7) {
+      // $PMTK314,GLL,RMC,VTG,GGA,GSA,GSV,... - per-sentence output rates
+      setMessageRate(MSG_RMC, constrain(atoi(fields[2]), 0, 5));
+      setMessageRate(MSG_GGA, constrain(atoi(fields[4]), 0, 5));
+      setMessageRate(MSG_GSA, constrain(atoi(fields[5]), 0, 5));
+      setMessageRate(MSG_GSV, constrain(atoi(fields[6]), 0, 5));
+      sendPMTKAck(command, true);
+    } else {
+      sendPMTKAck(command, false);
     }
-    
-    lastGpsOutput = now;
+    return;
+  }
+  
+  hostCommandsRejected++;
+}
+
+/**
+ * Parse whatever the host has sent since the last pass (caller holds gpsStateMutex)
+ * 
+ * At most 64 bytes per call so a flood of input can't starve the burst scheduler.
+ */
+void serviceCommandReceiver() {
+  uint8_t received[64];
+  int count = uart_read_bytes(GPS_UART, received, sizeof(received), 0);  // Never blocks
+  for (int i = 0; i < count; i++) {
+    CommandReceiver::Result result = commandReceiver.feed(received[i]);
+    if (result == CommandReceiver::UBX_FRAME) {
+      handleUBXCommand(commandReceiver.messageClass(), commandReceiver.messageId(),
+                       commandReceiver.data(), commandReceiver.length());
+    } else if (result == CommandReceiver::NMEA_SENTENCE) {
+      handleNMEACommand(commandReceiver.sentenceBody());
+    }
+  }
+}
+
+const size_t METRICS_TEXT_RESERVE = STAGE_COUNT * 240 + 640;  // Room for every line; never regrows
+
+// One "name value" line of /metrics
+template <typename T>
+void printMetric(Print& out, const char* name, T value) {
+  out.print(name);
+  out.print(' ');
+  out.print(value);
+  out.print('\n');
+}
+
+/**
+ * Print the hot-path metrics in Prometheus-style text (for GET /metrics)
+ * 
+ * Histograms are in CPU cycles - cpu_mhz converts them to time. Only plain
+ * reads of the counters, so polling it never holds up the generator.
+ */
+void printMetrics(Print& out) {
+  printMetric(out, "cpu_mhz", ESP.getCpuFreqMHz());
+  const char* stats[] = {"min", "mean", "p99", "max"};
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    const CycleHistogram& histogram = stageCycles[i];
+    uint32_t values[] = {histogram.lowest(), histogram.mean(), histogram.percentile(990), histogram.highest()};
+    for (int j = 0; j < 4; j++) {
+      out.printf("stage_cycles{stage=\"%s\",stat=\"%s\"} %lu\n", STAGE_NAMES[i], stats[j], (unsigned long)values[j]);
+    }
+    out.printf("stage_calls{stage=\"%s\"} %lu\n", STAGE_NAMES[i], (unsigned long)histogram.count());
   }
+  printMetric(out, "bytes_sent{channel=\"gpio\"}", gpioBytesSent);
+  printMetric(out, "bytes_sent{channel=\"usb\"}", usbBytesSent);
+  printMetric(out, "bytes_sent{channel=\"aux\"}", auxBytesSent);
+  printMetric(out, "bytes_sent{channel=\"net\"}", netBytesSent);
+  printMetric(out, "net_clients", netClientCount);
+  printMetric(out, "net_frames_dropped{reason=\"sink_behind\"}", netFramesDropped);
+  printMetric(out, "net_frames_dropped{reason=\"client_backlog\"}", netClientDrops);
+  printMetric(out, "epochs", burstEpochCount);
+  printMetric(out, "late_epochs", lateEpochs);
+  printMetric(out, "burst_start_jitter_max_us", burstStartJitter.maxUs);
+  printMetric(out, "dropped_sentences{reason=\"ring_full\"}", outputRing.droppedSentences);
+  printMetric(out, "dropped_sentences{reason=\"budget\"}", optionalSentencesDropped);
+  printMetric(out, "heap_free_bytes", ESP.getFreeHeap());
+  printMetric(out, "heap_min_free_bytes", ESP.getMinFreeHeap());
+  printMetric(out, "heap_largest_free_block_bytes", heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
 }
 
+// =============================================================================
+// WEB CONTROL PAGE
+// =============================================================================
+
+/**
+ * 🎯 EDUCATIONAL BLOCK: A Static Page Over a JSON API
+ * 
+ * WHAT: The control page is one constant string in flash; everything that
+ *       changes (status, settings, channel panels) is filled in by its script
+ *       from GET /status
+ * WHY: Building the page in the request callback took ~150 String appends and
+ *      a ~12 KB heap buffer on every load, while the generator was running
+ * HOW: PROGMEM keeps the page out of RAM and send_P() streams it straight out
+ *      of flash. The script builds the message-rate inputs and one panel per
+ *      secondary channel from the first /status reply, then polls /status
+ *      every 5 s for the read-only text only - form fields are never
+ *      overwritten while being edited
+ * GOTCHAS: Anything the page needs to know about the firmware (limits, port,
+ *          channel names) must be in /status - the page itself cannot change
+ *          at runtime. Gzipping it into SPIFFS would save flash, but a file
+ *          system upload would then be a second thing to keep in step with
+ *          every firmware update
+ */
+const char INDEX_HTML[] PROGMEM = R"rawliteral(<!DOCTYPE html><html><head><title>GPS Simulator Control</title>
+<meta name='viewport' content='width=device-width, initial-scale=1'>
+<style>body{font-family:Arial,sans-serif;margin:20px}.status-panel{background:#f0f0f0;padding:15px;border-radius:5px;margin-bottom:20px}
+.control-section{margin-bottom:25px}.button{background:#007cba;color:white;padding:10px 15px;text-decoration:none;border-radius:5px;margin:5px;display:inline-block}
+.button:hover{background:#005a87}.danger{background:#d32f2f}.danger:hover{background:#b71c1c}.success{background:#388e3c}.success:hover{background:#2e7d32}
+select,input[type='file']{padding:8px;margin:5px}</style></head><body>
+<h1>GPS Simulator Control Panel</h1>
+
+<div class='status-panel'><h3>System Status</h3>
+<p><strong>WiFi Mode:</strong> <span id='st-wifi'>Loading...</span></p>
+<p><strong>Network:</strong> <span id='st-net'></span></p>
+<p><strong>NTP Status:</strong> <span id='st-ntp'></span></p>
+<p><strong>Time Sync:</strong> <span id='st-sync'></span></p>
+<p><strong>Track:</strong> <span id='st-track'></span></p>
+<p><strong>GPS Output:</strong> <span id='st-gps'></span></p></div>
+
+<div class='control-section'><h3>Output Configuration</h3>
+<p><strong>Current Output:</strong> <span id='output-status'>Loading...</span></p>
+<div style='margin:10px 0'>
+<label><input type='checkbox' id='gpio-output'> GPIO Pins 32/33 (Hardware UART)</label>
+<select id='gpio-protocol'><option value='nmea'>NMEA</option><option value='ubx'>UBX</option><option value='both'>NMEA+UBX</option></select><br>
+<label><input type='checkbox' id='usb-output'> USB Serial Port</label>
+<select id='usb-protocol'><option value='nmea'>NMEA</option><option value='ubx'>UBX</option><option value='both'>NMEA+UBX</option></select><br>
+<label>Network stream (WebSocket /ws, TCP port <span id='net-port'></span>)</label>
+<select id='net-protocol'><option value='nmea'>NMEA</option><option value='ubx'>UBX</option><option value='both'>NMEA+UBX</option></select>
+<span id='net-clients'></span><br>
+<label>Fix rate <select id='fix-rate'><option value='1'>1 Hz</option><option value='2'>2 Hz</option>
+<option value='5'>5 Hz</option><option value='10'>10 Hz</option></select></label><br>
+<label>GPIO baud <select id='uart-baud'><option>4800</option><option>9600</option><option>19200</option>
+<option>38400</option><option>57600</option><option>115200</option></select></label>
+<span id='budget-status'></span><br>
+<label><input type='checkbox' id='burst-spacing'> Space sentences 50ms apart (instead of one write per burst)</label><br>
+<label><input type='checkbox' id='pps-output'> PPS timepulse on GPIO 26</label><br>
+<small>Send every N epochs (0 = off):</small><br>
+<span id='msg-rates'></span>
+</div>
+<button onclick='updateOutputConfig()' class='button'>Update Output Configuration</button>
+<div id='output-message' style='margin-top:10px'></div>
+<p><small><strong>GPIO Output:</strong> Hardware connection for GPS modules/analyzers<br>
+<strong>USB Output:</strong> Direct computer connection<br>
+<em>Note: At least one output must be enabled</em></small></p></div>
+
+<div class='control-section'><h3>GPS Simulation Control</h3>
+<a href='/start' class='button success'>Start GPS Simulation</a>
+<a href='/stop' class='button danger'>Stop GPS Simulation</a>
+<p><small>NMEA output via configured channels, positions interpolated above 1 Hz</small></p>
+<div style='margin:10px 0'>
+<label>Speed <input type='number' id='play-speed' min='1' style='width:3.5em'>x</label>
+<label>Timestamps <select id='play-timestamps'><option value='realtime'>Real-time clock</option>
+<option value='track'>Scaled track time</option></select></label><br>
+<label>Seek to <input type='number' id='play-seek' min='0' style='width:5em'> s</label>
+<span id='play-position'></span><br>
+<label>Loop from <input type='number' id='loop-start' min='0' style='width:5em'> s</label>
+<label>to <input type='number' id='loop-end' min='0' style='width:5em'> s (0 = whole track)</label>
+</div>
+<button onclick='updatePlayback()' class='button'>Update Playback</button>
+<div id='playback-message' style='margin-top:10px'></div></div>
+
+<div class='control-section'><h3>GPS Data Management</h3>
+<table id='track-list' style='border-collapse:collapse;margin-bottom:10px'></table>
+<div id='track-message' style='margin-bottom:10px'></div>
+<form action='/upload' method='post' enctype='multipart/form-data'>
+<input type='file' name='csv' accept='.csv' required>
+<input type='submit' value='Add GPS Track CSV to Library' class='button'></form>
+<p><small>Upload CSV file with GPS track data (max 1MB), stored under the file's name.
+Switching between stored tracks is instant and does not stop the simulation</small></p></div>
+
+<div class='control-section'><h3>Raw Log Replay</h3>
+<p><strong>Capture:</strong> <span id='replay-status'>Loading...</span></p>
+<form action='/replay/upload' method='post' enctype='multipart/form-data'>
+<input type='file' name='log' required>
+<input type='submit' value='Upload Capture' class='button'></form>
+<div style='margin:10px 0'>
+<label><input type='checkbox' id='replay-enabled'> Play the capture instead of the track</label><br>
+<label><input type='checkbox' id='replay-rewrite'> Rewrite times and dates to the current clock</label><br>
+<label>Seek to <input type='number' id='replay-seek' min='0' style='width:5em'> s</label>
+</div>
+<button onclick='updateReplay()' class='button'>Update Replay</button>
+<div id='replay-message' style='margin-top:10px'></div>
+<p><small>sigrok-cli UART decode in ascii_stream format ("uart-1: " lines) or a plain NMEA log.
+Sent byte for byte on the GPIO/USB/network NMEA outputs at the capture's own epoch timing, looping at the end</small></p></div>
+
+<div id='channel-panels'></div>
+
+<div class='control-section'><h3>System Maintenance</h3>
+<a href='/update' target='_blank' class='button'>Firmware Update (OTA)</a>
+<a href='/status' class='button'>Detailed Status</a>
+<a href='/restart' class='button danger' onclick='return confirm("Restart?")'>Restart Device</a></div>
+
+<script>
+var channelNames=[];
+function $(id){return document.getElementById(id);}
+function build(d){
+var h='';for(var k in d.message_rates)h+="<label style='margin-right:8px'>"+k+" <input type='number' id='msg-"+k+"' min='0' max='"+d.message_rate_max+"' style='width:3.5em'></label>";
+$('msg-rates').innerHTML=h;
+$('play-speed').max=d.playback_speed_max;$('net-port').textContent=d.net_tcp_port;
+channelNames=d.channels.map(c=>c.name);
+h='';d.channels.slice(1).forEach(c=>{var n=c.name,p='ch-'+n+'-';
+h+="<div class='control-section'><h3>GPS Module "+n+" (TX on G"+c.tx_pin+")</h3>";
+h+="<p><strong>Track:</strong> <span id='"+p+"track'>Loading...</span></p>";
+h+="<form action='/upload?channel="+n+"' method='post' enctype='multipart/form-data'>";
+h+="<input type='file' name='csv' accept='.csv' required><input type='submit' value='Upload Track for "+n+"' class='button'></form>";
+h+="<div style='margin:10px 0'><label><input type='checkbox' id='"+p+"enabled'> Enabled</label> ";
+h+="<label>Baud <select id='"+p+"baud'>"+$('uart-baud').innerHTML+"</select></label> ";
+h+="<label>Start <input type='number' id='"+p+"offset' min='0' style='width:5em'> s into its track</label><br>";
+for(var k in c.sentences)h+="<label style='margin-right:8px'><input type='checkbox' id='"+p+"msg-"+k+"'> "+k+"</label>";
+h+="</div><button onclick=\"updateChannel('"+n+"')\" class='button'>Update Module "+n+"</button>";
+h+="<div id='"+p+"message' style='margin-top:10px'></div></div>";});
+$('channel-panels').innerHTML=h;}
+function fillForms(d){
+$('gpio-output').checked=d.gpio_output_enabled;$('usb-output').checked=d.usb_output_enabled;
+$('fix-rate').value=d.fix_rate_hz;$('uart-baud').value=d.uart_baud;
+$('gpio-protocol').value=d.gpio_protocol;$('usb-protocol').value=d.usb_protocol;$('net-protocol').value=d.net_protocol;
+$('burst-spacing').checked=d.burst_spacing;$('pps-output').checked=d.pps_enabled;
+for(var k in d.message_rates)$('msg-'+k).value=d.message_rates[k];
+d.channels.slice(1).forEach(c=>{var p='ch-'+c.name+'-';
+$(p+'enabled').checked=c.enabled;$(p+'baud').value=c.baud;$(p+'offset').value=c.start_offset_s;
+for(var k in c.sentences)$(p+'msg-'+k).checked=c.sentences[k];});
+$('play-speed').value=d.playback_speed;$('play-timestamps').value=d.timestamp_mode;
+$('loop-start').value=d.loop_start_s;$('loop-end').value=d.loop_end_s;
+$('replay-enabled').checked=d.replay.enabled;$('replay-rewrite').checked=d.replay.rewrite_time;}
+function showStatus(d){
+$('st-wifi').textContent=(d.wifi_mode=='ap'?'Access Point':'Client')+' ('+(d.wifi_connected?'Connected':'Disconnected')+')';
+$('st-net').textContent=d.ssid+' (IP: '+d.ip_address+')';
+$('st-ntp').textContent=d.ntp_available?'Available':'Not available';
+$('st-sync').textContent=d.ntp_sync_status;
+$('st-track').textContent=d.csv_loaded?d.channels[0].track:'Not loaded';
+$('st-gps').textContent=d.gps_active?'Active':'Stopped';
+$('net-clients').textContent=d.net_clients+' connected';
+d.channels.slice(1).forEach(c=>{
+$('ch-'+c.name+'-track').textContent=c.csv_loaded?c.track+': '+c.track_records+' fixes, at '+c.track_time_s+' of '+c.track_duration_s+' s, '+c.burst_bytes+'/'+c.epoch_byte_budget+' bytes per epoch':'Not loaded';});
+$('play-position').textContent='(at '+d.track_time_s+' of '+d.track_duration_s+' s)';
+var r=d.replay;$('replay-status').textContent=r.loaded?r.epochs+' epochs, '+r.sentences+' sentences, at '+r.position_s+' of '+r.duration_s+' s'+(r.enabled?' (playing on A)':''):'None uploaded';
+$('budget-status').textContent=d.burst_bytes+'/'+d.epoch_byte_budget+' bytes per epoch ('+d.budget_state+')';
+var s=$('output-status');
+if(d.gpio_output_enabled&&d.usb_output_enabled)s.textContent='GPIO + USB (Both active)';
+else if(d.gpio_output_enabled)s.textContent='GPIO only';
+else if(d.usb_output_enabled)s.textContent='USB only';
+else s.textContent='Error: No outputs enabled';}
+function updateOutputStatus(){return fetch('/status').then(r=>r.json()).then(d=>{
+if(!channelNames.length)build(d);fillForms(d);showStatus(d);
+}).catch(e=>$('output-status').textContent='Error loading status');}
+function pollStatus(){fetch('/status').then(r=>r.json()).then(showStatus).catch(e=>{});}
+function updateOutputConfig(){
+var gpio=$('gpio-output').checked;var usb=$('usb-output').checked;var msg=$('output-message');
+if(!gpio&&!usb){msg.innerHTML='<span style="color:red">Error: At least one output must be enabled</span>';return;}
+msg.innerHTML='<span style="color:blue">Updating...</span>';
+var fd=new FormData();fd.append('gpio',gpio?'true':'false');fd.append('usb',usb?'true':'false');
+fd.append('rate',$('fix-rate').value);fd.append('baud',$('uart-baud').value);
+fd.append('gpio_protocol',$('gpio-protocol').value);fd.append('usb_protocol',$('usb-protocol').value);
+fd.append('net_protocol',$('net-protocol').value);
+fd.append('spacing',$('burst-spacing').checked?'true':'false');fd.append('pps',$('pps-output').checked?'true':'false');
+document.querySelectorAll('[id^=msg-]').forEach(e=>fd.append('msg_'+e.id.substr(4),e.value));
+fetch('/output-config',{method:'POST',body:fd}).then(r=>r.json()).then(d=>{
+if(d.success){msg.innerHTML='<span style="color:green">Configuration updated successfully</span>';updateOutputStatus();}
+else msg.innerHTML='<span style="color:red">Error: '+d.error+'</span>';
+}).catch(e=>msg.innerHTML='<span style="color:red">Network error</span>');}
+function updatePlayback(){
+var msg=$('playback-message');
+var fd=new FormData();fd.append('speed',$('play-speed').value);fd.append('timestamps',$('play-timestamps').value);
+fd.append('seek',$('play-seek').value);fd.append('loop_start',$('loop-start').value||'0');fd.append('loop_end',$('loop-end').value||'0');
+fetch('/playback',{method:'POST',body:fd}).then(r=>r.json()).then(d=>{
+if(d.success){msg.innerHTML='<span style="color:green">Playback at '+d.playback_speed+'x from '+d.track_time_s+' s</span>';
+$('play-seek').value='';updateOutputStatus();}
+else msg.innerHTML='<span style="color:red">Error: '+d.error+'</span>';
+}).catch(e=>msg.innerHTML='<span style="color:red">Network error</span>');}
+function updateReplay(){
+var msg=$('replay-message');
+var fd=new FormData();fd.append('enabled',$('replay-enabled').checked?'true':'false');
+fd.append('rewrite',$('replay-rewrite').checked?'true':'false');fd.append('seek',$('replay-seek').value);
+fetch('/replay',{method:'POST',body:fd}).then(r=>r.json()).then(d=>{
+if(d.success){msg.innerHTML='<span style="color:green">Replay '+(d.replay.enabled?'on':'off')+' at '+d.replay.position_s+' s</span>';
+$('replay-seek').value='';updateOutputStatus();}
+else msg.innerHTML='<span style="color:red">Error: '+d.error+'</span>';
+}).catch(e=>msg.innerHTML='<span style="color:red">Network error</span>');}
+function updateChannel(n){var p='ch-'+n+'-';var msg=$(p+'message');
+var fd=new FormData();fd.append('channel',n);fd.append('enabled',$(p+'enabled').checked?'true':'false');
+fd.append('baud',$(p+'baud').value);fd.append('offset',$(p+'offset').value||'0');
+document.querySelectorAll('[id^='+p+'msg-]').forEach(e=>fd.append('msg_'+e.id.substr(p.length+4),e.checked?'true':'false'));
+fetch('/channel-config',{method:'POST',body:fd}).then(r=>r.json()).then(d=>{
+if(d.success){msg.innerHTML='<span style="color:green">Module '+n+' updated</span>';updateOutputStatus();}
+else msg.innerHTML='<span style="color:red">Error: '+d.error+'</span>';
+}).catch(e=>msg.innerHTML='<span style="color:red">Network error</span>');}
+function showTracks(c){var t='<tr><th>Track</th><th>Fixes</th><th>Duration</th><th>Area</th><th>Playing</th><th></th></tr>';
+c.tracks.forEach(k=>{t+='<tr><td>'+k.name+'</td><td>'+k.fixes+'</td><td>'+Math.round(k.duration_s/60)+' min</td>';
+t+='<td><small>'+k.bounds.min_lat+','+k.bounds.min_lon+' to '+k.bounds.max_lat+','+k.bounds.max_lon+'</small></td><td>'+k.channels+'</td><td>';
+channelNames.forEach(n=>t+='<button class="button" onclick="trackAction(\'select\',\''+k.name+'\',\''+n+'\')">Play on '+n+'</button>');
+t+='<button class="button danger" onclick="if(confirm(\'Delete '+k.name+'?\'))trackAction(\'delete\',\''+k.name+'\')">Delete</button></td></tr>';});
+$('track-list').innerHTML=t;
+$('track-message').textContent=c.tracks.length+' of '+c.max_tracks+' tracks, '+Math.round(c.flash_free_bytes/1024)+' KB free';}
+function loadTracks(){fetch('/tracks').then(r=>r.json()).then(showTracks);}
+function trackAction(a,name,ch){var fd=new FormData();fd.append('name',name);if(ch)fd.append('channel',ch);
+fetch('/tracks/'+a,{method:'POST',body:fd}).then(r=>r.json()).then(d=>{
+if(d.success){showTracks(d.catalog);updateOutputStatus();}
+else $('track-message').innerHTML='<span style="color:red">Error: '+d.error+'</span>';});}
+window.onload=function(){updateOutputStatus().then(loadTracks);setInterval(pollStatus,5000);};
+</script></body></html>
+)rawliteral";
+
 // =============================================================================
 // MAIN PROGRAM ENTRY POINTS
 // =============================================================================
@@ -967,15 +5820,32 @@ void setup() {
   M5.begin(true, true, true, false);
   M5.Lcd.setRotation(3);
   
+  // The display draws from its own task from here on - see displayStatus()
+  xTaskCreatePinnedToCore(displayTask, "display", 4096, nullptr, 1, &displayTaskHandle, 0);
+  
   // Initialize SPIFFS
   if (!SPIFFS.begin(true)) {
-    statusMsg = "SPIFFS Mount Failed";
+    setStatus("SPIFFS Mount Failed");
     displayStatus();
     return;
   }
   
+  // Created before the web server can deliver an upload that needs it
+  gpsStateMutex = xSemaphoreCreateMutex();
+  initConstellation();
+  initSentenceTemplates();
+  initEpochClock();
+  
   // Initialize GPS Serial
-  gpsSerial.begin(9600, SERIAL_8N1, GPS_RX_PIN, GPS_TX_PIN);
+  gpsBaudRate = loadBaudRatePreference();
+  beginGpsUart(gpsBaudRate);
+  
+  // Secondary GPS modules - UARTs are set up even while disabled, so
+  // enabling one from the web interface takes effect at the next epoch
+  for (int i = 1; i < SIM_CHANNEL_COUNT; i++) {
+    loadChannelPreferences(simChannels[i]);
+    beginChannelUart(simChannels[i]);
+  }
   
   displayStatus();
   
@@ -987,11 +5857,11 @@ void setup() {
   
   if (currentWiFiMode == WIFI_AP_MODE) {
     // Even in AP mode preference, try to get NTP time first
-    statusMsg = "Attempting NTP sync before AP mode...";
+    setStatus("Attempting NTP sync before AP mode...");
     displayStatus();
     
     if (performNtpSync(true)) {
-      statusMsg = "NTP sync completed - starting AP mode";
+      setStatus("NTP sync completed - starting AP mode");
       displayStatus();
       delay(2000);  // Show success message
     }
@@ -1010,7 +5880,7 @@ void setup() {
   }
   
   if (!wifiConnected) {
-    statusMsg = "WiFi setup failed - trying NTP then AP mode";
+    setStatus("WiFi setup failed - trying NTP then AP mode");
     displayStatus();
     
     // Final attempt: try to get time before falling back to AP
@@ -1024,131 +5894,381 @@ void setup() {
   
   // Setup web server for OTA
   server.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
-    // Generate current status information for display
-    String wifiModeStr = (currentWiFiMode == WIFI_AP_MODE) ? "Access Point" : "Client";
-    String wifiStatusStr = WiFi.status() == WL_CONNECTED ? "Connected" : "Disconnected";
-    String ipAddress = WiFi.localIP().toString();
-    String ssidName = (currentWiFiMode == WIFI_AP_MODE) ? String(AP_SSID) : WiFi.SSID();
-    String csvStatus = csvLoaded ? "Loaded" : "Not loaded";
-    String gpsStatus = gpsSimActive ? "Active" : "Stopped";
-    String ntpStatus = ntpSyncAvailable ? "Available" : "Not available";
-    String ntpSyncStatus = getNtpSyncStatus();
-    
-    String html = "<!DOCTYPE html><html><head><title>GPS Simulator Control</title>";
-    html += "<meta name='viewport' content='width=device-width, initial-scale=1'>";
-    html += "<style>body{font-family:Arial,sans-serif;margin:20px}.status-panel{background:#f0f0f0;padding:15px;border-radius:5px;margin-bottom:20px}";
-    html += ".control-section{margin-bottom:25px}.button{background:#007cba;color:white;padding:10px 15px;text-decoration:none;border-radius:5px;margin:5px;display:inline-block}";
-    html += ".button:hover{background:#005a87}.danger{background:#d32f2f}.danger:hover{background:#b71c1c}.success{background:#388e3c}.success:hover{background:#2e7d32}";
-    html += "select,input[type='file']{padding:8px;margin:5px}</style></head><body>";
-    html += "<h1>GPS Simulator Control Panel</h1>";
-    
-    // System Status Panel
-    html += "<div class='status-panel'><h3>System Status</h3>";
-    html += "<p><strong>WiFi Mode:</strong> " + wifiModeStr + " (" + wifiStatusStr + ")</p>";
-    html += "<p><strong>Network:</strong> " + ssidName + " (IP: " + ipAddress + ")</p>";
-    html += "<p><strong>NTP Status:</strong> " + ntpStatus + "</p>";
-    html += "<p><strong>Time Sync:</strong> " + ntpSyncStatus + "</p>";
-    html += "<p><strong>CSV File:</strong> " + csvStatus + "</p>";
-    html += "<p><strong>GPS Output:</strong> " + gpsStatus + "</p></div>";
-    
-    // Output Configuration
-    html += "<div class='control-section'><h3>Output Configuration</h3>";
-    html += "<p><strong>Current Output:</strong> <span id='output-status'>Loading...</span></p>";
-    html += "<div style='margin:10px 0'>";
-    html += "<label><input type='checkbox' id='gpio-output'> GPIO Pins 32/33 (Hardware UART)</label><br>";
-    html += "<label><input type='checkbox' id='usb-output'> USB Serial Port</label></div>";
-    html += "<button onclick='updateOutputConfig()' class='button'>Update Output Configuration</button>";
-    html += "<div id='output-message' style='margin-top:10px'></div>";
-    html += "<p><small><strong>GPIO Output:</strong> Hardware connection for GPS modules/analyzers<br>";
-    html += "<strong>USB Output:</strong> Direct computer connection<br>";
-    html += "<em>Note: At least one output must be enabled</em></small></p></div>";
-    
-    // GPS Simulation Control
-    html += "<div class='control-section'><h3>GPS Simulation Control</h3>";
-    html += "<a href='/start' class='button success'>Start GPS Simulation</a>";
-    html += "<a href='/stop' class='button danger'>Stop GPS Simulation</a>";
-    html += "<p><small>NMEA output via configured channels at 9600 baud</small></p></div>";
-    
-    // GPS Data Management
-    html += "<div class='control-section'><h3>GPS Data Management</h3>";
-    html += "<form action='/upload' method='post' enctype='multipart/form-data'>";
-    html += "<input type='file' name='csv' accept='.csv' required>";
-    html += "<input type='submit' value='Upload GPS Track CSV' class='button'></form>";
-    html += "<p><small>Upload CSV file with GPS track data (max 1MB)</small></p></div>";
-    
-    // System Maintenance
-    html += "<div class='control-section'><h3>System Maintenance</h3>";
-    html += "<a href='/update' target='_blank' class='button'>Firmware Update (OTA)</a>";
-    html += "<a href='/status' class='button'>Detailed Status</a>";
-    html += "<a href='/restart' class='button danger' onclick='return confirm(\"Restart?\")'>Restart Device</a></div>";
-    
-    // JavaScript
-    html += "<script>";
-    html += "function updateOutputStatus(){fetch('/status').then(r=>r.json()).then(d=>{";
-    html += "document.getElementById('gpio-output').checked=d.gpio_output_enabled;";
-    html += "document.getElementById('usb-output').checked=d.usb_output_enabled;";
-    html += "var s=document.getElementById('output-status');";
-    html += "if(d.gpio_output_enabled&&d.usb_output_enabled)s.textContent='GPIO + USB (Both active)';";
-    html += "else if(d.gpio_output_enabled)s.textContent='GPIO only';";
-    html += "else if(d.usb_output_enabled)s.textContent='USB only';";
-    html += "else s.textContent='Error: No outputs enabled';";
-    html += "}).catch(e=>document.getElementById('output-status').textContent='Error loading status');}";
-    html += "function updateOutputConfig(){";
-    html += "var gpio=document.getElementById('gpio-output').checked;";
-    html += "var usb=document.getElementById('usb-output').checked;";
-    html += "var msg=document.getElementById('output-message');";
-    html += "if(!gpio&&!usb){msg.innerHTML='<span style=\"color:red\">Error: At least one output must be enabled</span>';return;}";
-    html += "msg.innerHTML='<span style=\"color:blue\">Updating...</span>';";
-    html += "var fd=new FormData();fd.append('gpio',gpio?'true':'false');fd.append('usb',usb?'true':'false');";
-    html += "fetch('/output-config',{method:'POST',body:fd}).then(r=>r.json()).then(d=>{";
-    html += "if(d.success){msg.innerHTML='<span style=\"color:green\">Configuration updated successfully</span>';updateOutputStatus();}";
-    html += "else msg.innerHTML='<span style=\"color:red\">Error: '+d.error+'</span>';";
-    html += "}).catch(e=>msg.innerHTML='<span style=\"color:red\">Network error</span>');}";
-    html += "window.onload=function(){updateOutputStatus();};";
-    html += "</script></body></html>";
-    request->send(200, "text/html", html);
+    // Static page straight from flash - its script fills itself in from /status
+    request->send_P(200, "text/html", INDEX_HTML);
   });
   
   server.on("/upload", HTTP_POST, [](AsyncWebServerRequest *request) {
-    request->send(200, "text/plain", "CSV uploaded successfully");
+    // Runs after the final chunk, so the ingest report is complete
+    const TrackIngestResult& result = lastIngestResult;
+    if (!result.error.isEmpty()) {
+      request->send(400, "text/plain", "CSV rejected: " + result.error);
+      return;
+    }
+    String report = "CSV uploaded successfully as track " + String(uploadTrackName) + ": " +
+                    String(result.fixes) + " fixes from " + String(result.rows) + " rows";
+    if (result.skipped || result.overlong) {
+      report += " (" + String(result.skipped) + " without a fix, " +
+                String(result.overlong) + " too long)";
+    }
+    request->send(200, "text/plain", report);
   }, [](AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final) {
+    // Separate handle from trackFile, which belongs to the generator task
+    static File uploadFile;
+    static SimChannel* uploadChannel = nullptr;
+    
     if (index == 0) {
-      // Delete old file
-      if (SPIFFS.exists("/gps_track.csv")) {
-        SPIFFS.remove("/gps_track.csv");
+      // /upload?name=reef&channel=B stores the track as "reef" and plays it on
+      // module B; the name defaults to the file's, the channel to none
+      uploadFile.close();
+      lastIngestResult = TrackIngestResult();
+      uploadChannel = request->hasParam("channel") ? findChannel(request->getParam("channel")->value()) : nullptr;
+      String name = request->hasParam("name") ? request->getParam("name")->value()
+                                              : trackNameFromFilename(filename);
+      strlcpy(uploadTrackName, name.c_str(), sizeof(uploadTrackName));
+      
+      if (request->hasParam("channel") && !uploadChannel) {
+        lastIngestResult.error = "Unknown channel";
+      } else if (!isValidTrackName(name)) {
+        lastIngestResult.error = "Track name must be 1-16 letters, digits, '_' or '-'";
+      } else if (!findCatalogEntry(uploadTrackName) && trackCatalogCount >= TRACK_CATALOG_MAX) {
+        lastIngestResult.error = "Track library full - delete a track first";
+      } else {
+        // Records are compiled as the chunks arrive - the CSV itself is never
+        // stored, and the library is only touched once the upload is complete
+        uploadFile = SPIFFS.open(TRACK_UPLOAD_PATH, "w");
+        if (uploadFile) {
+          trackIngest.begin(uploadFile);
+        } else {
+          lastIngestResult.error = "Failed to create track";
+        }
       }
-      csvFile = SPIFFS.open("/gps_track.csv", "w");
     }
     
-    if (csvFile) {
-      csvFile.write(data, len);
+    if (uploadFile && trackIngest.ok()) {
+      trackIngest.feed(data, len);
     }
     
-    if (final) {
-      csvFile.close();
-      csvLoaded = false;
-      gpsSimActive = false;
-      loadCSV();
+    if (final && uploadFile) {
+      lastIngestResult = trackIngest.finish();
+      uploadFile.close();
+      LOG_INFO("Upload (%s): %u rows, %u fixes", uploadTrackName, lastIngestResult.rows, lastIngestResult.fixes);
+      
+      if (!trackIngest.ok()) {
+        SPIFFS.remove(TRACK_UPLOAD_PATH);
+        setStatus(lastIngestResult.error);
+      } else if (!installUploadedTrack(uploadTrackName, lastIngestResult)) {
+        SPIFFS.remove(TRACK_UPLOAD_PATH);
+        lastIngestResult.error = "Failed to store track";
+        setStatus(lastIngestResult.error);
+      } else if (uploadChannel) {
+        selectTrack(*uploadChannel, uploadTrackName);
+      } else if (!primaryChannel.csvLoaded) {
+        selectTrack(primaryChannel, uploadTrackName);  // First track - ready to start
+      } else {
+        setStatus("Track " + String(uploadTrackName) + " stored");
+      }
+    }
+  });
+  
+  // Track library: list, and select or delete by name
+  server.on("/tracks/select", HTTP_POST, [](AsyncWebServerRequest *request) {
+    TrackCatalogEntry* entry = request->hasParam("name", true) ? findCatalogEntry(request->getParam("name", true)->value().c_str()) : nullptr;
+    SimChannel* ch = request->hasParam("channel", true) ? findChannel(request->getParam("channel", true)->value()) : &primaryChannel;
+    if (!entry || !ch) {
+      sendJsonError(request, 400, entry ? "Unknown channel" : "Unknown track");
+      return;
+    }
+    if (!selectTrack(*ch, entry->name)) {
+      char error[STATUS_TEXT_MAX];
+      copyStatus(error, sizeof(error));
+      sendJsonError(request, 500, error);
+      return;
     }
+    setStatus(String(ch->name) + ": " + entry->name);
+    displayStatus();
+    sendTrackCatalogChanged(request);
+  });
+  
+  server.on("/tracks/delete", HTTP_POST, [](AsyncWebServerRequest *request) {
+    TrackCatalogEntry* entry = request->hasParam("name", true) ? findCatalogEntry(request->getParam("name", true)->value().c_str()) : nullptr;
+    if (!entry) {
+      sendJsonError(request, 400, "Unknown track");
+      return;
+    }
+    setStatus("Deleted " + String(entry->name));
+    deleteTrack(*entry);
+    displayStatus();
+    sendTrackCatalogChanged(request);
+  });
+  
+  server.on("/tracks", HTTP_GET, [](AsyncWebServerRequest *request) {
+    AsyncResponseStream* response = request->beginResponseStream("application/json", CATALOG_JSON_RESERVE);
+    JsonPrinter json(*response);
+    printTrackCatalogJson(json, nullptr);
+    request->send(response);
   });
   
   server.on("/start", HTTP_GET, [](AsyncWebServerRequest *request) {
-    if (csvLoaded) {
+    if (simulationReady()) {
+      // The generator task fetches the first fix at the next epoch
       gpsSimActive = true;
-      currentGPS = getNextGPSData();
-      statusMsg = "GPS simulation started";
+      setStatus("GPS simulation started");
       request->send(200, "text/plain", "GPS simulation started");
     } else {
-      request->send(400, "text/plain", "No CSV file loaded");
+      request->send(400, "text/plain", "No track or replay loaded");
     }
   });
   
   server.on("/stop", HTTP_GET, [](AsyncWebServerRequest *request) {
     gpsSimActive = false;
-    statusMsg = "GPS simulation stopped";
+    setStatus("GPS simulation stopped");
     request->send(200, "text/plain", "GPS simulation stopped");
   });
   
+  // Raw log replay: a sigrok-cli ascii_stream UART decode or plain NMEA log,
+  // split into epochs as it streams in - only the result goes to flash
+  server.on("/replay/upload", HTTP_POST, [](AsyncWebServerRequest *request) {
+    const ReplayIngestResult& result = lastReplayResult;
+    if (!result.error.isEmpty()) {
+      request->send(400, "text/plain", "Capture rejected: " + result.error);
+      return;
+    }
+    String report = "Capture stored: " + String(result.stats.epochs) + " epochs, " +
+                    String(result.stats.sentences) + " sentences, " +
+                    String(result.stats.durationMs / 1000) + "s";
+    if (result.stats.badChecksum || result.stats.fragments) {
+      report += " (" + String(result.stats.badChecksum) + " bad checksums, " +
+                String(result.stats.fragments) + " fragments dropped)";
+    }
+    request->send(200, "text/plain", report);
+  }, [](AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final) {
+    static bool ingesting = false;
+    
+    if (index == 0) {
+      lastReplayResult = ReplayIngestResult();
+      ingesting = replayIngest.begin();
+      if (!ingesting) {
+        lastReplayResult.error = "Failed to create replay";
+      }
+    }
+    
+    if (ingesting && replayIngest.ok()) {
+      replayIngest.feed(data, len);
+    }
+    
+    if (final && ingesting) {
+      ingesting = false;
+      lastReplayResult = replayIngest.finish();
+      const ReplayScanStats& stats = lastReplayResult.stats;
+      LOG_INFO("Replay upload: %u epochs, %u sentences, %u bad checksums, %u fragments",
+               stats.epochs, stats.sentences, stats.badChecksum, stats.fragments);
+      
+      if (!lastReplayResult.error.isEmpty()) {
+        setStatus(lastReplayResult.error);
+      } else if (!installUploadedReplay()) {
+        lastReplayResult.error = "Failed to store replay";
+        setStatus(lastReplayResult.error);
+      } else {
+        setStatus("Replay stored");
+      }
+    }
+  });
+  
+  // Replay settings: enabled, rewrite (times and dates), seek (capture seconds)
+  server.on("/replay", HTTP_POST, [](AsyncWebServerRequest *request) {
+    if (!replay.loaded) {
+      sendJsonError(request, 400, "No capture uploaded");
+      return;
+    }
+    
+    long seekSeconds = -1;
+    if (request->hasParam("seek", true) && request->getParam("seek", true)->value().length() > 0) {
+      seekSeconds = request->getParam("seek", true)->value().toInt();
+      if (seekSeconds < 0) {
+        sendJsonError(request, 400, "Seek offset must not be negative");
+        return;
+      }
+    }
+    
+    xSemaphoreTake(gpsStateMutex, portMAX_DELAY);
+    if (request->hasParam("enabled", true)) {
+      replay.enabled = request->getParam("enabled", true)->value() == "true";
+    }
+    if (request->hasParam("rewrite", true)) {
+      replay.rewriteTime = request->getParam("rewrite", true)->value() == "true";
+    }
+    if (seekSeconds >= 0) {
+      seekReplay((uint32_t)seekSeconds * 1000);
+    }
+    xSemaphoreGive(gpsStateMutex);
+    
+    setStatus(replay.enabled ? "Replaying capture" : "Replay off");
+    displayStatus();
+    
+    AsyncResponseStream* response = request->beginResponseStream("application/json", 512);
+    JsonPrinter json(*response);
+    json.beginObject().field("success", true);
+    printReplayJson(json, "replay");
+    json.endObject();
+    request->send(response);
+  });
+  
+  // Playback speed, timestamps, seek and loop range - times in track seconds
+  server.on("/playback", HTTP_POST, [](AsyncWebServerRequest *request) {
+    if (!primaryChannel.csvLoaded) {
+      sendJsonError(request, 400, "No CSV file loaded");
+      return;
+    }
+    
+    uint8_t newSpeed = playbackSpeed;
+    if (request->hasParam("speed", true)) {
+      long speed = request->getParam("speed", true)->value().toInt();
+      if (speed < 1 || speed > PLAYBACK_SPEED_MAX) {
+        char error[32];
+        snprintf(error, sizeof(error), "Speed must be 1 to %dx", (int)PLAYBACK_SPEED_MAX);
+        sendJsonError(request, 400, error);
+        return;
+      }
+      newSpeed = speed;
+    }
+    
+    TimestampMode newMode = timestampMode;
+    if (request->hasParam("timestamps", true)) {
+      String value = request->getParam("timestamps", true)->value();
+      if (value == "realtime") {
+        newMode = TIMESTAMP_REALTIME;
+      } else if (value == "track") {
+        newMode = TIMESTAMP_TRACK;
+      } else {
+        sendJsonError(request, 400, "Timestamps must be realtime or track");
+        return;
+      }
+    }
+    
+    // Loop range: end 0 (or at/before the start) plays the whole track
+    uint32_t newLoopStartMs = loopStartMs;
+    uint32_t newLoopEndMs = loopEndMs;
+    if (request->hasParam("loop_start", true)) {
+      newLoopStartMs = trackOffsetMs(primaryChannel, request->getParam("loop_start", true)->value().toInt());
+    }
+    if (request->hasParam("loop_end", true)) {
+      newLoopEndMs = trackOffsetMs(primaryChannel, request->getParam("loop_end", true)->value().toInt());
+    }
+    if (newLoopEndMs <= newLoopStartMs) {
+      newLoopStartMs = 0;
+      newLoopEndMs = 0;
+    }
+    
+    long seekSeconds = -1;
+    if (request->hasParam("seek", true) && request->getParam("seek", true)->value().length() > 0) {
+      seekSeconds = request->getParam("seek", true)->value().toInt();
+      if (seekSeconds < 0) {
+        sendJsonError(request, 400, "Seek offset must not be negative");
+        return;
+      }
+    }
+    
+    xSemaphoreTake(gpsStateMutex, portMAX_DELAY);
+    playbackSpeed = newSpeed;
+    if (newMode != timestampMode) {
+      timestampMode = newMode;
+      warpedUtcUs = 0;  // Warped clock restarts from real UTC at the next epoch
+    }
+    loopStartMs = newLoopStartMs;
+    loopEndMs = newLoopEndMs;
+    
+    // An explicit seek wins; otherwise jump into a new loop range we are outside of
+    uint32_t positionMs = primaryChannel.trackTimeMs;
+    if (seekSeconds >= 0) {
+      seekPlayback(primaryChannel, trackOffsetMs(primaryChannel, seekSeconds));
+    } else if (loopEndMs > 0 && (positionMs < loopStartMs || positionMs >= loopEndMs)) {
+      seekPlayback(primaryChannel, loopStartMs);
+    }
+    positionMs = primaryChannel.trackTimeMs;
+    xSemaphoreGive(gpsStateMutex);
+    
+    setStatus("Playback " + String(playbackSpeed) + "x");
+    displayStatus();
+    
+    AsyncResponseStream* response = request->beginResponseStream("application/json", 128);
+    JsonPrinter json(*response);
+    json.beginObject()
+        .field("success", true)
+        .field("playback_speed", playbackSpeed)
+        .field("track_time_s", positionMs / 1000)
+        .field("loop_start_s", loopStartMs / 1000)
+        .field("loop_end_s", loopEndMs / 1000)
+        .endObject();
+    request->send(response);
+  });
+  
+  // Secondary GPS module settings: channel=B, enabled, baud, offset (s), msg_RMC=true ...
+  server.on("/channel-config", HTTP_POST, [](AsyncWebServerRequest *request) {
+    SimChannel* found = request->hasParam("channel", true) ? findChannel(request->getParam("channel", true)->value()) : nullptr;
+    if (!found || found == &primaryChannel) {
+      sendJsonError(request, 400, "Channel must name a secondary module");
+      return;
+    }
+    SimChannel& ch = *found;
+    
+    bool newEnabled = ch.enabled;
+    if (request->hasParam("enabled", true)) {
+      newEnabled = request->getParam("enabled", true)->value() == "true";
+    }
+    
+    uint32_t newBaudRate = ch.baudRate;
+    if (request->hasParam("baud", true)) {
+      newBaudRate = request->getParam("baud", true)->value().toInt();
+      if (!isSupportedBaudRate(newBaudRate)) {
+        sendJsonError(request, 400, "Baud rate must be 4800, 9600, 19200, 38400, 57600 or 115200");
+        return;
+      }
+    }
+    
+    uint32_t newOffsetMs = ch.startOffsetMs;
+    if (request->hasParam("offset", true)) {
+      long offset = request->getParam("offset", true)->value().toInt();
+      if (offset < 0 || offset > 86400L * 7) {
+        sendJsonError(request, 400, "Start offset must be 0 to 604800 seconds");
+        return;
+      }
+      newOffsetMs = offset * 1000UL;
+    }
+    
+    uint8_t newMask = ch.messageMask;
+    for (int m = MSG_RMC; m <= MSG_TXT; m++) {
+      String param = "msg_" + String(outputMessages[m].name);
+      if (!request->hasParam(param, true)) continue;
+      if (request->getParam(param, true)->value() == "true") {
+        newMask |= 1 << m;
+      } else {
+        newMask &= ~(1 << m);
+      }
+    }
+    
+    xSemaphoreTake(gpsStateMutex, portMAX_DELAY);
+    if (newEnabled != ch.enabled || newOffsetMs != ch.startOffsetMs) {
+      ch.currentGPS.valid = false;   // Restart at the (new) offset at the next epoch
+    }
+    ch.enabled = newEnabled;
+    ch.startOffsetMs = newOffsetMs;
+    ch.messageMask = newMask;
+    ch.burstBytes = 0;               // Re-measured with the new sentences
+    setChannelBaudRate(ch, newBaudRate);
+    xSemaphoreGive(gpsStateMutex);
+    saveChannelPreferences(ch);
+    
+    setStatus("Channel " + String(ch.name) + (ch.enabled ? " on" : " off"));
+    displayStatus();
+    AsyncResponseStream* response = request->beginResponseStream("application/json", 512);
+    JsonPrinter json(*response);
+    json.beginObject().field("success", true);
+    printChannelsJson(json, "channels");
+    json.endObject();
+    request->send(response);
+  });
+  
   // WiFi mode switching endpoint
   server.on("/wifi-mode", HTTP_POST, [](AsyncWebServerRequest *request) {
     if (request->hasParam("mode", true)) {
@@ -1175,32 +6295,93 @@ void setup() {
     }
   });
   
+  // Pipeline metrics - one "name{labels} value" per line for scrapers
+  server.on("/metrics", HTTP_GET, [](AsyncWebServerRequest *request) {
+    AsyncResponseStream* response = request->beginResponseStream("text/plain", METRICS_TEXT_RESERVE);
+    printMetrics(*response);
+    request->send(response);
+  });
+  
+  // Debug log ring - plain text, oldest line first
+  server.on("/logs", HTTP_GET, [](AsyncWebServerRequest *request) {
+    AsyncResponseStream* response = request->beginResponseStream("text/plain", LOG_RING_SIZE);
+    printLogContents(*response);
+    request->send(response);
+  });
+  
   // Detailed status endpoint (JSON for API access)
   server.on("/status", HTTP_GET, [](AsyncWebServerRequest *request) {
-    String json = "{";
-    json += "\"wifi_mode\":\"" + String(currentWiFiMode == WIFI_AP_MODE ? "ap" : "client") + "\",";
-    json += "\"wifi_connected\":" + String(WiFi.status() == WL_CONNECTED ? "true" : "false") + ",";
-    json += "\"ip_address\":\"" + WiFi.localIP().toString() + "\",";
-    json += "\"ssid\":\"" + (currentWiFiMode == WIFI_AP_MODE ? String(AP_SSID) : WiFi.SSID()) + "\",";
-    json += "\"ntp_available\":" + String(ntpSyncAvailable ? "true" : "false") + ",";
-    json += "\"ntp_sync_completed\":" + String(ntpSyncCompleted ? "true" : "false") + ",";
-    json += "\"last_ntp_sync\":" + String(lastSuccessfulNtpSync) + ",";
-    json += "\"ntp_sync_status\":\"" + getNtpSyncStatus() + "\",";
-    json += "\"csv_loaded\":" + String(csvLoaded ? "true" : "false") + ",";
-    json += "\"gps_active\":" + String(gpsSimActive ? "true" : "false") + ",";
-    json += "\"current_line\":" + String(currentLine) + ",";
-    json += "\"gpio_output_enabled\":" + String(gpioOutputEnabled ? "true" : "false") + ",";
-    json += "\"usb_output_enabled\":" + String(usbOutputEnabled ? "true" : "false") + ",";
-    json += "\"free_heap\":" + String(ESP.getFreeHeap()) + ",";
-    json += "\"uptime_ms\":" + String(millis());
+    // Printed straight into one pre-sized buffer - see Streaming JSON Responses
+    AsyncResponseStream* response = request->beginResponseStream("application/json", STATUS_JSON_RESERVE);
+    JsonPrinter json(*response);
+    char status[STATUS_TEXT_MAX];
+    copyStatus(status, sizeof(status));
+    json.beginObject()
+        .field("wifi_mode", currentWiFiMode == WIFI_AP_MODE ? "ap" : "client")
+        .field("wifi_connected", WiFi.status() == WL_CONNECTED)
+        .field("ip_address", WiFi.localIP().toString())
+        .field("ssid", currentWiFiMode == WIFI_AP_MODE ? String(AP_SSID) : WiFi.SSID())
+        .field("ntp_available", ntpSyncAvailable)
+        .field("ntp_sync_completed", ntpSyncCompleted)
+        .field("last_ntp_sync", lastSuccessfulNtpSync)
+        .field("time_syncs", timeSyncCount)
+        .field("last_time_correction_us", lastTimeCorrectionUs)
+        .field("ntp_sync_status", getNtpSyncStatus())
+        .field("status_message", status)
+        .field("csv_loaded", primaryChannel.csvLoaded)
+        .field("gps_active", gpsSimActive)
+        .field("current_line", primaryChannel.currentLine)
+        .field("track_records", primaryChannel.trackRecordCount)
+        .field("track_storage", primaryChannel.trackRecords ? "ram" : "flash")
+        .field("track_resident_bytes", primaryChannel.trackResidentBytes)
+        .field("track_time_s", primaryChannel.trackTimeMs / 1000)
+        .field("track_duration_s", primaryChannel.trackDurationMs / 1000);
+    printChannelsJson(json, "channels");
+    printReplayJson(json, "replay");
+    json.field("playback_speed", playbackSpeed)
+        .field("playback_speed_max", PLAYBACK_SPEED_MAX)
+        .field("timestamp_mode", timestampMode == TIMESTAMP_TRACK ? "track" : "realtime")
+        .field("loop_start_s", loopStartMs / 1000)
+        .field("loop_end_s", loopEndMs / 1000)
+        .field("gpio_output_enabled", gpioOutputEnabled)
+        .field("usb_output_enabled", usbOutputEnabled)
+        .field("fix_rate_hz", gpsFixRateHz);
+    printMessageRatesJson(json, "message_rates");
+    json.field("message_rate_max", MAX_MESSAGE_DIVISOR)
+        .field("uart_baud", gpsBaudRate)
+        .field("epoch_byte_budget", epochByteBudget())
+        .field("burst_bytes", mandatoryBurstBytes + optionalBurstBytes)
+        .field("burst_spacing", burstSpacingEnabled)
+        .field("pps_enabled", ppsOutputEnabled)
+        .field("pps_pulses", ppsPulses)
+        .field("epoch_clock_set", epochClockSet);
+    printJitterJson(json, "epoch_timer_jitter", epochTimerJitter);
+    printJitterJson(json, "burst_start_jitter", burstStartJitter);
+    json.field("wire_latency_us", wireLatencyUs)
+        .field("wire_latency_max_us", wireLatencyMaxUs)
+        .field("wire_burst_us", wireBurstUs)
+        .field("uart_write_calls", uartWriteCalls)
+        .field("budget_state", burstBudgetState == BUDGET_OK ? "ok" :
+                               burstBudgetState == BUDGET_DROPPING_OPTIONAL ? "dropping_optional" : "overrun")
+        .field("optional_sentences_dropped", optionalSentencesDropped)
+        .field("dropped_sentences", outputRing.droppedSentences)
+        .field("gpio_protocol", protocolName(gpioProtocol))
+        .field("host_commands_applied", hostCommandsApplied)
+        .field("host_commands_rejected", hostCommandsRejected)
+        .field("usb_protocol", protocolName(usbProtocol))
+        .field("net_protocol", protocolName(netProtocol))
+        .field("net_clients", netClientCount)
+        .field("net_tcp_port", NET_TCP_PORT)
+        .field("free_heap", ESP.getFreeHeap())
+        .field("uptime_ms", millis());
     
     // Add connected clients info for AP mode
     if (currentWiFiMode == WIFI_AP_MODE) {
-      json += ",\"ap_clients\":" + String(WiFi.softAPgetStationNum());
+      json.field("ap_clients", WiFi.softAPgetStationNum());
     }
     
-    json += "}";
-    request->send(200, "application/json", json);
+    json.endObject();
+    request->send(response);
   });
   
   // Device restart endpoint
@@ -1229,14 +6410,94 @@ void setup() {
     
     // Validation: At least one output must be enabled
     if (!newGpioEnabled && !newUsbEnabled) {
-      request->send(400, "application/json", 
-        "{\"success\":false,\"error\":\"At least one output must be enabled\"}");
+      sendJsonError(request, 400, "At least one output must be enabled");
       return;
     }
     
+    // Parse fix rate parameter (Hz) - must be one the neo-6m supports
+    uint8_t newFixRateHz = gpsFixRateHz;
+    if (request->hasParam("rate", true)) {
+      long rate = request->getParam("rate", true)->value().toInt();
+      if (!isSupportedFixRate(rate)) {
+        sendJsonError(request, 400, "Fix rate must be 1, 2, 5 or 10 Hz");
+        return;
+      }
+      newFixRateHz = (uint8_t)rate;
+    }
+    
+    // Parse GPIO UART baud rate parameter
+    uint32_t newBaudRate = gpsBaudRate;
+    if (request->hasParam("baud", true)) {
+      newBaudRate = request->getParam("baud", true)->value().toInt();
+      if (!isSupportedBaudRate(newBaudRate)) {
+        sendJsonError(request, 400, "Baud rate must be 4800, 9600, 19200, 38400, 57600 or 115200");
+        return;
+      }
+    }
+    
+    // Parse per-channel protocol parameters (nmea, ubx or both)
+    OutputProtocol newGpioProtocol = gpioProtocol;
+    OutputProtocol newUsbProtocol = usbProtocol;
+    OutputProtocol newNetProtocol = netProtocol;
+    const char* protocolParams[] = {"gpio_protocol", "usb_protocol", "net_protocol"};
+    OutputProtocol* protocolTargets[] = {&newGpioProtocol, &newUsbProtocol, &newNetProtocol};
+    for (int i = 0; i < 3; i++) {
+      if (!request->hasParam(protocolParams[i], true)) continue;
+      String value = request->getParam(protocolParams[i], true)->value();
+      if (value == "nmea") {
+        *protocolTargets[i] = PROTOCOL_NMEA;
+      } else if (value == "ubx") {
+        *protocolTargets[i] = PROTOCOL_UBX;
+      } else if (value == "both") {
+        *protocolTargets[i] = PROTOCOL_BOTH;
+      } else {
+        sendJsonError(request, 400, "Protocol must be nmea, ubx or both");
+        return;
+      }
+    }
+    
+    // Parse per-message rates: msg_RMC=1, msg_GSV=5, msg_TXT=0 ...
+    uint8_t newMessageRates[OUTPUT_MESSAGE_COUNT];
+    for (int i = 0; i < OUTPUT_MESSAGE_COUNT; i++) {
+      newMessageRates[i] = messageRate((OutputMessage)i);
+      String param = "msg_" + String(outputMessages[i].name);
+      if (!request->hasParam(param, true)) continue;
+      String value = request->getParam(param, true)->value();
+      long rate = value.toInt();
+      if (value.length() == 0 || rate < 0 || rate > MAX_MESSAGE_DIVISOR) {
+        sendJsonError(request, 400, "Message rates must be 0 (off) to 255 epochs");
+        return;
+      }
+      newMessageRates[i] = rate;
+    }
+    
+    // Parse burst spacing: true = legacy 50ms offsets, false = one write per burst
+    bool newBurstSpacing = burstSpacingEnabled;
+    if (request->hasParam("spacing", true)) {
+      newBurstSpacing = request->getParam("spacing", true)->value() == "true";
+    }
+    
+    // Parse PPS timepulse: true = pulse GPIO 26 at the top of each second
+    bool newPpsEnabled = ppsOutputEnabled;
+    if (request->hasParam("pps", true)) {
+      newPpsEnabled = request->getParam("pps", true)->value() == "true";
+    }
+    
     // Apply new configuration
     gpioOutputEnabled = newGpioEnabled;
+    burstSpacingEnabled = newBurstSpacing;
+    ppsOutputEnabled = newPpsEnabled;
     usbOutputEnabled = newUsbEnabled;
+    gpioProtocol = newGpioProtocol;
+    usbProtocol = newUsbProtocol;
+    netProtocol = newNetProtocol;
+    setBaudRate(newBaudRate);
+    xSemaphoreTake(gpsStateMutex, portMAX_DELAY);
+    for (int i = 0; i < OUTPUT_MESSAGE_COUNT; i++) {
+      setMessageRate((OutputMessage)i, newMessageRates[i]);
+    }
+    gpsFixRateHz = newFixRateHz;  // The epoch clock re-aligns at the next boundary
+    xSemaphoreGive(gpsStateMutex);
     
     // Update status message for display
     String outputStatus = "";
@@ -1247,48 +6508,62 @@ void setup() {
     } else {
       outputStatus = "USB only";
     }
-    statusMsg = "Output: " + outputStatus;
+    setStatus("Output: " + outputStatus);
     displayStatus();
     
     // Send success response
-    String json = "{\"success\":true,\"gpio_enabled\":" + String(gpioOutputEnabled ? "true" : "false") + 
-                  ",\"usb_enabled\":" + String(usbOutputEnabled ? "true" : "false") + "}";
-    request->send(200, "application/json", json);
+    AsyncResponseStream* response = request->beginResponseStream("application/json", 512);
+    JsonPrinter json(*response);
+    json.beginObject()
+        .field("success", true)
+        .field("gpio_enabled", gpioOutputEnabled)
+        .field("usb_enabled", usbOutputEnabled)
+        .field("fix_rate_hz", gpsFixRateHz)
+        .field("uart_baud", gpsBaudRate)
+        .field("gpio_protocol", protocolName(gpioProtocol))
+        .field("usb_protocol", protocolName(usbProtocol))
+        .field("net_protocol", protocolName(netProtocol))
+        .field("burst_spacing", burstSpacingEnabled)
+        .field("pps_enabled", ppsOutputEnabled);
+    printMessageRatesJson(json, "message_rates");
+    json.endObject();
+    request->send(response);
   });
   
+  // WebSocket and TCP NMEA streams - registered before the server starts
+  beginNetworkSinks();
+  
   AsyncElegantOTA.begin(&server);
   server.begin();
   
-  statusMsg = "Ready - " + WiFi.localIP().toString();
+  setStatus("Ready - " + WiFi.localIP().toString());
   displayStatus();
   
-  // Try to load existing CSV
-  loadCSV();
+  // Index the track library (moving in any single-track files from older
+  // firmware) and load each channel's selected track
+  initTrackCatalog();
+  loadReplay();
   displayStatus();
+  
+  // Start the NMEA pipeline: the output task runs on core 0 (the other core
+  // from loop()), the generator on core 1 above loop()'s priority of 1
+  xTaskCreatePinnedToCore(gpsOutputTask, "gpsOutput", 4096, nullptr, 3, &gpsOutputTaskHandle, 0);
+  xTaskCreatePinnedToCore(gpsGeneratorTask, "gpsGenerator", 8192, nullptr, 2, &gpsGeneratorTaskHandle, 1);
 }
 
 void loop() {
   M5.update();
   
-  // Only update NTP time in client mode
-  if (ntpSyncAvailable) {
-    static unsigned long lastNTPUpdate = 0;
-    if (millis() - lastNTPUpdate > 60000) {  // Update every minute
-      timeClient.update();
-      lastNTPUpdate = millis();
-    }
-  }
+  // NTP refreshes itself in the background (see startTimeService())
   
   // Button A: Start/Stop simulation
   if (M5.BtnA.wasReleased()) {
-    if (csvLoaded) {
-      gpsSimActive = !gpsSimActive;
-      if (gpsSimActive && !currentGPS.valid) {
-        currentGPS = getNextGPSData();
-      }
-      statusMsg = gpsSimActive ? "GPS started" : "GPS stopped";
+    if (simulationReady()) {
+      gpsSimActive = !gpsSimActive;  // Generator task fetches the first fix itself
+      const char* message = gpsSimActive ? "GPS started" : "GPS stopped";
+      setStatus(message);
       displayStatus();
-      Serial.printf("Button A: %s\n",statusMsg.c_str());
+      LOG_INFO("Button A: %s", message);
     }
   }
   
@@ -1304,37 +6579,24 @@ void loop() {
     
     if (pressDuration > 2000) {
       // Long press (>2 seconds): NTP Sync
-      statusMsg = "Starting NTP sync...";
+      setStatus("Starting NTP sync...");
       displayStatus();
       
-      if (performNtpSync(true)) {
-        statusMsg = "NTP sync successful";
-      } else {
-        statusMsg = "NTP sync failed";
-      }
+      const char* message = performNtpSync(true) ? "NTP sync successful" : "NTP sync failed";
+      setStatus(message);
       displayStatus();
-      Serial.printf("Button B: %s\n",statusMsg.c_str());
+      LOG_INFO("Button B: %s", message);
     } else {
       // Short press: Switch WiFi Mode
       WiFiMode newMode = (currentWiFiMode == WIFI_AP_MODE) ? WIFI_CLIENT_MODE : WIFI_AP_MODE;
-      if (switchWiFiMode(newMode)) {
-        statusMsg = "WiFi mode switched";
-      } else {
-        statusMsg = "WiFi mode switch failed";
-      }
+      const char* message = switchWiFiMode(newMode) ? "WiFi mode switched" : "WiFi mode switch failed";
+      setStatus(message);
       displayStatus();
-      Serial.printf("Button B: %s\n",statusMsg.c_str());
+      LOG_INFO("Button B: %s", message);
     }
   }
   
-  simulateGPS();
-  
-  // Update display every 5 seconds
-  static unsigned long lastDisplayUpdate = 0;
-  if (millis() - lastDisplayUpdate > 5000) {
-    displayStatus();
-    lastDisplayUpdate = millis();
-  }
-  
-  delay(50);
+  // NMEA generation runs in its own tasks, so loop() only needs to poll
+  // the buttons often enough to feel responsive
+  delay(10);
 }
@@ -0,0 +1,244 @@
+/*
+Hot-path benchmarks (native)
+============================
+
+Throughput of the CSV row parser and the sentence writer on the host, plus
+a heap-allocation count per parsed row and per encoded epoch. The figures
+are not ESP32 numbers - they are for comparing one change with the next on
+the same machine. The allocation counts are exact on any machine and must
+stay at zero: the device code relies on a heap-free hot path.
+
+The throughput floors are deliberately loose so a slow CI runner does not
+fail; raise them locally with e.g. -D BENCH_MIN_ROWS_PER_SEC=2000000.
+
+Run with: pio test -e native -f test_benchmarks -v   (-v shows the figures)
+*/
+
+#include <unity.h>
+
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CSVTrack.h"
+#include "NMEASentenceWriter.h"
+#include "UBXFrameWriter.h"
+
+#ifndef SAMPLES_DIR
+#define SAMPLES_DIR "samples"  // pio test runs from the project directory
+#endif
+
+#ifndef BENCH_MIN_ROWS_PER_SEC
+#define BENCH_MIN_ROWS_PER_SEC 10000
+#endif
+
+#ifndef BENCH_MIN_SENTENCES_PER_SEC
+#define BENCH_MIN_SENTENCES_PER_SEC 100000
+#endif
+
+// =============================================================================
+// ALLOCATION COUNTER
+// =============================================================================
+
+// Every global new in the test binary - the library has no other way to reach the heap
+static unsigned long allocationCount = 0;
+
+void* operator new(size_t size) {
+  allocationCount++;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// =============================================================================
+// CSV ROWS
+// =============================================================================
+
+static const int MAX_SAMPLE_ROWS = 4096;
+static char* sampleRows[MAX_SAMPLE_ROWS];
+static int sampleRowCount = 0;
+static char sampleHeader[4096];
+
+// Load the sample once, outside the timed region (malloc, not new, so it is not counted)
+static void loadSample() {
+  if (sampleRowCount > 0) return;
+  FILE* file = fopen(SAMPLES_DIR "/20240806-03_00_02_mqtt_sub.csv", "r");
+  if (!file) return;
+  static char line[4096];
+  if (fgets(sampleHeader, sizeof(sampleHeader), file)) {
+    sampleHeader[strcspn(sampleHeader, "\r\n")] = '\0';
+    while (sampleRowCount < MAX_SAMPLE_ROWS && fgets(line, sizeof(line), file)) {
+      line[strcspn(line, "\r\n")] = '\0';
+      sampleRows[sampleRowCount] = (char*)malloc(strlen(line) + 1);
+      strcpy(sampleRows[sampleRowCount++], line);
+    }
+  }
+  fclose(file);
+}
+
+void test_csv_rows_per_second(void) {
+  loadSample();
+  TEST_ASSERT_TRUE_MESSAGE(sampleRowCount > 0, "sample CSV missing");
+
+  CSVColumnMap map;
+  TEST_ASSERT_NULL(parseCSVHeader(sampleHeader, map));
+
+  static char row[4096];
+  GPSData gps;
+  unsigned long rows = 0;
+  int32_t checksum = 0;   // Keeps the optimiser from dropping the parse
+  unsigned long allocationsBefore = allocationCount;
+  auto start = std::chrono::steady_clock::now();
+  while (secondsSince(start) < 0.5) {
+    for (int i = 0; i < sampleRowCount; i++) {
+      strcpy(row, sampleRows[i]);   // The parser works in place, as it does on the device
+      parseCSVLine(row, map, gps);
+      checksum += gps.latitudeE7;
+    }
+    rows += sampleRowCount;
+  }
+  double rowsPerSec = rows / secondsSince(start);
+  unsigned long allocations = allocationCount - allocationsBefore;
+
+  char report[128];
+  snprintf(report, sizeof(report), "csv: %.0f rows/sec, %lu allocations in %lu rows (%d)",
+           rowsPerSec, allocations, rows, (int)(checksum & 1));
+  TEST_MESSAGE(report);
+  TEST_ASSERT_EQUAL_UINT32(0, allocations);
+  TEST_ASSERT_TRUE(rowsPerSec >= BENCH_MIN_ROWS_PER_SEC);
+}
+
+// =============================================================================
+// SENTENCE ENCODING
+// =============================================================================
+
+/**
+ * One epoch's worth of output, written the way the sketch writes it:
+ * RMC, GGA, two GSA, GSV, TXT and a NAV-PVT frame
+ *
+ * @return sentences written (the UBX frame counts as one)
+ */
+static int encodeEpoch(uint32_t epoch, size_t& bytes) {
+  int32_t lat = 513915152 + (int32_t)(epoch % 1000) * 17;
+  int32_t lon = -2874245 - (int32_t)(epoch % 1000) * 11;
+  uint32_t centiseconds = (epoch * 20) % 8640000;
+  uint32_t hhmmss = (centiseconds / 360000) * 10000 + (centiseconds / 6000 % 60) * 100 + centiseconds / 100 % 60;
+
+  NMEASentenceWriter w;
+  bytes = 0;
+
+  w.begin("GNRMC");
+  w.fieldFixed(hhmmss * 100 + centiseconds % 100, 2, 6);
+  w.fieldChar('A');
+  w.fieldCoordinate(lat, 2, 'N', 'S');
+  w.fieldCoordinate(lon, 3, 'E', 'W');
+  w.fieldFixed(233, 3);
+  w.emptyField();
+  w.field("220725");
+  w.fields(",,A,V");
+  bytes += strlen(w.finish());
+
+  w.begin("GNGGA");
+  w.fieldFixed(hhmmss * 100 + centiseconds % 100, 2, 6);
+  w.fieldCoordinate(lat, 2, 'N', 'S');
+  w.fieldCoordinate(lon, 3, 'E', 'W');
+  w.fieldUInt(1);
+  w.fieldUInt(4, 2);
+  w.fieldFixed(489, 2);
+  w.fieldFixed(563, 1);
+  w.fields("M,46.9,M,,");
+  bytes += strlen(w.finish());
+
+  for (int system = 1; system <= 4; system += 3) {
+    w.begin("GNGSA");
+    w.fields("A,3");
+    for (int slot = 0; slot < 12; slot++) {
+      if (system == 1 && slot < 4) w.fieldUInt(slot + 1, 2);
+      else w.emptyField();
+    }
+    w.fieldFixed(627, 2);
+    w.fieldFixed(489, 2);
+    w.fieldFixed(392, 2);
+    w.fieldUInt(system);
+    bytes += strlen(w.finish());
+  }
+
+  w.begin("GPGSV");
+  w.fields("1,1,04");
+  for (int sat = 0; sat < 4; sat++) {
+    w.fieldUInt(sat + 1, 2);
+    w.fieldUInt(57 - sat * 10, 2);
+    w.fieldUInt(120 + sat * 20, 3);
+    w.fieldUInt(12 + sat * 5, 2);
+  }
+  w.fieldUInt(0);
+  bytes += strlen(w.finish());
+
+  w.begin("GNTXT");
+  w.fields("1,1,01,ANTENNA OK");
+  bytes += strlen(w.finish());
+
+  UBXFrameWriter frame;
+  frame.begin(0x01, 0x07);   // NAV-PVT
+  frame.u4(epoch * 200);
+  frame.u2(2025); frame.u1(7); frame.u1(22); frame.u1(11); frame.u1(23); frame.u1(39);
+  frame.u1(0x07);
+  frame.u4(50); frame.i4(0);
+  frame.u1(3); frame.u1(0x01); frame.u1(0); frame.u1(4);
+  frame.i4(lon); frame.i4(lat); frame.i4(103200); frame.i4(56300);
+  frame.u4(5000); frame.u4(8000);
+  frame.i4(0); frame.i4(0); frame.i4(0); frame.i4(120); frame.i4(0);
+  frame.u4(500); frame.u4(100000); frame.u2(489);
+  frame.reserved(6);
+  frame.i4(0); frame.i2(0); frame.u2(0);
+  frame.finish();
+  bytes += frame.length();
+
+  return 7;
+}
+
+void test_sentences_per_second(void) {
+  unsigned long sentences = 0;
+  size_t totalBytes = 0;
+  unsigned long allocationsBefore = allocationCount;
+  uint32_t epoch = 0;
+  auto start = std::chrono::steady_clock::now();
+  while (secondsSince(start) < 0.5) {
+    for (int i = 0; i < 1000; i++) {
+      size_t bytes;
+      sentences += encodeEpoch(epoch++, bytes);
+      totalBytes += bytes;
+    }
+  }
+  double elapsed = secondsSince(start);
+  double sentencesPerSec = sentences / elapsed;
+  double allocationsPerEpoch = (double)(allocationCount - allocationsBefore) / epoch;
+
+  char report[160];
+  snprintf(report, sizeof(report), "encode: %.0f sentences/sec, %.0f epochs/sec, %.1f bytes/epoch, %.2f allocations/epoch",
+           sentencesPerSec, epoch / elapsed, (double)totalBytes / epoch, allocationsPerEpoch);
+  TEST_MESSAGE(report);
+  TEST_ASSERT_EQUAL_UINT32(0, allocationCount - allocationsBefore);
+  TEST_ASSERT_TRUE(sentencesPerSec >= BENCH_MIN_SENTENCES_PER_SEC);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_csv_rows_per_second);
+  RUN_TEST(test_sentences_per_second);
+  return UNITY_END();
+}
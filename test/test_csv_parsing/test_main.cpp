@@ -0,0 +1,161 @@
+/*
+CSV track parsing tests (native)
+================================
+
+Tests for lib/gps_core's header-driven CSV parser, ending with a pass over
+every row of samples/20240806-03_00_02_mqtt_sub.csv.
+
+Run with: pio test -e native -f test_csv_parsing
+*/
+
+#include <unity.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "CSVTrack.h"
+
+#ifndef SAMPLES_DIR
+#define SAMPLES_DIR "samples"  // pio test runs from the project directory
+#endif
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// =============================================================================
+// FIELD SPLITTING AND HEADER MAP
+// =============================================================================
+
+void test_quoted_field_keeps_its_comma(void) {
+  char line[] = "a,\"[51.459598, -0.547957]\",,last";
+  char* cursor = line;
+  TEST_ASSERT_EQUAL_STRING("a", nextCSVField(cursor));
+  TEST_ASSERT_EQUAL_STRING("[51.459598, -0.547957]", nextCSVField(cursor));
+  TEST_ASSERT_EQUAL_STRING("", nextCSVField(cursor));
+  TEST_ASSERT_EQUAL_STRING("last", nextCSVField(cursor));
+  TEST_ASSERT_NULL(nextCSVField(cursor));
+}
+
+void test_header_reports_missing_column(void) {
+  char header[] = "UTC_time,coordinates,gps_course,gps_speed_knots,sats";
+  CSVColumnMap map;
+  const char* missing = parseCSVHeader(header, map);
+  TEST_ASSERT_NOT_NULL(missing);
+  TEST_ASSERT_EQUAL_STRING("hdop", missing);
+}
+
+void test_reordered_columns_parse_by_name(void) {
+  char header[] = "extra, sats,hdop,gps_speed_knots,gps_course,coordinates,UTC_time,after";
+  CSVColumnMap map;
+  TEST_ASSERT_NULL(parseCSVHeader(header, map));
+  TEST_ASSERT_EQUAL_INT(6, map.lastNeededColumn);
+
+  char row[] = "x,7,1.5,2.25,181.0,\"[-33.9, 151.2]\",23:59:58,ignored";
+  GPSData gps;
+  parseCSVLine(row, map, gps);
+  TEST_ASSERT_TRUE(gps.valid);
+  TEST_ASSERT_EQUAL_STRING("23:59:58", gps.utc_time);
+  TEST_ASSERT_EQUAL_INT32(-339000000, gps.latitudeE7);
+  TEST_ASSERT_EQUAL_INT32(1512000000, gps.longitudeE7);
+  TEST_ASSERT_EQUAL_INT(7, gps.sats);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.5f, gps.hdop);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 2.25f, gps.gps_speed_knots);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 181.0f, gps.gps_course);
+}
+
+void test_row_without_coordinates_is_invalid(void) {
+  char header[] = "UTC_time,coordinates,gps_course,gps_speed_knots,hdop,sats";
+  CSVColumnMap map;
+  TEST_ASSERT_NULL(parseCSVHeader(header, map));
+
+  char noBrackets[] = "17:07:34,\"51.4, -0.5\",0,0,1,4";
+  GPSData gps;
+  parseCSVLine(noBrackets, map, gps);
+  TEST_ASSERT_FALSE(gps.valid);
+
+  char shortRow[] = "17:07:34";
+  parseCSVLine(shortRow, map, gps);
+  TEST_ASSERT_FALSE(gps.valid);
+}
+
+// =============================================================================
+// NUMBERS AND TIMES
+// =============================================================================
+
+void test_degrees_e7_exact_and_rounded(void) {
+  int32_t e7;
+  TEST_ASSERT_TRUE(parseDegreesE7("51.459598", e7));
+  TEST_ASSERT_EQUAL_INT32(514595980, e7);
+  TEST_ASSERT_TRUE(parseDegreesE7(" -0.547957", e7));
+  TEST_ASSERT_EQUAL_INT32(-5479570, e7);
+  TEST_ASSERT_TRUE(parseDegreesE7("1.23456785", e7));    // 8th decimal rounds up
+  TEST_ASSERT_EQUAL_INT32(12345679, e7);
+  TEST_ASSERT_TRUE(parseDegreesE7("1.23456784", e7));
+  TEST_ASSERT_EQUAL_INT32(12345678, e7);
+  TEST_ASSERT_TRUE(parseDegreesE7("180", e7));
+  TEST_ASSERT_EQUAL_INT32(1800000000, e7);
+}
+
+void test_degrees_e7_rejects_garbage(void) {
+  int32_t e7;
+  TEST_ASSERT_FALSE(parseDegreesE7("", e7));
+  TEST_ASSERT_FALSE(parseDegreesE7("-", e7));
+  TEST_ASSERT_FALSE(parseDegreesE7("nan", e7));
+  TEST_ASSERT_FALSE(parseDegreesE7("181.0", e7));
+  TEST_ASSERT_FALSE(parseDegreesE7("99999999999", e7));  // Must not wrap round
+}
+
+void test_time_of_day(void) {
+  TEST_ASSERT_EQUAL_INT(0, parseTimeOfDay("00:00:00"));
+  TEST_ASSERT_EQUAL_INT(61654, parseTimeOfDay("17:07:34"));
+  TEST_ASSERT_EQUAL_INT(86399, parseTimeOfDay("23:59:59"));
+  TEST_ASSERT_EQUAL_INT(-1, parseTimeOfDay("17-07-34"));
+  TEST_ASSERT_EQUAL_INT(-1, parseTimeOfDay(""));
+}
+
+// =============================================================================
+// SAMPLE TRACK
+// =============================================================================
+
+void test_every_sample_row_parses(void) {
+  FILE* file = fopen(SAMPLES_DIR "/20240806-03_00_02_mqtt_sub.csv", "r");
+  TEST_ASSERT_NOT_NULL_MESSAGE(file, "sample CSV missing");
+
+  static char line[4096];
+  CSVColumnMap map;
+  TEST_ASSERT_NOT_NULL(fgets(line, sizeof(line), file));
+  line[strcspn(line, "\r\n")] = '\0';
+  TEST_ASSERT_NULL(parseCSVHeader(line, map));
+
+  int rows = 0;
+  long previousSecond = -1;
+  while (fgets(line, sizeof(line), file)) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (line[0] == '\0') continue;
+    GPSData gps;
+    parseCSVLine(line, map, gps);
+    rows++;
+    TEST_ASSERT_TRUE_MESSAGE(gps.valid, gps.utc_time);
+    TEST_ASSERT_TRUE(gps.sats > 0);
+
+    long second = parseTimeOfDay(gps.utc_time);
+    TEST_ASSERT_TRUE_MESSAGE(second >= 0, gps.utc_time);
+    TEST_ASSERT_TRUE_MESSAGE(second >= previousSecond, gps.utc_time);  // Log runs forward
+    previousSecond = second;
+  }
+  fclose(file);
+  TEST_ASSERT_TRUE(rows > 100);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_quoted_field_keeps_its_comma);
+  RUN_TEST(test_header_reports_missing_column);
+  RUN_TEST(test_reordered_columns_parse_by_name);
+  RUN_TEST(test_row_without_coordinates_is_invalid);
+  RUN_TEST(test_degrees_e7_exact_and_rounded);
+  RUN_TEST(test_degrees_e7_rejects_garbage);
+  RUN_TEST(test_time_of_day);
+  RUN_TEST(test_every_sample_row_parses);
+  return UNITY_END();
+}
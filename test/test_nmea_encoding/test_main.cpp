@@ -0,0 +1,288 @@
+/*
+NMEA / UBX encoding tests (native)
+==================================
+
+Unit tests for lib/gps_core's sentence and frame writers, plus a golden test
+that re-encodes every sentence of samples/sigrok-logic-output-neo6m.log from
+its parsed values and requires the result to match the real neo-6m byte for
+byte - checksum included.
+
+Run with: pio test -e native -f test_nmea_encoding
+*/
+
+#include <unity.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "CivilDate.h"
+#include "NMEASentenceWriter.h"
+#include "UBXFrameWriter.h"
+
+#ifndef SAMPLES_DIR
+#define SAMPLES_DIR "samples"  // pio test runs from the project directory
+#endif
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// =============================================================================
+// SENTENCE WRITER
+// =============================================================================
+
+void test_checksum_of_sample_sentence(void) {
+  TEST_ASSERT_EQUAL_HEX8(0x2B, calculateChecksum("$GNTXT,1,1,01,ANTENNA OK"));
+  TEST_ASSERT_EQUAL_HEX8(0x2B, calculateChecksum("$GNTXT,1,1,01,ANTENNA OK*2B"));  // Stops at '*'
+}
+
+void test_writer_builds_txt_sentence(void) {
+  NMEASentenceWriter w;
+  w.begin("GNTXT");
+  w.fieldUInt(1);
+  w.fieldUInt(1);
+  w.fieldUInt(1, 2);
+  w.field("ANTENNA OK");
+  TEST_ASSERT_EQUAL_STRING("$GNTXT,1,1,01,ANTENNA OK*2B", w.finish());
+  TEST_ASSERT_EQUAL_UINT32(strlen(w.text()), w.length());
+  TEST_ASSERT_FALSE(w.overflowed());
+}
+
+void test_fixed_point_and_padding(void) {
+  NMEASentenceWriter w;
+  w.begin("TEST");
+  w.fieldFixed(489, 2);       // 4.89
+  w.fieldFixed(233, 3);       // 0.233
+  w.fieldFixed(-50, 1);       // -5.0
+  w.fieldFixed(7, 2, 2);      // 00.07
+  w.fieldUInt(4, 2);          // 04
+  w.fieldUInt(123, 2);        // Wider than the padding
+  w.emptyField();
+  w.fieldChar('A');
+  w.finish();
+  TEST_ASSERT_EQUAL_STRING_LEN("$TEST,4.89,0.233,-5.0,00.07,04,123,,A*", w.text(), w.length() - 2);
+}
+
+void test_coordinates_in_each_hemisphere(void) {
+  NMEASentenceWriter w;
+  w.begin("TEST");
+  w.fieldCoordinate(513915152, 2, 'N', 'S');    // 51.3915152 → 51° 23.49091'
+  w.fieldCoordinate(-2874245, 3, 'E', 'W');     // -0.2874245 → 000° 17.24547' W
+  w.fieldCoordinate(-339000000, 2, 'N', 'S');   // Whole degrees
+  w.fieldCoordinate(0, 3, 'E', 'W');
+  w.finish();
+  TEST_ASSERT_EQUAL_STRING_LEN("$TEST,5123.49091,N,00017.24547,W,3354.00000,S,00000.00000,E*",
+                               w.text(), w.length() - 2);
+}
+
+void test_overflow_is_reported_not_truncated_silently(void) {
+  NMEASentenceWriter w;
+  w.begin("GPGSV");
+  for (int i = 0; i < 40; i++) w.fieldUInt(12345);
+  w.finish();
+  TEST_ASSERT_TRUE(w.overflowed());
+  TEST_ASSERT_TRUE(w.length() < (size_t)NMEA_SENTENCE_CAPACITY);
+}
+
+void test_template_patch_matches_fresh_build(void) {
+  NMEASentenceWriter tmpl;
+  tmpl.begin("GNRMC");
+  size_t timeSlot = tmpl.nextFieldOffset();
+  tmpl.field("000000.00");
+  tmpl.fieldChar('A');
+  size_t latSlot = tmpl.nextFieldOffset();
+  tmpl.fieldCoordinate(0, 2, 'N', 'S');
+  size_t lonSlot = tmpl.nextFieldOffset();
+  tmpl.fieldCoordinate(0, 3, 'E', 'W');
+  tmpl.markTemplate();
+
+  // Two epochs through the same template - the second must not see the first
+  const char* times[] = {"112339.00", "112340.00"};
+  int32_t lats[] = {513915152, 513914647};
+  int32_t lons[] = {-2874245, -2874223};
+  const char* tails[] = {"0.233", "12.5"};
+  for (int epoch = 0; epoch < 2; epoch++) {
+    TEST_ASSERT_TRUE(tmpl.patchText(timeSlot, times[epoch], 9));
+    tmpl.patchCoordinate(latSlot, lats[epoch], 2, 'N', 'S');
+    tmpl.patchCoordinate(lonSlot, lons[epoch], 3, 'E', 'W');
+    tmpl.rewind();
+    tmpl.field(tails[epoch]);
+    tmpl.finish();
+
+    NMEASentenceWriter fresh;
+    fresh.begin("GNRMC");
+    fresh.field(times[epoch]);
+    fresh.fieldChar('A');
+    fresh.fieldCoordinate(lats[epoch], 2, 'N', 'S');
+    fresh.fieldCoordinate(lons[epoch], 3, 'E', 'W');
+    fresh.field(tails[epoch]);
+    TEST_ASSERT_EQUAL_STRING(fresh.finish(), tmpl.text());
+  }
+}
+
+void test_patch_refuses_wrong_width(void) {
+  NMEASentenceWriter w;
+  w.begin("GNGGA");
+  size_t slot = w.nextFieldOffset();
+  w.field("000000.00");
+  w.markTemplate();
+  TEST_ASSERT_FALSE(w.patchText(slot, "1234", 9));
+  w.rewind();
+  TEST_ASSERT_EQUAL_STRING_LEN("$GNGGA,000000.00*", w.finish(), 17);
+}
+
+// =============================================================================
+// UBX FRAMES AND DATES
+// =============================================================================
+
+void test_ubx_fletcher_checksum(void) {
+  // CFG-RATE 200ms, 1 cycle, GPS time - a frame u-center itself sends
+  const uint8_t expected[] = {0xB5, 0x62, 0x06, 0x08, 0x06, 0x00,
+                              0xC8, 0x00, 0x01, 0x00, 0x01, 0x00, 0xDE, 0x6A};
+  UBXFrameWriter frame;
+  frame.begin(0x06, 0x08);
+  frame.u2(200);
+  frame.u2(1);
+  frame.u2(1);
+  frame.finish();
+  TEST_ASSERT_EQUAL_UINT32(sizeof(expected), frame.length());
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, frame.data(), sizeof(expected));
+}
+
+void test_civil_from_days(void) {
+  int year, month, day;
+  civilFromDays(0, year, month, day);
+  TEST_ASSERT_EQUAL_INT(1970, year); TEST_ASSERT_EQUAL_INT(1, month); TEST_ASSERT_EQUAL_INT(1, day);
+  civilFromDays(11016, year, month, day);   // Leap day of a century leap year
+  TEST_ASSERT_EQUAL_INT(2000, year); TEST_ASSERT_EQUAL_INT(2, month); TEST_ASSERT_EQUAL_INT(29, day);
+  civilFromDays(20291, year, month, day);   // The sigrok capture's "220725"
+  TEST_ASSERT_EQUAL_INT(2025, year); TEST_ASSERT_EQUAL_INT(7, month); TEST_ASSERT_EQUAL_INT(22, day);
+}
+
+// =============================================================================
+// GOLDEN OUTPUT - REAL NEO-6M CAPTURE
+// =============================================================================
+
+/**
+ * Read the sigrok capture back into whole sentences
+ *
+ * Each line is "uart-1: " + a run of the byte stream; "??" stands for the
+ * CR/LF that the ASCII decoder could not print.
+ */
+std::vector<std::string> loadSigrokSentences() {
+  std::vector<std::string> sentences;
+  FILE* file = fopen(SAMPLES_DIR "/sigrok-logic-output-neo6m.log", "r");
+  if (!file) return sentences;
+
+  std::string stream;
+  char line[512];
+  while (fgets(line, sizeof(line), file)) {
+    char* text = line;
+    if (strncmp(text, "uart-1: ", 8) == 0) text += 8;
+    text[strcspn(text, "\r\n")] = '\0';
+    stream += text;
+  }
+  fclose(file);
+
+  size_t start = stream.find('$');
+  while (start != std::string::npos) {
+    size_t end = stream.find("??", start);
+    if (end == std::string::npos) break;   // Trailing partial sentence
+    sentences.push_back(stream.substr(start, end - start));
+    start = stream.find('$', end);
+  }
+  return sentences;
+}
+
+// "DDMM.MMMMM" (or DDD...) to 1e-7 degrees, rounded so the writer gives the text back
+int32_t coordinateToE7(const std::string& text, int degreeDigits, char hemisphere) {
+  int32_t degrees = atoi(text.substr(0, degreeDigits).c_str());
+  std::string minutes = text.substr(degreeDigits);
+  minutes.erase(minutes.find('.'), 1);
+  int64_t minutesE5 = atoll(minutes.c_str());
+  int32_t e7 = degrees * 10000000 + (int32_t)((minutesE5 * 10 + 3) / 6);
+  return (hemisphere == 'S' || hemisphere == 'W') ? -e7 : e7;
+}
+
+bool isUnsigned(const std::string& text) {
+  return !text.empty() && text.find_first_not_of("0123456789") == std::string::npos;
+}
+
+bool isDecimal(const std::string& text) {
+  size_t dot = text.find('.');
+  return dot != std::string::npos && dot > 0 && dot + 1 < text.size() &&
+         isUnsigned(text.substr(0, dot)) && isUnsigned(text.substr(dot + 1));
+}
+
+/**
+ * Rebuild a sentence from its values with the typed writer calls the
+ * simulator uses - numbers as scaled integers, coordinates from 1e-7 degrees
+ */
+std::string reencode(const std::string& sentence) {
+  std::string body = sentence.substr(1, sentence.find('*') - 1);
+  std::vector<std::string> fields;
+  size_t start = 0;
+  for (;;) {
+    size_t comma = body.find(',', start);
+    fields.push_back(body.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+    if (comma == std::string::npos) break;
+    start = comma + 1;
+  }
+
+  // Field index of the latitude in sentences that carry a position
+  int latitudeField = -1;
+  if (fields[0] == "GNRMC") latitudeField = 3;
+  if (fields[0] == "GNGGA") latitudeField = 2;
+
+  NMEASentenceWriter w;
+  w.begin(fields[0].c_str());
+  for (size_t i = 1; i < fields.size(); i++) {
+    const std::string& f = fields[i];
+    if (latitudeField > 0 && (int)i == latitudeField && !f.empty()) {
+      w.fieldCoordinate(coordinateToE7(f, 2, fields[i + 1][0]), 2, 'N', 'S');
+      w.fieldCoordinate(coordinateToE7(fields[i + 2], 3, fields[i + 3][0]), 3, 'E', 'W');
+      i += 3;
+    } else if (f.empty()) {
+      w.emptyField();
+    } else if (isUnsigned(f)) {
+      w.fieldUInt(strtoul(f.c_str(), nullptr, 10), f.size());
+    } else if (isDecimal(f)) {
+      size_t dot = f.find('.');
+      std::string digits = f.substr(0, dot) + f.substr(dot + 1);
+      w.fieldFixed(atol(digits.c_str()), f.size() - dot - 1, dot);
+    } else {
+      w.field(f.c_str());
+    }
+  }
+  w.finish();
+  return w.overflowed() ? std::string("<overflow>") : std::string(w.text());
+}
+
+void test_sigrok_capture_reencodes_byte_exact(void) {
+  std::vector<std::string> sentences = loadSigrokSentences();
+  TEST_ASSERT_TRUE_MESSAGE(sentences.size() >= 40, "sigrok sample missing or truncated");
+
+  for (const std::string& sentence : sentences) {
+    // The capture itself must be valid before it can be a reference
+    TEST_ASSERT_EQUAL_HEX8_MESSAGE(strtoul(sentence.substr(sentence.size() - 2).c_str(), nullptr, 16),
+                                   calculateChecksum(sentence.c_str()), sentence.c_str());
+    TEST_ASSERT_EQUAL_STRING(sentence.c_str(), reencode(sentence).c_str());
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_checksum_of_sample_sentence);
+  RUN_TEST(test_writer_builds_txt_sentence);
+  RUN_TEST(test_fixed_point_and_padding);
+  RUN_TEST(test_coordinates_in_each_hemisphere);
+  RUN_TEST(test_overflow_is_reported_not_truncated_silently);
+  RUN_TEST(test_template_patch_matches_fresh_build);
+  RUN_TEST(test_patch_refuses_wrong_width);
+  RUN_TEST(test_ubx_fletcher_checksum);
+  RUN_TEST(test_civil_from_days);
+  RUN_TEST(test_sigrok_capture_reencodes_byte_exact);
+  return UNITY_END();
+}
@@ -0,0 +1,198 @@
+/*
+Raw log replay tests (native)
+=============================
+
+Tests for lib/gps_core's capture scanner and playback rewrite, ending with
+samples/sigrok-logic-output-neo6m.log: the epochs it produces must add up to
+exactly the bytes the neo-6m sent.
+
+Run with: pio test -e native -f test_replay_log
+*/
+
+#include <unity.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "NMEASentenceWriter.h"
+#include "ReplayLog.h"
+
+#ifndef SAMPLES_DIR
+#define SAMPLES_DIR "samples"  // pio test runs from the project directory
+#endif
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Everything the scanner hands over, in order
+struct ScanCapture {
+  std::vector<ReplayEpochHeader> epochs;
+  std::vector<std::string> sentences;
+  std::string bytes;
+};
+
+static ReplayEpoch lastEpoch;      // ~1.2KB - kept off the stack
+
+static bool captureEpoch(const ReplayEpoch& epoch, void* context) {
+  ScanCapture& capture = *(ScanCapture*)context;
+  lastEpoch = epoch;
+  capture.epochs.push_back(epoch.header);
+  for (int i = 0; i < epoch.header.sentenceCount; i++) {
+    const ReplaySentence& s = epoch.sentences[i];
+    capture.sentences.push_back(std::string(epoch.bytes + s.start, s.length));
+  }
+  capture.bytes.append(epoch.bytes, epoch.header.byteCount);
+  return true;
+}
+
+static ReplayLogScanner scanner;
+
+static ReplayScanStats scanText(const char* text, ScanCapture& capture, size_t chunk = 0) {
+  scanner.begin(captureEpoch, &capture);
+  size_t length = strlen(text);
+  if (chunk == 0) chunk = length;
+  for (size_t i = 0; i < length; i += chunk) {
+    scanner.feed((const uint8_t*)text + i, i + chunk < length ? chunk : length - i);
+  }
+  return scanner.finish();
+}
+
+// =============================================================================
+// SENTENCE BOUNDARIES
+// =============================================================================
+
+void test_prefix_stripped_and_wrapped_sentence_rejoined(void) {
+  ScanCapture capture;
+  ReplayScanStats stats = scanText(
+      "uart-1: $GNTXT,1,1,01,ANT\n"
+      "uart-1: ENNA OK*2B??$BDGSV,1,1,00,0*74??\n", capture);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.sentences);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.fragments);
+  TEST_ASSERT_EQUAL_STRING("$GNTXT,1,1,01,ANTENNA OK*2B\r\n", capture.sentences[0].c_str());
+  TEST_ASSERT_EQUAL_STRING("$BDGSV,1,1,00,0*74\r\n", capture.sentences[1].c_str());
+}
+
+void test_plain_log_with_crlf(void) {
+  ScanCapture capture;
+  ReplayScanStats stats = scanText("$GNTXT,1,1,01,ANTENNA OK*2B\r\n$BDGSV,1,1,00,0*74\r\n", capture);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.sentences);
+  TEST_ASSERT_EQUAL_STRING("$GNTXT,1,1,01,ANTENNA OK*2B\r\n$BDGSV,1,1,00,0*74\r\n", capture.bytes.c_str());
+}
+
+void test_bad_checksum_and_fragments_dropped(void) {
+  ScanCapture capture;
+  ReplayScanStats stats = scanText(
+      "$GNTXT,1,1,01,ANTENNA OK*2C\r\n"      // Wrong checksum
+      "$GNTXT,1,1,01,ANTEN$BDGSV,1,1,00,0*74\r\n"  // Cut off by the next '$'
+      "$GNTXT,1,1,01,ANTENNA OK\r\n"         // No checksum
+      "$BDGSV,1,1,00,0*7", capture);         // Log ends mid-checksum
+  TEST_ASSERT_EQUAL_UINT32(1, stats.sentences);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.badChecksum);
+  TEST_ASSERT_EQUAL_UINT32(3, stats.fragments);
+  TEST_ASSERT_EQUAL_STRING("$BDGSV,1,1,00,0*74\r\n", capture.bytes.c_str());
+}
+
+// =============================================================================
+// EPOCHS AND TIMES
+// =============================================================================
+
+void test_epochs_follow_the_time_field(void) {
+  char rmc1[96], gga1[96], rmc2[96];
+  NMEASentenceWriter w;
+  w.begin("GNRMC"); w.fields("235959.00,A,5123.49091,N,00017.24547,W,0.233,,220725,,,A,V");
+  snprintf(rmc1, sizeof(rmc1), "%s\r\n", w.finish());
+  w.begin("GNGGA"); w.fields("235959.00,5123.49091,N,00017.24547,W,1,04,4.89,56.3,M,46.9,M,,");
+  snprintf(gga1, sizeof(gga1), "%s\r\n", w.finish());
+  w.begin("GNRMC"); w.fields("000000.50,A,5123.49091,N,00017.24547,W,0.233,,230725,,,A,V");
+  snprintf(rmc2, sizeof(rmc2), "%s\r\n", w.finish());
+
+  std::string log = std::string("$GNTXT,1,1,01,ANTENNA OK*2B\r\n") + rmc1 + gga1 + rmc2 +
+                    "$GNTXT,1,1,01,ANTENNA OK*2B\r\n";
+  ScanCapture capture;
+  ReplayScanStats stats = scanText(log.c_str(), capture);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.epochs);
+  TEST_ASSERT_EQUAL_UINT8(3, capture.epochs[0].sentenceCount);   // TXT before the first time joins it
+  TEST_ASSERT_EQUAL_UINT32(0, capture.epochs[0].offsetMs);
+  TEST_ASSERT_EQUAL_UINT8(2, capture.epochs[1].sentenceCount);
+  TEST_ASSERT_EQUAL_UINT32(1500, capture.epochs[1].offsetMs);    // Across UTC midnight
+  TEST_ASSERT_EQUAL_UINT32(1500, stats.durationMs);
+}
+
+void test_time_of_day_ms(void) {
+  TEST_ASSERT_EQUAL_INT32(0, parseNMEATimeMs("000000"));
+  TEST_ASSERT_EQUAL_INT32(40998123, parseNMEATimeMs("112318.123,"));
+  TEST_ASSERT_EQUAL_INT32(40998500, parseNMEATimeMs("112318.5"));
+  TEST_ASSERT_EQUAL_INT32(-1, parseNMEATimeMs("246000.00"));
+  TEST_ASSERT_EQUAL_INT32(-1, parseNMEATimeMs("1123,"));
+}
+
+void test_rewrite_keeps_checksum_valid(void) {
+  ScanCapture capture;
+  scanText("$GNRMC,112339.00,A,5123.49091,N,00017.24547,W,0.233,,220725,,,A,V*09\r\n", capture);
+  ReplaySentence info = lastEpoch.sentences[0];
+  TEST_ASSERT_EQUAL_UINT8(7, info.timeField);
+  TEST_ASSERT_EQUAL_UINT8(53, info.dateField);
+
+  char* text = lastEpoch.bytes + info.start;
+  rewriteReplaySentence(text, info, "091502", "141026");
+  std::string rewritten(text, info.length);
+  TEST_ASSERT_EQUAL_STRING("$GNRMC,091502.00,A,5123.49091,N,00017.24547,W,0.233,,141026,,,A,V*0D\r\n", rewritten.c_str());
+  char hex[3];
+  snprintf(hex, sizeof(hex), "%02X", calculateChecksum(text));
+  TEST_ASSERT_EQUAL_STRING_LEN(hex, text + info.length - 4, 2);
+}
+
+// =============================================================================
+// SAMPLE CAPTURE
+// =============================================================================
+
+void test_sample_capture_round_trips_byte_for_byte(void) {
+  FILE* file = fopen(SAMPLES_DIR "/sigrok-logic-output-neo6m.log", "rb");
+  TEST_ASSERT_NOT_NULL_MESSAGE(file, "sample log missing");
+
+  // What was on the wire: lines without their "uart-1: ", '?' back to CR/LF
+  static char line[256];
+  std::string wire;
+  ScanCapture capture;
+  scanner.begin(captureEpoch, &capture);
+  while (size_t count = fread(line, 1, 7, file)) {   // Odd chunk size on purpose
+    scanner.feed((const uint8_t*)line, count);
+  }
+  ReplayScanStats stats = scanner.finish();
+  rewind(file);
+  while (fgets(line, sizeof(line), file)) {
+    line[strcspn(line, "\r\n")] = '\0';
+    wire += strncmp(line, "uart-1: ", 8) == 0 ? line + 8 : line;
+  }
+  fclose(file);
+  for (size_t at = wire.find("??"); at != std::string::npos; at = wire.find("??", at + 2)) {
+    wire.replace(at, 2, "\r\n");
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(0, stats.badChecksum);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.fragments);
+  TEST_ASSERT_TRUE(stats.epochs > 1);
+  TEST_ASSERT_EQUAL_STRING(wire.c_str(), capture.bytes.c_str());
+
+  // One burst per second, each starting with RMC
+  size_t sentence = 0;
+  for (size_t i = 0; i < capture.epochs.size(); i++) {
+    TEST_ASSERT_EQUAL_UINT32(i * 1000, capture.epochs[i].offsetMs);
+    TEST_ASSERT_EQUAL_STRING_LEN("$GNRMC", capture.sentences[sentence].c_str(), 6);
+    sentence += capture.epochs[i].sentenceCount;
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_prefix_stripped_and_wrapped_sentence_rejoined);
+  RUN_TEST(test_plain_log_with_crlf);
+  RUN_TEST(test_bad_checksum_and_fragments_dropped);
+  RUN_TEST(test_epochs_follow_the_time_field);
+  RUN_TEST(test_time_of_day_ms);
+  RUN_TEST(test_rewrite_keeps_checksum_valid);
+  RUN_TEST(test_sample_capture_round_trips_byte_for_byte);
+  return UNITY_END();
+}